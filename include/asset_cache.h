@@ -0,0 +1,62 @@
+#ifndef __ASSET_CACHE_H__
+#define __ASSET_CACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include <files.h>
+#include <types.h>
+
+// Most assets the cache can hold at once, referenced or not
+constexpr size_t max_cached_assets = 128;
+// Unreferenced assets are evicted whenever fewer than this many memory blocks are free, so that they only take up
+// spare memory (same policy as the grid's chunk cache)
+constexpr size_t asset_cache_min_free_blocks = 256;
+// Most prefetches that can be waiting on the loader at once, each one holds a load slot until it's acquired
+constexpr size_t max_pending_asset_loads = 8;
+
+// How an asset is prepared once its data has arrived
+enum class AssetType : uint8_t {
+    // Used as-is, like images
+    file,
+    // Offsets adjusted and display lists set up (see setup_loaded_model)
+    model,
+};
+
+struct AssetCacheStats {
+    // Acquires that found the asset already in memory or being loaded, and acquires that had to start a load
+    uint32_t hits;
+    uint32_t misses;
+    // Unreferenced assets that were freed to make room
+    uint32_t evictions;
+    // Assets in memory (or being loaded), and how many of those nothing holds a reference to
+    uint16_t resident;
+    uint16_t unreferenced;
+};
+
+// Returns the asset and adds a reference to it, loading it first if it isn't already in memory
+// Every asset is loaded at most once however many times it's acquired, so anything acquired from here must be given
+// back with release_asset instead of being freed
+[[nodiscard]] void* acquire_asset(const AssetRecord& asset, AssetType type);
+// Same as above, for paths that are only known at runtime
+[[nodiscard]] void* acquire_asset(const char* path, AssetType type);
+[[nodiscard]] inline Model* acquire_model(const AssetRecord& asset)
+{
+    return static_cast<Model*>(acquire_asset(asset, AssetType::model));
+}
+// Starts loading an asset without waiting for it or adding a reference to it, so that acquiring it later doesn't have
+// to wait for the whole load
+// Returns false without starting the load if max_pending_asset_loads prefetches are already waiting to be acquired
+bool prefetch_asset(const AssetRecord& asset, AssetType type, LoadPriority priority = LoadPriority::critical);
+// Checks whether acquiring an asset would return without waiting on the loader, i.e. whether it's in memory or its
+// prefetch has finished loading along with a model's images (acquiring it may still have to set it up for its type)
+// Once a model's own data has arrived, this also starts loading its images
+bool is_asset_loaded(const AssetRecord& asset);
+// Drops a reference to an asset returned by acquire_asset
+// Unreferenced assets stay in memory to be reacquired (e.g. by the next scene) until the memory is needed
+void release_asset(const void* data);
+// Frees the least recently released unreferenced asset, returns false if there were none
+bool evict_unreferenced_asset();
+const AssetCacheStats& get_asset_cache_stats();
+
+#endif
@@ -2,14 +2,20 @@
 #define __BLOCK_VECTOR_H__
 
 #include <cstddef>
+#include <algorithm>
 #include <array>
+#include <memory>
+#include <span>
 #include <utility>
 
 #include <mem.h>
 
 // A vector-like class that is made of a linked list of arrays. Sometimes known as an unrolled linked list.
 // Each array holds `block_size` elements, which defaults to the maximum amount that fits in a single memory block.
-// Allows for insertion and forward iteration. Movable, but not copyable.
+// Allows for insertion, forward iteration and random access. Movable, but not copyable.
+// Every block before the last one is always full, which is what allows indexing to be done with a divide and a lookup
+// into a table of block pointers. That table is only built the first time the vector is indexed, so vectors that are
+// only ever iterated don't pay for it.
 template <typename T, size_t block_size = (mem_block_size - (sizeof(void*) + sizeof(size_t))) / sizeof(T)>
 class block_vector
 {
@@ -124,7 +130,7 @@ public:
     using const_iterator         = ConstIterator;
 
     // Default constructor
-    block_vector() : first_(new Block), last_(first_)
+    block_vector() : first_(new Block), last_(first_), last_index_(0), block_table_{}, block_table_size_(0), block_table_capacity_(0)
     {
         first_->next = nullptr;
         first_->count = 0;
@@ -140,7 +146,13 @@ public:
     // Copy assignment (not copyable)
     block_vector& operator=(const block_vector&) = delete;
     // Move constructor
-    block_vector(block_vector&& rhs) : first_(std::exchange(rhs.first_, nullptr)), last_(std::exchange(rhs.last_, nullptr))
+    block_vector(block_vector&& rhs) :
+        first_(std::exchange(rhs.first_, nullptr)),
+        last_(std::exchange(rhs.last_, nullptr)),
+        last_index_(std::exchange(rhs.last_index_, 0)),
+        block_table_(std::move(rhs.block_table_)),
+        block_table_size_(std::exchange(rhs.block_table_size_, 0)),
+        block_table_capacity_(std::exchange(rhs.block_table_capacity_, 0))
     {}
     // Move assignment
     block_vector& operator=(block_vector&& rhs)
@@ -148,9 +160,81 @@ public:
         free_chain(first_);
         first_ = std::exchange(rhs.first_, nullptr);
         last_ = std::exchange(rhs.last_, nullptr);
+        last_index_ = std::exchange(rhs.last_index_, 0);
+        block_table_ = std::move(rhs.block_table_);
+        block_table_size_ = std::exchange(rhs.block_table_size_, 0);
+        block_table_capacity_ = std::exchange(rhs.block_table_capacity_, 0);
         return *this;
     }
 
+    // Swaps the contents of two vectors without allocating
+    void swap(block_vector& rhs) noexcept
+    {
+        std::swap(first_, rhs.first_);
+        std::swap(last_, rhs.last_);
+        std::swap(last_index_, rhs.last_index_);
+        std::swap(block_table_, rhs.block_table_);
+        std::swap(block_table_size_, rhs.block_table_size_);
+        std::swap(block_table_capacity_, rhs.block_table_capacity_);
+    }
+
+    // Removes every element but keeps all of the blocks linked as reserved capacity, so refilling the vector to the
+    // same size won't allocate. Unlike assigning an empty vector, this never frees any memory.
+    void clear_retain() noexcept
+    {
+        for (Block* cur_block = first_; cur_block != last_->next; cur_block = cur_block->next)
+        {
+            cur_block->count = 0;
+        }
+        last_ = first_;
+        last_index_ = 0;
+    }
+
+    // Links enough empty blocks onto the end of the chain to hold at least `n` elements in total
+    // Insertions that fit in the reserved blocks won't allocate
+    void reserve(size_type n)
+    {
+        // Find the end of the chain, counting the capacity of the blocks after the current last block
+        Block* tail = last_;
+        size_type capacity = (last_index_ + 1) * block_size;
+        while (tail->next != nullptr)
+        {
+            tail = tail->next;
+            capacity += block_size;
+        }
+        // Link new blocks until the requested capacity is met
+        while (capacity < n)
+        {
+            Block* new_block = new Block;
+            new_block->next = nullptr;
+            new_block->count = 0;
+            tail->next = new_block;
+            tail = new_block;
+            capacity += block_size;
+        }
+    }
+
+    // Default initializes up to `n` elements at the end of the vector and returns them as a contiguous span
+    // If the current block fills up before `n` elements have been added, the returned span is shorter than `n` and this
+    // should be called again for the remaining elements. Trivial types are left uninitialized, so every element of the
+    // span must be written to.
+    std::span<T> emplace_back_n(size_type n) noexcept
+    {
+        size_type start = last_->count;
+        size_type count = std::min(n, block_size - start);
+        T* ret = reinterpret_cast<T*>(&last_->contents[start]);
+        for (size_type i = 0; i < count; i++)
+        {
+            new (&ret[i]) T;
+        }
+        last_->count += count;
+        if (last_->count == block_size)
+        {
+            add_block();
+        }
+        return {ret, count};
+    }
+
     template <typename... Args>
     __attribute__((noinline)) constexpr iterator emplace_back(Args&&... args) noexcept
     {
@@ -183,6 +267,11 @@ public:
     const_iterator back() const noexcept { return {last_, last_->count - 1}; }
     iterator       back()       noexcept { return {last_, last_->count - 1}; }
 
+    const_reference operator[](size_type index) const noexcept { return *element_at(index); }
+    reference       operator[](size_type index)       noexcept { return *element_at(index); }
+
+    size_type size() const noexcept { return last_index_ * block_size + last_->count; }
+
     struct BlockIterator
     {
         constexpr BlockIterator(Block* block) : block_(block) {}
@@ -206,17 +295,52 @@ public:
     };
 
     BlockIterator blocks_begin() const noexcept { return {first_}; }
-    BlockIterator blocks_end()   const noexcept { return {nullptr}; }
+    // Blocks that were only reserved aren't part of the block range
+    BlockIterator blocks_end()   const noexcept { return {last_->next}; }
 
     bool empty() const noexcept { return first_ == nullptr || first_->count == 0; }
 private:
     void add_block()
     {
-        Block* new_block = new Block;
-        last_->next = new_block;
-        last_ = new_block;
-        new_block->next = nullptr;
-        new_block->count = 0;
+        // Use the next reserved block if there is one, otherwise allocate a new one
+        if (last_->next == nullptr)
+        {
+            Block* new_block = new Block;
+            new_block->next = nullptr;
+            new_block->count = 0;
+            last_->next = new_block;
+        }
+        last_ = last_->next;
+        last_index_++;
+    }
+    pointer element_at(size_type index) const noexcept
+    {
+        size_type block_index = index / block_size;
+        if (block_index >= block_table_size_)
+        {
+            extend_block_table();
+        }
+        return reinterpret_cast<pointer>(&block_table_[block_index]->contents[index % block_size]);
+    }
+    // Appends every block up to and including the last one to the block table, doubling its capacity as needed
+    void extend_block_table() const
+    {
+        size_type num_blocks = last_index_ + 1;
+        if (num_blocks > block_table_capacity_)
+        {
+            size_type new_capacity = std::max(num_blocks, 2 * block_table_capacity_);
+            std::unique_ptr<Block*[]> new_table(new Block*[new_capacity]);
+            std::copy_n(block_table_.get(), block_table_size_, new_table.get());
+            block_table_ = std::move(new_table);
+            block_table_capacity_ = new_capacity;
+        }
+        // Continue walking the chain from the last block that's already in the table
+        Block* cur_block = block_table_size_ == 0 ? first_ : block_table_[block_table_size_ - 1]->next;
+        while (block_table_size_ < num_blocks)
+        {
+            block_table_[block_table_size_++] = cur_block;
+            cur_block = cur_block->next;
+        }
     }
     void free_chain(Block *start)
     {
@@ -230,6 +354,12 @@ private:
     }
     Block* first_;
     Block* last_;
+    // Index of the last block in the chain
+    size_type last_index_;
+    // Lazily built table of block pointers used for indexing
+    mutable std::unique_ptr<Block*[]> block_table_;
+    mutable size_type block_table_size_;
+    mutable size_type block_table_capacity_;
 };
 
 
@@ -0,0 +1,43 @@
+#ifndef __COMPRESSION_H__
+#define __COMPRESSION_H__
+
+#include <cstddef>
+#include <cstdint>
+
+// Decoder for the LZ format that tools/levelconv compresses chunks with.
+// The compressed data is a sequence of tokens, each starting with a control byte:
+//   0x00-0x7F: Literal run, the next (control + 1) bytes are copied to the output as-is
+//   0x80-0xFF: Back-reference of ((control & 0x7F) + 3) bytes, followed by a big-endian 16-bit (distance - 1)
+//              The bytes are copied one at a time from distance bytes behind the output position, so a back-reference
+//              can overlap the bytes it produces. A distance of 2 repeats the last 2 bytes, which is how runs of empty
+//              tiles get encoded.
+// The decoder can be fed the compressed data in pieces of any size as they arrive, which lets the loader thread
+// decompress one piece while the next is still being DMA'd.
+class LzDecoder {
+public:
+    LzDecoder(void* output, size_t output_size) :
+        out_(static_cast<uint8_t*>(output)), out_end_(static_cast<uint8_t*>(output) + output_size),
+        state_(State::control), count_(0), distance_(0)
+    {}
+
+    // Decompresses as much of the given piece of compressed data as possible, picking up where the last piece left off
+    void feed(const uint8_t* data, size_t length);
+
+    // Whether the entire output has been written
+    bool finished() const { return out_ == out_end_; }
+private:
+    enum class State : uint8_t {
+        control,
+        literal,
+        distance_high,
+        distance_low,
+    };
+    uint8_t* out_;
+    uint8_t* out_end_;
+    State state_;
+    // Number of bytes left in the current literal run or back-reference
+    uint32_t count_;
+    uint32_t distance_;
+};
+
+#endif
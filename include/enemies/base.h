@@ -3,7 +3,7 @@
 
 // The basic info that every enemy definition has
 struct BaseEnemyInfo {
-    const char* model_name;
+    const AssetRecord* model_asset;
     Model* model;
     const char* enemy_name;
     uint16_t max_health;
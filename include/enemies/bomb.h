@@ -5,8 +5,8 @@
 
 // The per-subtype parameters for a bomber-type enemy
 struct BombParams {
-    // Name of the model used by the shots of this subtype
-    const char* bomb_model_name;
+    // Asset of the model used by the shots of this subtype
+    const AssetRecord* bomb_model_asset;
     // Pointer to the model used by the shots of this subtype
     Model* bomb_model;
     // Maximum distance that the player can be seen from
@@ -5,8 +5,8 @@
 
 // The per-subtype parameters for a mortar-type enemy
 struct MortarParams {
-    // Name of the model used by the shots of this subtype
-    const char* mortar_model_name;
+    // Asset of the model used by the shots of this subtype
+    const AssetRecord* mortar_model_asset;
     // Pointer to the model used by the shots of this subtype
     Model* mortar_model;
     // Maximum distance that the player can be seen from
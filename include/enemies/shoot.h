@@ -5,8 +5,8 @@
 
 // The per-subtype parameters for a shooter-type enemy
 struct ShootParams {
-    // Name of the model used by the shots of this subtype
-    const char* shot_model_name;
+    // Asset of the model used by the shots of this subtype
+    const AssetRecord* shot_model_asset;
     // Pointer to the model used by the shots of this subtype
     Model* shot_model;
     // Maximum distance that the player can be seen from
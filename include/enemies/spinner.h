@@ -5,8 +5,8 @@
 
 // The per-subtype parameters for a spinner-type enemy
 struct SpinnerParams {
-    // Name of the model used by the blade
-    const char* blade_model_name;
+    // Asset of the model used by the blade
+    const AssetRecord* blade_model_asset;
     // Pointer to the model used by the blade
     Model* blade_model;
     // Maximum distance that the player can be seen from
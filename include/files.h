@@ -10,14 +10,89 @@
 // Implementation-defined in platform_files.h
 class LoadHandle;
 
+// Classes of load requests, in the order the loader serves them
+// Requests in the same class are served in the order they were made
+enum class LoadPriority : uint8_t {
+    // Data the game is about to block on, like models and level data
+    critical,
+    // Streamed audio, which has to arrive before its buffer runs dry
+    audio,
+    // Chunks in the visible area
+    visible_chunk,
+    // Chunks that the camera is heading towards but aren't visible yet
+    prefetch,
+    count
+};
 
+// One piece of a scatter/gather load, read from rom_pos into dest
+// Like any other load the size has to be even and the destination 8 byte aligned
+struct LoadSegment {
+    uint32_t rom_pos;
+    void* dest;
+    uint32_t size;
+};
+
+// Most segments one scatter/gather load can have
+constexpr size_t max_load_segments = 4;
+
+struct LoadQueueStats {
+    // Requests waiting for their DMA to start in each class
+    uint16_t queued[static_cast<size_t>(LoadPriority::count)];
+    // Most requests that have been waiting at once
+    uint16_t max_queued;
+    // Requests that were served, cancelled before their DMA started, or merged into the DMA of the request before them
+    uint32_t completed;
+    uint32_t cancelled;
+    uint32_t merged;
+    // Reads done to serve the requests, large requests are split into several slices
+    uint32_t slices;
+};
+
+// Identifies an asset, unique within the packed asset file (it's the asset's offset in it)
+using asset_id_t = uint32_t;
+
+// Where an asset is in the packed asset file
+// tools/assetpack generates one of these for every asset into asset_ids.h (e.g. assets::models::metalGrate), so code
+// that knows which asset it wants can load it without looking its path up at runtime
+struct AssetRecord {
+    asset_id_t offset;
+    uint32_t size;
+};
+
+// Looks up an asset by path, for paths that are only known at runtime (like the images that models refer to)
+[[nodiscard]] AssetRecord get_asset_record(const char *path);
+[[nodiscard]] LoadHandle start_file_load(const AssetRecord& asset);
 [[nodiscard]] LoadHandle start_file_load(const char *path);
-LoadHandle start_data_load(void* ret, uint32_t rom_pos, uint32_t size); // TODO refactor for PC support
+LoadHandle start_data_load(void* ret, uint32_t rom_pos, uint32_t size, load_callback_t callback = nullptr, void* callback_arg = nullptr,
+    LoadPriority priority = LoadPriority::critical); // TODO refactor for PC support
+// Same as above, but decompresses the data (see compression.h) into ret as it's loaded
+LoadHandle start_compressed_data_load(void* ret, uint32_t rom_pos, uint32_t compressed_size, uint32_t size, load_callback_t callback = nullptr, void* callback_arg = nullptr,
+    LoadPriority priority = LoadPriority::critical); // TODO refactor for PC support
+// Reads each segment's rom range into its destination as one load, the callback and join get the first segment's destination
+LoadHandle start_scatter_load(const LoadSegment* segments, size_t num_segments, load_callback_t callback = nullptr, void* callback_arg = nullptr,
+    LoadPriority priority = LoadPriority::critical);
+[[nodiscard]] void *load_file(const AssetRecord& asset);
 [[nodiscard]] void *load_file(const char *path);
 [[nodiscard]] void *load_data(uint32_t rom_pos, uint32_t size); // Same as above
 void *load_data(void* ret, uint32_t rom_pos, uint32_t size); // Same as above
+[[nodiscard]] Model *load_model(const AssetRecord& asset);
 [[nodiscard]] Model *load_model(const char *path);
+// Adjusts a loaded model's offsets and sets up its display lists, has to be called on the main thread
+void setup_loaded_model(Model *model);
+// The two halves of setup_loaded_model, so that a model's images can be prefetched in between
+void adjust_loaded_model(Model *model);
+void setup_model_gfx(Model *model);
+// Starts loading the images of a model whose offsets have been adjusted, so that setting up its display lists doesn't
+// wait on them. Returns whether they're all loaded, call it again until they are to start any that couldn't start yet
+bool prefetch_model_images(const Model *model);
 [[nodiscard]] void* get_or_load_image(const char* path);
+const LoadQueueStats& get_load_queue_stats();
+
+template <typename T>
+[[nodiscard]] T* load_file(const AssetRecord& asset)
+{
+    return static_cast<T*>(load_file(asset));
+}
 
 template <typename T>
 [[nodiscard]] T* load_file(const char *path)
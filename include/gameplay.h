@@ -25,7 +25,10 @@ public:
     GameplayScene& operator=(const GameplayScene&) = delete;
     GameplayScene& operator=(GameplayScene&&) = delete;
     // Called every frame after the scene is constructed, stops being called once it returns true
+    // The load is spread over as many frames as it takes to stay within a CPU time budget each frame
     bool load() override final;
+    // How much of the load is done as a percentage
+    int load_progress() override final;
     // Called every frame while the scene is active at a fixed 60Hz rate for logic handling
     void update() override final;
     // Called every frame while the scene is active every frame for drawing the scene contents
@@ -46,6 +49,28 @@ private:
     int unload_timer_;
     int keys_;
     int timer_;
+
+    // Steps of the load, in order
+    enum class LoadStage : uint8_t {
+        player,
+        tiles,
+        level,
+        done,
+    };
+    LoadStage load_stage_;
+    // Number of tile models that have been prefetched and acquired so far
+    uint8_t tiles_prefetched_;
+    uint8_t tiles_acquired_;
+    // Tile types being filled in while the tiles load, moved into the grid once they're all done
+    dynamic_array<TileType> tiles_;
+
+    // Places the player at the level's start
+    void load_player();
+    // Acquires tile models as their loads finish until they're all done or the frame's budget is used up, returns
+    // whether they're all done
+    bool load_tiles(uint32_t start_time);
+    // Sets up the grid with the loaded tiles and creates the level's objects
+    void load_level();
 };
 
 class LevelTransitionScene : public Scene {
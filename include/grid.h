@@ -1,16 +1,22 @@
 #ifndef __GRID_H__
 #define __GRID_H__
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <memory>
 #include <tuple>
 #include <type_traits>
 
 #include <dynamic_array.h>
 #include <skipfield.h>
+#include <static_set.h>
 #include <model.h>
 #include <mem.h>
 #include <files.h>
+#include <asset_cache.h>
 #include <mathutils.h>
+#include <tile_collisions.h>
 
 #include <platform_grid.h>
 
@@ -33,17 +39,39 @@ constexpr size_t tile_size = 256;
 constexpr size_t max_loaded_chunks = 64;
 constexpr size_t max_loading_chunks = 16;
 
+// How many frames of camera travel ahead of the visible area chunks get prefetched for
+constexpr int prefetch_lookahead_frames = 45;
+// Maximum number of prefetched chunks that can be loading or waiting to become visible at once
+// The remaining loading slots are kept for chunks that are already visible
+constexpr size_t max_prefetching_chunks = max_loading_chunks / 2;
+// Weight of the newest frame's movement in the smoothed camera velocity used for prefetching
+constexpr float prefetch_velocity_smoothing = 0.25f;
+// Below this speed (in units per frame) the camera is considered stationary and nothing is prefetched
+constexpr float prefetch_min_speed = 4.0f;
+
+// Maximum number of chunks that have left the visible area to keep in memory in case they become visible again
+constexpr size_t max_cached_chunks = 16;
+// Cached chunks are evicted whenever fewer than this many memory blocks are free, so that they only take up spare memory
+constexpr size_t chunk_cache_min_free_blocks = 256;
+
+// Chunks further than this from the camera target are drawn with their merged LOD mesh instead of per-tile models
+constexpr int chunk_lod_distance = 2048;
+
+// Maximum number of chunks that can be loaded simultaneously in the x direction
+constexpr int max_chunks_x = round_away_divide(visible_inner_range_x * 2, static_cast<int>(tile_size * chunk_size)) + 1;
+// Maximum number of chunks that can be loaded simultaneously in the z direction
+constexpr int max_chunks_z = round_away_divide(visible_outer_range_pos_z + visible_outer_range_neg_z, static_cast<int>(tile_size * chunk_size)) + 1;
+
+// Dimensions of the direct-mapped chunk table, which holds each chunk at {x mod width, z mod height}
+// Every chunk in a window of max_chunks_x by max_chunks_z chunks maps to a distinct slot, so only chunks that have left
+// the visible area can collide with visible ones. Powers of 2 so that the modulo is just a mask.
+constexpr size_t chunk_table_width  = std::bit_ceil(static_cast<unsigned int>(max_chunks_x));
+constexpr size_t chunk_table_height = std::bit_ceil(static_cast<unsigned int>(max_chunks_z));
+
 using tile_id = uint8_t;
 using grid_pos = std::pair<unsigned int, unsigned int>;
 using chunk_pos = std::pair<uint16_t, uint16_t>;
 
-enum class TileCollision : uint8_t {
-    none,
-    floor,
-    wall,
-    slope,
-};
-
 struct TileType {
     Model *model;
     TileCollision flags;
@@ -63,12 +91,60 @@ struct ChunkColumn {
     Tile *tiles;
 };
 
+// Tile id of an empty position in a column
+constexpr tile_id empty_tile = 0xFF;
+
+// Flags for a column's topmost floor, the low 2 bits hold the floor tile's rotation
+constexpr uint8_t chunk_floor_present = 0x04;
+constexpr uint8_t chunk_floor_slope   = 0x08;
+// Set if the column has more floors below the topmost one
+constexpr uint8_t chunk_floor_stacked = 0x10;
+
+// The topmost floor or slope tile in a column, baked by levelconv so floor queries don't have to search the column's tiles
+struct ChunkFloor {
+    int16_t y;
+    tile_id id;
+    uint8_t flags;
+};
+
+// Wall occupancy of one tile height in a chunk, one row per x position with bit z set if there's a wall at that z position
+using ChunkWallLayer = std::array<uint16_t, chunk_size>;
+
+// Shape of a LOD quad, the low 2 bits hold the rotation of slopes and walls
+constexpr uint8_t lod_quad_floor = 0x00;
+constexpr uint8_t lod_quad_slope = 0x04;
+constexpr uint8_t lod_quad_wall  = 0x08;
+constexpr uint8_t lod_quad_shape_mask = 0x0C;
+
+// A quad of the simplified mesh that's drawn in place of a chunk's tiles when the chunk is far from the camera, baked by
+// levelconv from the chunk's top floors and walls. Positions and sizes are in tiles relative to the chunk's origin.
+struct ChunkLodQuad {
+    int16_t y;
+    uint8_t x;
+    uint8_t z;
+    uint8_t size_x;
+    uint8_t size_z;
+    uint8_t size_y;
+    tile_id id;
+    uint8_t shape;
+    uint8_t padding;
+};
+
 #include <n64_model.h>
 
 // A chunk is a collection of columns that can be loaded or unloaded independently of other chunks
 // Each chunk is assigned to a given chunk position, which is the position of the first column divided by chunk_size
+// Along with the columns, each chunk has collision data baked by levelconv: the topmost floor of every column and a
+// wall occupancy layer for every tile height from the chunk's lowest wall to its highest
+// The chunk's LOD quads are sorted by tile id, so that each tile id's quads can be drawn with a single material
 struct Chunk {
     std::array<std::array<ChunkColumn, chunk_size>, chunk_size> columns;
+    std::array<std::array<ChunkFloor, chunk_size>, chunk_size> floors;
+    int16_t wall_base_height;
+    uint16_t num_wall_layers;
+    ChunkWallLayer *wall_layers;
+    uint16_t num_lod_quads;
+    ChunkLodQuad *lod_quads;
     void adjust_offsets()
     {
         for (auto& x : columns)
@@ -78,6 +154,22 @@ struct Chunk {
                 xz.tiles = ::add_offset(xz.tiles, this);
             }
         }
+        wall_layers = ::add_offset(wall_layers, this);
+        lod_quads = ::add_offset(lod_quads, this);
+    }
+    // Fixes up the column tile pointers after the chunk has been moved from the given address by the heap compactor
+    void relocate(void *old_addr)
+    {
+        void *delta = reinterpret_cast<void*>(reinterpret_cast<uintptr_t>(this) - reinterpret_cast<uintptr_t>(old_addr));
+        for (auto& x : columns)
+        {
+            for (auto &xz : x)
+            {
+                xz.tiles = ::add_offset(xz.tiles, delta);
+            }
+        }
+        wall_layers = ::add_offset(wall_layers, delta);
+        lod_quads = ::add_offset(lod_quads, delta);
     }
 };
 
@@ -98,8 +190,8 @@ struct LevelObject {
 };
 
 // A grid definition contains information about the grid it refers to. This includes the dimensions of the grid in chunks,
-// as well as the rom offset to the array of chunk rom offsets. (TODO PC) The chunk arrays in rom contain 2 32-bit values each, 
-// the chunk's file offset and the chunk's data length
+// as well as the rom offset to the array of chunk rom offsets. (TODO PC) The chunk arrays in rom contain 3 32-bit values each, 
+// the chunk's file offset, the chunk's data length and the length of the chunk's compressed data in the file
 struct GridDefinition {
     uint16_t num_chunks_x;
     uint16_t num_chunks_z;
@@ -112,7 +204,13 @@ struct GridDefinition {
         chunk_array_rom_offset += base_addr;
         object_array_rom_offset += base_addr;
     }
-    void get_chunk_offset_size(unsigned int x, unsigned int z, uint32_t *offset, uint32_t *size);
+};
+
+// An element of a grid's chunk array, offset is relative to the start of the chunk array in the file
+struct ChunkArrayElement {
+    uint32_t offset;
+    uint32_t size;
+    uint32_t compressed_size;
 };
 
 constexpr chunk_pos chunk_from_pos(grid_pos pos)
@@ -133,26 +231,86 @@ struct ChunkGfx;
 
 struct ChunkEntry {
     chunk_pos pos;
-    std::unique_ptr<Chunk, alloc_deleter> chunk;
+    relocatable_ptr<Chunk> chunk;
     ChunkGfx gfx;
 };
 
+// A chunk whose data is currently being DMA'd or built, the chunk's allocation stays pinned until it's been built
+// Prefetched chunks aren't moved into the loaded chunks until they enter the visible area, which clears the flag
+// Once the data has arrived, the chunk thread fixes up the chunk and builds its gfx, so neither the chunk nor gfx can be
+// touched by the game thread, and the entry can't be freed, until it's built
+struct LoadingChunkEntry {
+    chunk_pos pos;
+    relocatable_ptr<Chunk> chunk;
+    LoadHandle handle;
+    bool prefetch;
+    // Set once the chunk's data has arrived and the load's handle has been released, since each handle holds one of the
+    // loader's rx slots and prefetched chunks can wait a while before they become visible
+    bool finished;
+    // Set once the chunk thread has finished building the chunk
+    bool built;
+    // The grid's tile types and tile LOD materials, which the chunk thread builds the chunk's gfx with
+    const TileType *tile_types;
+    const TileLodMaterial *tile_lods;
+    ChunkGfx gfx;
+};
+
+// A chunk that has left the visible area, kept along with its gfx so that it doesn't have to be loaded again if the
+// camera comes back to it. Cached chunks aren't in the chunk table since they can share a slot with a visible chunk.
+struct CachedChunkEntry {
+    chunk_pos pos;
+    relocatable_ptr<Chunk> chunk;
+    ChunkGfx gfx;
+    // When the chunk was cached, chunks are never used while cached so the oldest is the least recently used
+    uint32_t age;
+};
+
+struct ChunkCacheStats {
+    // Chunks that became visible again while they were cached
+    uint32_t hits;
+    // Chunks that had to be loaded from rom
+    uint32_t misses;
+    // Cached chunks freed to make room or because memory was low
+    uint32_t evictions;
+};
+
+// Counts from the last Grid::draw, for comparing how many tile draws culling saves
+struct GridDrawStats {
+    // Loaded chunks drawn whole, drawn column by column because they cross the edge of the view, or skipped entirely
+    uint16_t chunks_drawn;
+    uint16_t chunks_partial;
+    uint16_t chunks_culled;
+    // Columns of partially drawn chunks that were outside of the view
+    uint16_t columns_culled;
+    // Tile draws that the chunks drawn with their tiles would take without any culling, and how many were actually drawn
+    uint32_t tile_draws_total;
+    uint32_t tile_draws_issued;
+    // Tile draws left out when the chunks were loaded because other tiles hide them (included in the total)
+    uint32_t tile_draws_occluded;
+};
+
 // Represents the level grid, which contains a definition of tile types and an array containing all of the level's tiles
 class Grid {
 public:
     Grid() :
-        definition_{}, tile_types_{}, loaded_chunks_{}, loading_chunks_{}
+        definition_{}, tile_types_{}, tile_lods_{}, chunk_array_{}, loaded_chunks_{}, loading_chunks_{}, cached_chunks_{}, chunk_table_{},
+        chunk_cache_age_{}, chunk_cache_stats_{}, draw_stats_{}, prev_target_x_{}, prev_target_z_{}, camera_vel_x_{}, camera_vel_z_{}, has_prev_target_{false}
     {}
     Grid(GridDefinition definition, dynamic_array<TileType>&& tile_types) :
-        definition_(definition), tile_types_{std::move(tile_types)}, loaded_chunks_{}, loading_chunks_{}
-    {}
+        definition_(definition), tile_types_{std::move(tile_types)}, tile_lods_{}, chunk_array_{}, loaded_chunks_{}, loading_chunks_{}, cached_chunks_{},
+        chunk_table_{}, chunk_cache_age_{}, chunk_cache_stats_{}, draw_stats_{}, prev_target_x_{}, prev_target_z_{}, camera_vel_x_{}, camera_vel_z_{}, has_prev_target_{false}
+    {
+        load_chunk_array();
+        setup_tile_lods();
+    }
     ~Grid()
     {
+        wait_for_chunk_builds();
         for (auto& tile_type : tile_types_)
         {
             if (tile_type.model != nullptr)
             {
-                freeAlloc(tile_type.model);
+                release_asset(tile_type.model);
             }
             tile_type.model = nullptr;
         }
@@ -168,18 +326,23 @@ public:
     //     return tiles_[row * width_ + col];
     // }
     // void set_tile(unsigned int row, unsigned int col, Tile type) { tiles_[row * width_ + col] = type; }
-    void get_loaded_chunks_in_area(int min_chunk_x, int min_chunk_z, int max_chunk_x, int max_chunk_z, bool* found);
+    // Set of chunk positions that fits every loaded and loading chunk
+    using chunk_pos_set = static_set<chunk_pos, max_loaded_chunks + max_loading_chunks>;
+    void get_loaded_chunks_in_area(int min_chunk_x, int min_chunk_z, int max_chunk_x, int max_chunk_z, chunk_pos_set& found);
     bool is_loaded(chunk_pos pos);
     bool is_pos_loaded(float x, float z);
     bool is_loaded_or_loading(chunk_pos pos);
     void load_visible_chunks(Camera& camera);
     void unload_nonvisible_chunks(Camera& camera);
-    void load_chunk(chunk_pos pos);
+    void prefetch_chunks(Camera& camera);
+    void load_chunk(chunk_pos pos, bool prefetch = false);
     void process_loading_chunks();
     void load_objects();
     float get_height(float x, float z, float radius, float min_y, float max_y, int16_t* floor_tile_x, int16_t* floor_tile_z, tile_id* floor_tile);
     int get_wall_collisions(Vec3 hits[4], float dists[4], float x, float z, float radius, float y_min, float y_max);
     chunk_pos get_minimum_loaded_chunk();
+    const ChunkCacheStats& get_chunk_cache_stats() const { return chunk_cache_stats_; }
+    const GridDrawStats& get_draw_stats() const { return draw_stats_; }
 
     void draw(Camera *camera);
 
@@ -189,20 +352,106 @@ public:
     // Copy assignment
     Grid& operator=(const Grid&) = delete;
     // Move assignment
-    Grid& operator=(Grid&&) = default;
+    Grid& operator=(Grid&& rhs)
+    {
+        wait_for_chunk_builds();
+        rhs.wait_for_chunk_builds();
+        definition_ = rhs.definition_;
+        tile_types_ = std::move(rhs.tile_types_);
+        tile_lods_ = std::move(rhs.tile_lods_);
+        chunk_array_ = std::move(rhs.chunk_array_);
+        loaded_chunks_ = std::move(rhs.loaded_chunks_);
+        loading_chunks_ = std::move(rhs.loading_chunks_);
+        cached_chunks_ = std::move(rhs.cached_chunks_);
+        chunk_cache_age_ = rhs.chunk_cache_age_;
+        chunk_cache_stats_ = rhs.chunk_cache_stats_;
+        draw_stats_ = {};
+        // The chunk table points into the chunk skipfields, which have just moved
+        rebuild_chunk_table();
+        // Start the camera velocity estimate over for the new grid
+        camera_vel_x_ = 0.0f;
+        camera_vel_z_ = 0.0f;
+        has_prev_target_ = false;
+        return *this;
+    }
 
 private:
+    // A slot in the chunk table, each pointer is only valid for the chunk position stored in the entry it points to
+    struct ChunkTableSlot {
+        ChunkEntry* loaded;
+        LoadingChunkEntry* loading;
+    };
+
     GridDefinition definition_;
     dynamic_array<TileType> tile_types_;
+    // How each tile type is drawn in chunk LOD meshes, derived from the tile types' models
+    dynamic_array<TileLodMaterial> tile_lods_;
+    // The grid's chunk array, read from rom once when the grid is created so that loading a chunk doesn't need to
+    // wait on the PI to find where the chunk is
+    dynamic_array<ChunkArrayElement> chunk_array_;
     skipfield<ChunkEntry, max_loaded_chunks> loaded_chunks_;
-    skipfield<std::pair<chunk_pos, LoadHandle>, max_loading_chunks> loading_chunks_;
+    skipfield<LoadingChunkEntry, max_loading_chunks> loading_chunks_;
+    skipfield<CachedChunkEntry, max_cached_chunks> cached_chunks_;
+    std::array<std::array<ChunkTableSlot, chunk_table_height>, chunk_table_width> chunk_table_;
+    uint32_t chunk_cache_age_;
+    ChunkCacheStats chunk_cache_stats_;
+    GridDrawStats draw_stats_;
+    // Camera target position from the previous prefetch and the smoothed per-frame velocity derived from it
+    float prev_target_x_;
+    float prev_target_z_;
+    float camera_vel_x_;
+    float camera_vel_z_;
+    bool has_prev_target_;
+
+    ChunkTableSlot& chunk_slot(chunk_pos pos)
+    {
+        return chunk_table_[pos.first & (chunk_table_width - 1)][pos.second & (chunk_table_height - 1)];
+    }
+    // Returns the loaded chunk at the given position, or nullptr if it isn't loaded
+    ChunkEntry* find_loaded_chunk(chunk_pos pos)
+    {
+        ChunkEntry* entry = chunk_slot(pos).loaded;
+        return (entry != nullptr && entry->pos == pos) ? entry : nullptr;
+    }
+    void rebuild_chunk_table();
+    void load_chunk_array();
+    void setup_tile_lods();
+    const ChunkArrayElement& get_chunk_array_element(chunk_pos pos)
+    {
+        return chunk_array_[pos.second + definition_.num_chunks_z * pos.first];
+    }
+    // Searches a column for the highest floor below the given tile height whose surface is within [min_y, max_y)
+    bool find_lower_floor(const ChunkColumn& column, int below_y, int local_x, int local_z, int radius_int, float min_y, float max_y, float* floor_y, tile_id* floor_id);
+    float chunk_arrival_frames(chunk_pos pos, float target_x, float target_z);
+
+    using cached_chunk_iterator = decltype(cached_chunks_)::iterator;
+    cached_chunk_iterator find_cached_chunk(chunk_pos pos)
+    {
+        return std::find_if(cached_chunks_.begin(), cached_chunks_.end(), [pos](const CachedChunkEntry& entry) { return entry.pos == pos; });
+    }
+    // Moves a chunk that's being unloaded into the cache, unless memory is too low to keep it
+    void cache_chunk(ChunkEntry& entry);
+    // Frees the least recently cached chunk, returns false if there were no cached chunks
+    bool evict_cached_chunk();
 
     using loaded_chunk_iterator = decltype(loaded_chunks_)::iterator;
     loaded_chunk_iterator unload_chunk(loaded_chunk_iterator it)
     {
-        // unique_ptr will handle freeing the chunk data
+        chunk_slot(it->pos).loaded = nullptr;
+        cache_chunk(*it);
+        // If the chunk wasn't cached, relocatable_ptr will handle freeing the chunk data
         return loaded_chunks_.erase(it);
     }
+    // Waits for the chunk thread to build every chunk it's been handed, since it writes into the loading chunk entries
+    void wait_for_chunk_builds();
+    using loading_chunk_iterator = decltype(loading_chunks_)::iterator;
+    // Only valid for chunks that try_cancel_chunk_load has said can be dropped, as an in-flight DMA or the chunk thread
+    // would write into the freed chunk
+    loading_chunk_iterator cancel_loading_chunk(loading_chunk_iterator it)
+    {
+        chunk_slot(it->pos).loading = nullptr;
+        return loading_chunks_.erase(it);
+    }
 };
 
 // Tile& GridPosProxy::operator[](unsigned int col) { return grid.get_tile(row, col); }
@@ -4,6 +4,8 @@
 #include <types.h>
 
 void platformInit(void);
+// Microseconds since startup, for spreading work over frames (wraps around after about 71 minutes)
+uint32_t platformTimeUs(void);
 
 extern uint32_t g_gameTimer; // Counts up every game logic frame (60 fps)
 extern uint32_t g_graphicsTimer; // Counters up every graphics frame (dependent on if FPS30 is set)
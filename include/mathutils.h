@@ -81,6 +81,20 @@ void mtxfEulerXYZ(MtxF out, int16_t rx, int16_t ry, int16_t rz);
 void mtxfEulerXYZInverse(MtxF out, int16_t rx, int16_t ry, int16_t rz);
 void mtxfRotateVec(MtxF mat, Vec3 vecIn, Vec3 vecOut);
 
+// A view frustum's 6 planes, each as {a, b, c, d} with the inside of the plane being where a * x + b * y + c * z + d >= 0
+struct Frustum {
+    float planes[6][4];
+};
+
+enum class FrustumTest : uint8_t {
+    outside,
+    intersecting,
+    inside,
+};
+
+void frustumFromViewProj(Frustum *out, MtxF viewProj);
+FrustumTest frustumTestAABB(const Frustum *frustum, const Vec3 min, const Vec3 max);
+
 float approachFloatLinear(float current, float goal, float amount);
 
 #endif
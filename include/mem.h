@@ -18,6 +18,7 @@ typedef uint8_t owner_t;
 #define ALLOC_AUDIO      2
 #define ALLOC_ECS        3
 #define ALLOC_FILE       4
+#define ALLOC_CHUNK      5
 
 #define ALLOC_MALLOC     252 // Memory allocated by malloc
 #define ALLOC_NEW        253 // Memory allocated by new
@@ -49,6 +50,17 @@ void *allocRegion(int length, owner_t owner);
 // Free a region of allocated memory
 void freeAlloc(void *start) noexcept;
 
+// Snapshot of the memory pool's usage, in blocks of mem_block_size
+struct MemoryStats {
+    size_t total_blocks;
+    size_t free_blocks;
+    // The fewest free blocks there have been at once since the pool was initialized
+    size_t min_free_blocks;
+};
+
+// Gets the current memory pool usage, free blocks aren't necessarily contiguous
+MemoryStats getMemoryStats();
+
 // Deleter class for use with unique_ptr when holding memory allocated with allocRegion/allocChunks
 class alloc_deleter
 {
@@ -56,4 +68,75 @@ public:
     void operator()(void* ptr) { freeAlloc(ptr); }
 };
 
+// Called after a relocatable allocation has been moved by the heap compactor, used to fix up any absolute pointers
+// that the allocation holds into itself. The old region still holds a copy of the data when this is called, and is
+// freed right after it returns.
+using relocate_callback_t = void (*)(void* new_addr, void* old_addr);
+
+// An allocation that the heap compactor is allowed to move to a lower address while it isn't pinned.
+// Code holding one of these must always go through `ptr` (double indirection) and must not keep the raw address
+// across a call to compactHeap unless the allocation is pinned.
+struct RelocatableAlloc {
+    void *ptr;
+    relocate_callback_t on_relocate;
+    uint16_t num_blocks;
+    uint8_t pin_count;
+    owner_t owner;
+};
+
+using reloc_handle_t = RelocatableAlloc*;
+
+// Allocates a relocatable region of memory at least as large as the given length, returns nullptr on failure
+reloc_handle_t allocRelocatable(int length, owner_t owner, relocate_callback_t on_relocate);
+// Frees a relocatable allocation and its handle
+void freeRelocatable(reloc_handle_t handle) noexcept;
+// Moves relocatable allocations into the lowest free regions of the heap, stopping once the given number of blocks
+// have been moved. The first allocation moved can be larger than that, so large allocations still get moved eventually.
+// Returns the number of blocks that were moved.
+int compactHeap(int max_blocks);
+
+// Owning pointer to a relocatable allocation, analogous to unique_ptr<T, alloc_deleter>
+template <typename T>
+class relocatable_ptr
+{
+public:
+    relocatable_ptr() : handle_(nullptr) {}
+    explicit relocatable_ptr(reloc_handle_t handle) : handle_(handle) {}
+    ~relocatable_ptr() { reset(); }
+    relocatable_ptr(const relocatable_ptr&) = delete;
+    relocatable_ptr& operator=(const relocatable_ptr&) = delete;
+    relocatable_ptr(relocatable_ptr&& rhs) : handle_(rhs.handle_) { rhs.handle_ = nullptr; }
+    relocatable_ptr& operator=(relocatable_ptr&& rhs)
+    {
+        if (this != &rhs)
+        {
+            reset();
+            handle_ = rhs.handle_;
+            rhs.handle_ = nullptr;
+        }
+        return *this;
+    }
+
+    T* get() const { return static_cast<T*>(handle_->ptr); }
+    T* operator->() const { return get(); }
+    T& operator*() const { return *get(); }
+    explicit operator bool() const { return handle_ != nullptr; }
+
+    // Prevents the compactor from moving the allocation, e.g. while a DMA into it is in flight
+    void pin() { handle_->pin_count++; }
+    void unpin() { handle_->pin_count--; }
+
+    void reset()
+    {
+        if (handle_ != nullptr)
+        {
+            freeRelocatable(handle_);
+        }
+        // Null the handle so that destroying an already destroyed pointer (e.g. an erased skipfield slot) is harmless
+        handle_ = nullptr;
+    }
+private:
+    reloc_handle_t handle_;
+};
+
 #endif
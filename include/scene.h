@@ -10,6 +10,8 @@ public:
     virtual ~Scene() {}
     // Called every frame after the scene is constructed, stops being called once it returns true
     virtual bool load() = 0;
+    // How much of the scene's load is done as a percentage, for scenes whose load takes more than one frame
+    virtual int load_progress() { return 0; }
     // Called every frame while the scene is active at a fixed 60Hz rate for logic handling
     virtual void update() = 0;
     // Called every frame while the scene is active every frame for drawing the scene contents
@@ -29,5 +31,7 @@ public:
 
 void start_scene_load(std::unique_ptr<Scene>&& new_scene);
 bool is_scene_loading();
+// Percentage of the loading scene's load that's done, or 100 if no scene is loading
+int get_scene_load_progress();
 
 #endif
@@ -1,19 +1,26 @@
 #ifndef __SKIPFIELD_H__
 #define __SKIPFIELD_H__
 
+#include <algorithm>
+#include <cstdint>
 #include <iterator>
 #include <array>
 #include <initializer_list>
+#include <utility>
 
 // Stores a sequence of elements that can be inserted to and removed from without invalidating element pointers or
 // moving elements around. Elements are stored in an underlying array that can have gaps, which are automatically
-// skipped by iterators. Insertion places the new element into the first free space in the array.
+// skipped by iterators.
 // Stores an array of bytes that's used to determine if a given slot in the underlying array is free or not.
-// A value of 0 indicates the slot is occupied, a value of 0xFF indicates that the slot is free.
-// 0xFF is used to indicate free slots because it allows the compiler to load -1 into a register and write to multiple
-// slots at once (the full register width) when clearing the skipfield, as opposed to 1 which would incur a memset instead.
+// A value of 0 indicates the slot is occupied, any other value indicates that the slot is free.
+// The free slots are tracked as runs of consecutive free slots (a jump-counting skipfield, as in plf::colony): the first
+// and last byte of each run hold the length of the run, so iterators jump over a whole run in a single step.
+// The values of the bytes inside of a run are meaningless beyond being nonzero.
+// The start of every run is also kept in a doubly linked free list, which makes insertion and erasure O(1).
+// Insertion places the new element at the start of the most recently freed run, not necessarily the first free slot.
 template <typename T, size_t Length>
 class skipfield {
+    static_assert(Length < 0xFF, "Skipfield run lengths and free list links must fit in a byte");
 public:
     struct Iterator {
         using iterator_category = std::bidirectional_iterator_tag;
@@ -27,40 +34,36 @@ public:
         constexpr pointer operator->() { return ptr_; }
         constexpr Iterator& operator++()
         {
-            do
-            {
-                ptr_++;
-                skipped_++;
-            } while (*skipped_);
+            ptr_++;
+            skipped_++;
+            ptr_ += *skipped_;
+            skipped_ += *skipped_;
             return *this;
         }
         constexpr Iterator& operator--()
         {
-            do
-            {
-                ptr_--;
-                skipped_--;
-            } while (*skipped_);
+            ptr_--;
+            skipped_--;
+            ptr_ -= *skipped_;
+            skipped_ -= *skipped_;
             return *this;
         }
         constexpr Iterator operator++(int)
         {
             Iterator tmp = *this;
-            do
-            {
-                ptr_++;
-                skipped_++;
-            } while (*skipped_);
+            ptr_++;
+            skipped_++;
+            ptr_ += *skipped_;
+            skipped_ += *skipped_;
             return tmp;
         }
         constexpr Iterator operator--(int)
         {
             Iterator tmp = *this;
-            do
-            {
-                ptr_--;
-                skipped_--;
-            } while (*skipped_);
+            ptr_--;
+            skipped_--;
+            ptr_ -= *skipped_;
+            skipped_ -= *skipped_;
             return tmp;
         }
 
@@ -82,40 +85,36 @@ public:
         constexpr pointer operator->() { return ptr_; }
         constexpr ConstIterator& operator++()
         {
-            do
-            {
-                ptr_++;
-                skipped_++;
-            } while (*skipped_);
+            ptr_++;
+            skipped_++;
+            ptr_ += *skipped_;
+            skipped_ += *skipped_;
             return *this;
         }
         constexpr ConstIterator& operator--()
         {
-            do
-            {
-                ptr_--;
-                skipped_--;
-            } while (*skipped_);
+            ptr_--;
+            skipped_--;
+            ptr_ -= *skipped_;
+            skipped_ -= *skipped_;
             return *this;
         }
         constexpr ConstIterator operator++(int)
         {
             ConstIterator tmp = *this;
-            do
-            {
-                ptr_++;
-                skipped_++;
-            } while (*skipped_);
+            ptr_++;
+            skipped_++;
+            ptr_ += *skipped_;
+            skipped_ += *skipped_;
             return tmp;
         }
         constexpr ConstIterator operator--(int)
         {
             ConstIterator tmp = *this;
-            do
-            {
-                ptr_--;
-                skipped_--;
-            } while (*skipped_);
+            ptr_--;
+            skipped_--;
+            ptr_ -= *skipped_;
+            skipped_ -= *skipped_;
             return tmp;
         }
 
@@ -145,46 +144,48 @@ public:
     constexpr skipfield() :
         data_{},
         skipped_{},
+        next_run_{},
+        prev_run_{},
+        free_head_(no_run),
         num_items_(0)
     {
-        skipped_.fill(0xFF);
-        skipped_.back() = 0;
+        reset_free(0);
     }
 
 
     constexpr explicit skipfield(size_type size) :
         data_{},
         skipped_{},
+        next_run_{},
+        prev_run_{},
+        free_head_(no_run),
         num_items_(size)
     {
-        auto stop = skipped_.begin() + size;
-        std::fill(skipped_.begin(), stop, 0);
-        std::fill(stop, skipped_.end(), 0xFF);
-        skipped_.back() = 0;
+        reset_free(size);
     }
 
     constexpr explicit skipfield(size_type size, const T& value) :
         data_{},
         skipped_{},
+        next_run_{},
+        prev_run_{},
+        free_head_(no_run),
         num_items_(size)
     {
-        auto stop = skipped_.begin() + size;
-        std::fill(skipped_.begin(), stop, 0);
-        std::fill(stop, skipped_.end(), 0xFF);
+        reset_free(size);
         std::fill_n(data_.begin(), size, value);
-        skipped_.back() = 0;
     }
 
     constexpr skipfield(std::initializer_list<T> list) :
         data_{},
         skipped_{},
+        next_run_{},
+        prev_run_{},
+        free_head_(no_run),
         num_items_(list.size())
     {
-        auto stop = skipped_.begin() + num_items_;
-        std::fill(skipped_.begin(), stop, 0);
-        std::fill(stop, skipped_.end(), 0xFF);
+        reset_free(num_items_);
         std::copy(list.begin(), list.end(), data_.begin());
-        skipped_.back() = 0;
     }
 
     // Destructor (nothing needed)
@@ -194,6 +195,9 @@ public:
     constexpr skipfield(const skipfield& rhs) :
         data_{rhs.data_},
         skipped_{rhs.skipped_},
+        next_run_{rhs.next_run_},
+        prev_run_{rhs.prev_run_},
+        free_head_{rhs.free_head_},
         num_items_{rhs.num_items_}
     {}
     
@@ -201,6 +205,9 @@ public:
     constexpr skipfield(skipfield&& other) noexcept :
         data_(std::move(other.data_)),
         skipped_(std::move(other.skipped_)),
+        next_run_(other.next_run_),
+        prev_run_(other.prev_run_),
+        free_head_(other.free_head_),
         num_items_(std::exchange(other.num_items_, 0))
     {}
     
@@ -210,6 +217,9 @@ public:
         if (this == &rhs) return *this;
         data_ = rhs.data_;
         skipped_ = rhs.skipped_;
+        next_run_ = rhs.next_run_;
+        prev_run_ = rhs.prev_run_;
+        free_head_ = rhs.free_head_;
         num_items_ = rhs.num_items_;
         return *this;
     }
@@ -219,6 +229,9 @@ public:
     {
         data_ = std::move(rhs.data_);
         skipped_ = std::move(rhs.skipped_);
+        next_run_ = rhs.next_run_;
+        prev_run_ = rhs.prev_run_;
+        free_head_ = rhs.free_head_;
         num_items_ = std::exchange(rhs.num_items_, 0);
         return *this;
     }
@@ -238,10 +251,13 @@ public:
     constexpr iterator erase(const_iterator pos) noexcept
     {
         iterator ret{const_cast<pointer>(pos.ptr_), const_cast<uint8_t*>(pos.skipped_)};
-        *ret.skipped_ = 0xFF;
-        ret.ptr_->~T();
+        size_type idx = ret.skipped_ - skipped_.data();
+        // Find the next element before freeing the slot, since merging runs can overwrite the skip value after it
+        ++ret;
+        data_[idx].~T();
+        free_slot(idx);
         num_items_--;
-        return ++ret;
+        return ret;
     }
 
     // Erases the element at the given address
@@ -250,8 +266,8 @@ public:
         size_t index = (element - data_.data());
         if (skipped_[index] == 0)
         {
-            skipped_[index] = 0xFF;
             element->~T();
+            free_slot(index);
             num_items_--;
         }
     }
@@ -262,8 +278,7 @@ public:
         {
             return end();
         }
-        int idx = first_free();
-        skipped_[idx] = 0;
+        size_type idx = take_free();
         new (&data_[idx]) T(value);
         num_items_++;
         return iterator{&data_[idx], &skipped_[idx]};
@@ -276,8 +291,7 @@ public:
         {
             return end();
         }
-        int idx = first_free();
-        skipped_[idx] = 0;
+        size_type idx = take_free();
         new (&data_[idx]) T(std::forward<Args>(args)...);
         num_items_++;
         return iterator{&data_[idx], &skipped_[idx]};
@@ -286,38 +300,139 @@ public:
     constexpr size_type size() const noexcept { return num_items_; }
     constexpr bool empty() const noexcept { return num_items_ == 0; }
     constexpr bool full() const noexcept { return num_items_ == Length; }
-    constexpr void clear() noexcept { num_items_ = 0; std::fill_n(skipped_.begin(), Length, 0xFF); }
+    constexpr void clear() noexcept { num_items_ = 0; reset_free(0); }
 public:
+    // Free list link value that indicates there's no run
+    static constexpr uint8_t no_run = 0xFF;
+
     std::array<T, Length> data_;
+    // One byte per slot, plus a trailing zero so iterators stop at the end
     std::array<uint8_t, Length + 1> skipped_;
+    // Free list links, only meaningful at the first slot of each free run
+    std::array<uint8_t, Length> next_run_;
+    std::array<uint8_t, Length> prev_run_;
+    uint8_t free_head_;
     size_type num_items_;
 
-    constexpr __attribute__((noinline)) size_type first_idx() const
+    // The first slot is either occupied (0) or the start of a run that ends right before the first element
+    constexpr size_type first_idx() const
     {
-        size_type i;
-        for (i = 0; skipped_[i] && i < Length; i++);
-        return i;
+        return skipped_[0];
     }
 
+    // Returns -1 if the skipfield is empty
     constexpr size_type last_idx() const
     {
-        size_type i;
-        for (i = Length - 1; skipped_[i] && i != static_cast<size_type>(-1); i--);
-        return i;
+        return Length - 1 - skipped_[Length - 1];
     }
 
     constexpr size_type first_free() const
     {
-        size_type i;
-        for (i = 0; !skipped_[i] && i < Length; i++);
-        return i;
+        return free_head_ == no_run ? Length : free_head_;
+    }
+
+    // Marks every slot from `start` onwards as a single free run and every slot before it as occupied
+    constexpr void reset_free(size_type start)
+    {
+        std::fill_n(skipped_.begin(), start, 0);
+        skipped_[Length] = 0;
+        if (start == Length)
+        {
+            free_head_ = no_run;
+            return;
+        }
+        // Nonzero filler for the inside of the run, followed by the run's length at each end
+        std::fill(skipped_.begin() + start, skipped_.begin() + Length, 0xFF);
+        set_run(start, Length - start);
+        next_run_[start] = no_run;
+        prev_run_[start] = no_run;
+        free_head_ = start;
+    }
+
+    // Writes the length of a run into its first and last slots
+    constexpr void set_run(size_type start, size_type length)
+    {
+        skipped_[start] = length;
+        skipped_[start + length - 1] = length;
+    }
+
+    // Makes `new_start` take the place of `old_start` in the free list
+    constexpr void replace_run(size_type old_start, size_type new_start)
+    {
+        uint8_t prev = prev_run_[old_start];
+        uint8_t next = next_run_[old_start];
+        prev_run_[new_start] = prev;
+        next_run_[new_start] = next;
+        if (prev == no_run) { free_head_ = new_start; } else { next_run_[prev] = new_start; }
+        if (next != no_run) { prev_run_[next] = new_start; }
     }
 
-    constexpr size_type last_free() const
+    // Removes the run starting at `start` from the free list
+    constexpr void remove_run(size_type start)
     {
-        size_type i;
-        for (i = Length - 1; !skipped_[i] && i != static_cast<size_type>(-1); i--);
-        return i;
+        uint8_t prev = prev_run_[start];
+        uint8_t next = next_run_[start];
+        if (prev == no_run) { free_head_ = next; } else { next_run_[prev] = next; }
+        if (next != no_run) { prev_run_[next] = prev; }
+    }
+
+    // Occupies the first slot of the run at the head of the free list and returns its index
+    constexpr size_type take_free()
+    {
+        size_type idx = free_head_;
+        size_type length = skipped_[idx];
+        skipped_[idx] = 0;
+        if (length > 1)
+        {
+            // Shrink the run from the front, it keeps its place in the free list
+            set_run(idx + 1, length - 1);
+            replace_run(idx, idx + 1);
+        }
+        else
+        {
+            remove_run(idx);
+        }
+        return idx;
+    }
+
+    // Marks the given slot as free, merging it with any free runs on either side of it
+    constexpr void free_slot(size_type idx)
+    {
+        // The length of the run ending right before this slot and the run starting right after it (0 if occupied)
+        // The trailing zero byte means the slot after the last one always reads as occupied
+        size_type left_length = idx > 0 ? skipped_[idx - 1] : 0;
+        size_type right_length = skipped_[idx + 1];
+
+        if (right_length != 0 && left_length != 0)
+        {
+            // Extend the left run over this slot and the right run, which leaves the free list
+            remove_run(idx + 1);
+            skipped_[idx] = 0xFF;
+            set_run(idx - left_length, left_length + 1 + right_length);
+        }
+        else if (left_length != 0)
+        {
+            // Extend the left run over this slot, its start (and thus free list entry) doesn't change
+            set_run(idx - left_length, left_length + 1);
+        }
+        else if (right_length != 0)
+        {
+            // This slot becomes the new start of the right run
+            replace_run(idx + 1, idx);
+            set_run(idx, right_length + 1);
+        }
+        else
+        {
+            // New run of one slot, push it onto the free list
+            skipped_[idx] = 1;
+            next_run_[idx] = free_head_;
+            prev_run_[idx] = no_run;
+            if (free_head_ != no_run)
+            {
+                prev_run_[free_head_] = idx;
+            }
+            free_head_ = idx;
+        }
     }
 };
 
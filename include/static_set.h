@@ -0,0 +1,109 @@
+#ifndef __STATIC_SET_H__
+#define __STATIC_SET_H__
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#include <static_vector.h>
+
+// Default hashes for static_set, which only need to spread keys over the upper bits (see static_set::slot_for)
+template <typename T>
+struct static_set_hash;
+
+template <typename T>
+struct static_set_hash<T*> {
+    uint32_t operator()(const T* ptr) const noexcept
+    {
+        // The low bits of a pointer are mostly alignment, so drop them
+        return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(ptr) >> 2);
+    }
+};
+
+template <typename T> requires std::is_integral_v<T>
+struct static_set_hash<T> {
+    constexpr uint32_t operator()(T value) const noexcept { return static_cast<uint32_t>(value); }
+};
+
+template <typename A, typename B>
+struct static_set_hash<std::pair<A, B>> {
+    constexpr uint32_t operator()(const std::pair<A, B>& value) const noexcept
+    {
+        return (static_set_hash<A>{}(value.first) << 16) ^ static_set_hash<B>{}(value.second);
+    }
+};
+
+// A set with a fixed capacity and no heap allocations, meant for deduplicating small batches of keys (e.g. which
+// entities have already been tested this frame). The elements are kept densely in a static_vector in insertion order,
+// with a linear probing hash index of twice the capacity pointing into it, so lookups and insertions are O(1) on average
+// and clearing only touches the index bytes. Elements can't be individually removed, only cleared all at once.
+template <typename T, size_t Capacity, typename Hash = static_set_hash<T>>
+class static_set {
+    static_assert(Capacity < 0xFF, "Static set indices must fit in a byte");
+public:
+    using value_type     = T;
+    using size_type      = std::size_t;
+    using const_iterator = typename static_vector<T, Capacity>::const_iterator;
+
+    constexpr static_set() : elements_{}, index_{} {}
+
+    constexpr const_iterator begin() const noexcept { return elements_.begin(); }
+    constexpr const_iterator end() const noexcept { return elements_.end(); }
+
+    constexpr bool contains(const value_type& value) const noexcept
+    {
+        for (size_type slot = slot_for(value); index_[slot] != empty_slot; slot = (slot + 1) & (table_size - 1))
+        {
+            if (elements_[index_[slot] - 1] == value)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Returns true if the value was inserted, or false if it was already present or the set is full
+    constexpr bool insert(const value_type& value) noexcept
+    {
+        size_type slot = slot_for(value);
+        for (; index_[slot] != empty_slot; slot = (slot + 1) & (table_size - 1))
+        {
+            if (elements_[index_[slot] - 1] == value)
+            {
+                return false;
+            }
+        }
+        if (elements_.full())
+        {
+            return false;
+        }
+        elements_.push_back(value);
+        index_[slot] = static_cast<uint8_t>(elements_.size());
+        return true;
+    }
+
+    constexpr size_type size() const noexcept { return elements_.size(); }
+    constexpr bool empty() const noexcept { return elements_.empty(); }
+    constexpr bool full() const noexcept { return elements_.full(); }
+    constexpr void clear() noexcept { elements_.clear(); index_.fill(empty_slot); }
+private:
+    // Keeping the table at most half full keeps probe sequences short
+    static constexpr size_type table_size = std::bit_ceil(Capacity * 2);
+    static constexpr int table_bits = std::countr_zero(table_size);
+    // Index entries hold the element's position plus one, so zero can mean empty
+    static constexpr uint8_t empty_slot = 0;
+
+    static_vector<T, Capacity> elements_;
+    std::array<uint8_t, table_size> index_;
+
+    // Fibonacci hashing, takes the top bits of the product so that keys differing only in their low bits still spread out
+    static constexpr size_type slot_for(const value_type& value) noexcept
+    {
+        return static_cast<uint32_t>(Hash{}(value) * 2654435769u) >> (32 - table_bits);
+    }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef __STATIC_VECTOR_H__
+#define __STATIC_VECTOR_H__
+
+#include <array>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
+// A vector with a fixed capacity whose elements are stored inline, so it can live on the stack or in a static
+// without touching the heap. Elements are always contiguous, so removal from the middle swaps in the last element
+// instead of shifting. Like skipfield, the storage is a plain array so T must be default constructible.
+template <typename T, size_t Capacity>
+class static_vector {
+public:
+    using value_type             = T;
+    using size_type              = std::size_t;
+    using difference_type        = std::ptrdiff_t;
+    using reference              = value_type&;
+    using const_reference        = const value_type&;
+    using pointer                = value_type*;
+    using const_pointer          = const value_type*;
+    using iterator               = value_type*;
+    using const_iterator         = const value_type*;
+    using reverse_iterator       = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+    constexpr static_vector() : data_{}, size_(0) {}
+
+    constexpr const_iterator begin() const noexcept { return data_.data(); }
+    constexpr iterator       begin()       noexcept { return data_.data(); }
+
+    constexpr const_iterator end() const noexcept { return data_.data() + size_; }
+    constexpr iterator       end()       noexcept { return data_.data() + size_; }
+
+    constexpr const_reverse_iterator rbegin() const noexcept { return std::make_reverse_iterator(end()); }
+    constexpr reverse_iterator       rbegin()       noexcept { return std::make_reverse_iterator(end()); }
+
+    constexpr const_reverse_iterator rend() const noexcept { return std::make_reverse_iterator(begin()); }
+    constexpr reverse_iterator       rend()       noexcept { return std::make_reverse_iterator(begin()); }
+
+    constexpr const_reference operator[](size_type index) const noexcept { return data_[index]; }
+    constexpr reference       operator[](size_type index)       noexcept { return data_[index]; }
+
+    constexpr const_pointer data() const noexcept { return data_.data(); }
+    constexpr pointer       data()       noexcept { return data_.data(); }
+
+    constexpr const_reference back() const noexcept { return data_[size_ - 1]; }
+    constexpr reference       back()       noexcept { return data_[size_ - 1]; }
+
+    // Returns end() if the vector is full
+    constexpr iterator push_back(const value_type& value) noexcept
+    {
+        if (size_ == Capacity)
+        {
+            return end();
+        }
+        data_[size_] = value;
+        return &data_[size_++];
+    }
+
+    // Returns end() if the vector is full
+    template <typename... Args>
+    constexpr iterator emplace_back(Args&&... args) noexcept
+    {
+        if (size_ == Capacity)
+        {
+            return end();
+        }
+        data_[size_] = T(std::forward<Args>(args)...);
+        return &data_[size_++];
+    }
+
+    constexpr void pop_back() noexcept { size_--; }
+
+    // Removes the element at the given position by moving the last element into its place
+    // Returns the position, which now holds the element that was last (or end() if the erased element was the last)
+    constexpr iterator erase_unordered(const_iterator pos) noexcept
+    {
+        iterator it = begin() + (pos - begin());
+        size_--;
+        if (it != end())
+        {
+            *it = std::move(data_[size_]);
+        }
+        return it;
+    }
+
+    constexpr size_type size() const noexcept { return size_; }
+    static constexpr size_type capacity() noexcept { return Capacity; }
+    constexpr bool empty() const noexcept { return size_ == 0; }
+    constexpr bool full() const noexcept { return size_ == Capacity; }
+    constexpr void clear() noexcept { size_ = 0; }
+private:
+    std::array<T, Capacity> data_;
+    size_type size_;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef __TILE_COLLISIONS_H__
+#define __TILE_COLLISIONS_H__
+
+#include <array>
+#include <cstdint>
+
+// Shared with levelconv, which bakes each chunk's floors and walls from these collision types, so this header can't
+// depend on anything else in the game
+
+enum class TileCollision : uint8_t {
+    none,
+    floor,
+    wall,
+    slope,
+};
+
+// Collision type of each tile id
+constexpr std::array<TileCollision, 32> tile_collisions {
+    TileCollision::floor, // metalRim.mid
+    TileCollision::floor, // metalGrate
+    TileCollision::floor, // dirtrocky.B
+    TileCollision::floor, // stone.A
+    TileCollision::floor, // grass.A
+    TileCollision::floor, // dirt.A
+    TileCollision::floor, // metalEmboss
+    TileCollision::floor, // water_dirtrocky.A
+    TileCollision::slope, // metalRamp
+    TileCollision::floor, // stoneLava.A
+    TileCollision::slope, // dirtRockyRamp
+    TileCollision::slope, // stone_Ramp
+    TileCollision::slope, // dirtrockyXstone_Ramp
+    TileCollision::wall,  // stone_Obstacle
+    TileCollision::slope, // SlopeWhite
+    TileCollision::floor, // crop.B
+    TileCollision::wall,  // wall_Out
+    TileCollision::wall,  // crop_Obstacle
+    TileCollision::wall,  // WallBrown
+    TileCollision::wall,  // wall_stone2
+    TileCollision::wall,  // metalObstacle
+    TileCollision::wall,  // WallRed
+    TileCollision::wall,  // WallWhite
+    TileCollision::wall,  // WallYellow
+    TileCollision::wall,  // wallC_Out
+    TileCollision::floor, // grass.B
+    TileCollision::floor, // grass.C
+    TileCollision::wall,  // wallC_stone2
+    TileCollision::floor, // grass.D
+    TileCollision::wall,  // CornerRed
+    TileCollision::wall,  // invisible wall
+    TileCollision::wall,  // mainframe
+};
+
+#endif
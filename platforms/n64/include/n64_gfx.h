@@ -79,6 +79,15 @@ void addMtxToDrawLayer(DrawLayer drawLayer, Mtx* mtx);
 
 void drawGfx(DrawLayer layer, Gfx *toDraw);
 
+struct MaterialHeader;
+
+// Maximum number of commands that writeMaterialReset writes
+constexpr unsigned int material_reset_max_length = 5;
+// Writes the commands that return a draw layer to its default state after the given material, for display lists that
+// are built ahead of time and switch materials themselves. Returns the new end of the display list.
+Gfx* writeMaterialReset(Gfx* gfx_pos, MaterialHeader* material, DrawLayer drawLayer);
+void drawBakedGfx(DrawLayer layer, MaterialHeader *firstMaterial, MaterialHeader *lastMaterial, Gfx *toDraw, Mtx* curMtx);
+
 u8* allocGfx(s32 size);
 
 namespace gfx
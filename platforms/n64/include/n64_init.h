@@ -4,7 +4,7 @@
 #include <ultra64.h>
 #include <config.h>
 
-#define NUM_THREADS 5
+#define NUM_THREADS 6
 
 #define IDLE_THREAD 1
 #define IDLE_THREAD_INDEX (IDLE_THREAD - 1)
@@ -28,6 +28,12 @@
 #define CRASH_THREAD 5
 #define CRASH_THREAD_PRI OS_PRIORITY_APPMAX
 
+#define CHUNK_THREAD 6
+#define CHUNK_THREAD_INDEX (CHUNK_THREAD - 1)
+#define CHUNK_THREAD_STACKSIZE 0x2000
+// Below the main thread, so building loaded chunks only uses the time the game thread spends waiting on the frame
+#define CHUNK_THREAD_PRI 5
+
 #define SCHEDULER_PRI 13
 
 #define NUM_PI_MESSAGES 8
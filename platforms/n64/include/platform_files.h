@@ -1,11 +1,18 @@
 #ifndef __PLATFORM_FILES_H__
 #define __PLATFORM_FILES_H__
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <utility>
 
 struct LoadRxSlot;
+struct LoadSegment;
+enum class LoadPriority : uint8_t;
+
+// Called on the loader thread once a load's data has arrived, before the load is marked as finished
+// Receives the load's destination and the argument that was passed to start_data_load
+using load_callback_t = void(*)(void* data, void* arg);
 
 // Deleter class for use with load receive slots
 class LoadRxSlotDeleter
@@ -39,13 +46,19 @@ public:
     bool is_finished();
     // Waits for the corresponding load to complete
     void* join();
+    // Moves the load to a different class, which also applies to the rest of a load that's been partially read
+    void set_priority(LoadPriority priority);
+    // Cancels the load if none of its data is being read right now and releases the handle, returns whether the load was
+    // cancelled. Destroying a handle also cancels its load if it isn't being read, but the destination has to stay valid
+    // until the current read is done if it is. This lets the caller know whether the destination can be freed right away.
+    bool cancel();
 private:
     std::unique_ptr<LoadRxSlot, LoadRxSlotDeleter> handle_slot_;
     LoadHandle(LoadRxSlot *handle_slot) :
         handle_slot_(handle_slot)
     {}
 
-    friend LoadHandle start_data_load(void*, uint32_t, uint32_t);
+    friend LoadHandle start_load(const LoadSegment*, size_t, uint32_t, load_callback_t, void*, LoadPriority);
 };
 
 #endif
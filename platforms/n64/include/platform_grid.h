@@ -3,10 +3,61 @@
 
 #include <ultra64.h>
 #include <block_vector.h>
+#include <dynamic_array.h>
 #include <n64_gfx.h>
+#include <n64_model.h>
 
+// How one tile type is drawn in chunk LOD meshes, taken from the first material the tile's model draws with
+struct TileLodMaterial {
+    // nullptr if the tile type isn't drawn in LOD meshes
+    MaterialHeader *material;
+    DrawLayer layer;
+    // Texture coordinate span of one tile, in the same units as the model's vertex texture coordinates
+    int16_t s_span;
+    int16_t t_span;
+    // Color or normal of the model's vertices
+    std::array<uint8_t, 4> cn;
+};
+
+// A chunk's display list for one draw layer, which switches between the layer's materials itself
+// The display list is drawn after loading first_material and leaves last_material loaded
+struct ChunkLayerGfx {
+    MaterialHeader *first_material;
+    MaterialHeader *last_material;
+    // nullptr if the chunk has nothing to draw on this layer
+    Gfx *gfx;
+};
+
+using ChunkLayersGfx = std::array<ChunkLayerGfx, gfx::draw_layers>;
+
+// One material draw of a tile in a chunk, sorted by layer and then material in the chunk's gfx
+// Kept after the chunk's display lists are baked so that chunks crossing the edge of the view can be drawn column by column
+struct ChunkTileDraw {
+    MaterialHeader *material;
+    Gfx *gfx;
+    Mtx *mtx;
+    uint8_t layer;
+    uint8_t x;
+    uint8_t z;
+};
+
+// A chunk's display lists, built on the chunk thread once the chunk is loaded and never modified afterwards
+// Everything is relative to the chunk's origin, so drawing a chunk only takes one matrix per frame
 struct ChunkGfx {
-    std::array<block_vector<Mtx>, num_frame_buffers> matrices;
+    // Matrices placing each drawn tile relative to the chunk's origin
+    block_vector<Mtx> matrices;
+    dynamic_array<ChunkTileDraw> tile_draws;
+    std::unique_ptr<Gfx[]> tile_gfx;
+    ChunkLayersGfx tile_layers;
+    // Tile draws that were left out of the display lists because the tiles are hidden under other tiles
+    uint16_t num_occluded_draws;
+    // Height range of the chunk's drawn tiles, in tiles
+    int16_t min_y;
+    int16_t max_y;
+    // The chunk's LOD mesh
+    std::unique_ptr<Vtx[]> lod_verts;
+    std::unique_ptr<Gfx[]> lod_gfx;
+    ChunkLayersGfx lod_layers;
 };
 
 #endif
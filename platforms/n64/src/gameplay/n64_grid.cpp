@@ -1,8 +1,12 @@
 #include <ultra64.h>
 
+#include <algorithm>
+#include <bit>
 #include <cmath>
+#include <limits>
 
 #include <grid.h>
+#include <static_vector.h>
 #include <cstring>
 #include <files.h>
 #include <camera.h>
@@ -16,16 +20,6 @@ extern "C"
 #include <debug.h>
 }
 
-struct filerecord { const char *path; uint32_t offset; uint32_t size; };
-
-class FileRecords
-{
-private:
-  static inline unsigned int hash (const char *str, size_t len);
-public:
-  static const struct filerecord *get_offset (const char *str, size_t len);
-};
-
 extern uint8_t _assetsSegmentStart[];
 // extern OSPiHandle *g_romHandle;
 
@@ -45,38 +39,80 @@ extern uint8_t _assetsSegmentStart[];
 //     osRecvMesg(&queue, nullptr, OS_MESG_BLOCK);
 // }
 
-void GridDefinition::get_chunk_offset_size(unsigned int x, unsigned int z, uint32_t *offset, uint32_t *size)
+void Grid::load_chunk_array()
 {
-    unsigned int chunk_index = z + num_chunks_z * x;
-    uint32_t rom_pos = chunk_index * 2 * sizeof(uint32_t) + chunk_array_rom_offset + (uint32_t)_assetsSegmentStart;
-    uint32_t offset_tmp;
-    osPiReadIo(rom_pos + 0 * sizeof(uint32_t), &offset_tmp);
-    osPiReadIo(rom_pos + 1 * sizeof(uint32_t), size);
-    *offset = offset_tmp + chunk_array_rom_offset;        
+    size_t num_chunks = definition_.num_chunks_x * definition_.num_chunks_z;
+    chunk_array_ = dynamic_array<ChunkArrayElement>(num_chunks);
+    load_data(chunk_array_.data(), (u32)_assetsSegmentStart + definition_.chunk_array_rom_offset, sizeof(ChunkArrayElement) * num_chunks);
+    // Make the chunk offsets relative to the start of the file like the grid definition's offsets
+    for (auto& element : chunk_array_)
+    {
+        element.offset += definition_.chunk_array_rom_offset;
+    }
+}
+
+void Grid::setup_tile_lods()
+{
+    tile_lods_ = dynamic_array<TileLodMaterial>(tile_types_.size());
+    for (size_t tile_idx = 0; tile_idx < tile_types_.size(); tile_idx++)
+    {
+        Model *model = tile_types_[tile_idx].model;
+        if (model == nullptr)
+        {
+            continue;
+        }
+        // Use the first material draw of the tile's model
+        const Joint& joint = model->joints[0];
+        for (size_t cur_layer = 0; cur_layer < gfx::draw_layers; cur_layer++)
+        {
+            const JointMeshLayer& mesh_layer = joint.layers[cur_layer];
+            if (mesh_layer.num_draws == 0 || mesh_layer.draws[0].num_groups == 0)
+            {
+                continue;
+            }
+            const MaterialDraw& draw = mesh_layer.draws[0];
+            // Measure the texture coordinates of the draw's vertices to find how much of the texture one tile covers
+            int min_s = std::numeric_limits<int>::max(), max_s = std::numeric_limits<int>::min();
+            int min_t = std::numeric_limits<int>::max(), max_t = std::numeric_limits<int>::min();
+            for (size_t group_idx = 0; group_idx < draw.num_groups; group_idx++)
+            {
+                const VertexLoad& load = draw.groups[group_idx].load;
+                for (size_t vert_idx = load.start; vert_idx < load.start + load.count; vert_idx++)
+                {
+                    const Vtx_t& vert = model->verts[vert_idx].v;
+                    min_s = std::min<int>(min_s, vert.tc[0]);
+                    max_s = std::max<int>(max_s, vert.tc[0]);
+                    min_t = std::min<int>(min_t, vert.tc[1]);
+                    max_t = std::max<int>(max_t, vert.tc[1]);
+                }
+            }
+            const Vtx_t& first_vert = model->verts[draw.groups[0].load.start].v;
+            tile_lods_[tile_idx] = TileLodMaterial{
+                model->materials[draw.material_index],
+                static_cast<DrawLayer>(cur_layer),
+                static_cast<int16_t>(max_s - min_s),
+                static_cast<int16_t>(max_t - min_t),
+                {first_vert.cn[0], first_vert.cn[1], first_vert.cn[2], first_vert.cn[3]}
+            };
+            break;
+        }
+    }
 }
 
-GridDefinition get_grid_definition(const char *file)
+GridDefinition get_grid_definition(const AssetRecord& level)
 {
     // 16 byte DMA width alignment as recommended by osEPiStartDma manual entry
     uint8_t buf[16];
     GridDefinition ret;
-    auto grid_def_offset = FileRecords::get_offset(file, strlen(file));
-    load_data(buf, (u32)(_assetsSegmentStart + grid_def_offset->offset), sizeof(buf));
+    load_data(buf, (u32)(_assetsSegmentStart + level.offset), sizeof(buf));
     ret = *(GridDefinition*)buf;
-    ret.adjust_offsets(grid_def_offset->offset);
+    ret.adjust_offsets(level.offset);
     return ret;
 }
 
 bool Grid::is_loaded(chunk_pos pos)
 {
-    for (auto& entry : loaded_chunks_)
-    {
-        if (entry.pos == pos)
-        {
-            return true;
-        }
-    }
-    return false;
+    return find_loaded_chunk(pos) != nullptr;
 }
 
 bool Grid::is_pos_loaded(float x, float z)
@@ -92,21 +128,21 @@ bool Grid::is_pos_loaded(float x, float z)
 
 bool Grid::is_loaded_or_loading(chunk_pos pos)
 {
+    const ChunkTableSlot& slot = chunk_slot(pos);
+    return (slot.loaded != nullptr && slot.loaded->pos == pos) || (slot.loading != nullptr && slot.loading->pos == pos);
+}
+
+void Grid::rebuild_chunk_table()
+{
+    chunk_table_ = {};
     for (auto& entry : loading_chunks_)
     {
-        if (entry.first == pos)
-        {
-            return true;
-        }
+        chunk_slot(entry.pos).loading = &entry;
     }
     for (auto& entry : loaded_chunks_)
     {
-        if (entry.pos == pos)
-        {
-            return true;
-        }
+        chunk_slot(entry.pos).loaded = &entry;
     }
-    return false;
 }
 
 inline bool between_inclusive(int min, int max, int val)
@@ -114,30 +150,25 @@ inline bool between_inclusive(int min, int max, int val)
     return val >= min && val <= max;
 }
 
-void Grid::get_loaded_chunks_in_area(int min_chunk_x, int min_chunk_z, int max_chunk_x, int max_chunk_z, bool* found)
+// Cancels a chunk's load if it can be dropped right away, returns whether it can
+// A chunk can be dropped if its DMA hasn't started, or once the chunk thread has built it, but not in between
+bool try_cancel_chunk_load(LoadingChunkEntry& entry)
 {
-    int num_chunks_z = max_chunk_z - min_chunk_z + 1;
+    return entry.built || (!entry.finished && !entry.handle.is_finished() && entry.handle.cancel());
+}
 
-    // debug_printf("%d chunks currently loading\n", loading_chunks_.size());
-    for (auto& entry : loading_chunks_)
-    {
-        int x = entry.first.first;
-        int z = entry.first.second;
-        if (between_inclusive(min_chunk_x, max_chunk_x, x) && between_inclusive(min_chunk_z, max_chunk_z, z))
-        {
-            // debug_printf("  Chunk {%d, %d} currently loading\n", x, z);
-            found[(z - min_chunk_z) + (x - min_chunk_x) * num_chunks_z] = true;
-        }
-    }
-    // debug_printf("%d chunks loaded\n", loaded_chunks_.size());
-    for (auto& entry : loaded_chunks_)
+void Grid::get_loaded_chunks_in_area(int min_chunk_x, int min_chunk_z, int max_chunk_x, int max_chunk_z, chunk_pos_set& found)
+{
+    for (int x = std::max(0, min_chunk_x); x <= max_chunk_x; x++)
     {
-        int x = entry.pos.first;
-        int z = entry.pos.second;
-        if (between_inclusive(min_chunk_x, max_chunk_x, x) && between_inclusive(min_chunk_z, max_chunk_z, z))
+        for (int z = std::max(0, min_chunk_z); z <= max_chunk_z; z++)
         {
-            // debug_printf("  Chunk {%d, %d} is loaded\n", x, z);
-            found[(z - min_chunk_z) + (x - min_chunk_x) * num_chunks_z] = true;
+            chunk_pos pos{x, z};
+            if (is_loaded_or_loading(pos))
+            {
+                // debug_printf("  Chunk {%d, %d} is loaded or loading\n", x, z);
+                found.insert(pos);
+            }
         }
     }
 }
@@ -160,24 +191,32 @@ void Grid::load_visible_chunks(Camera& camera)
     
     // debug_printf("Visible chunk bounds: [%d, %d], [%d, %d]\n", min_chunk_x, max_chunk_x, min_chunk_z, max_chunk_z);
     
-    int num_chunks_x = max_chunk_x - min_chunk_x + 1;
-    int num_chunks_z = max_chunk_z - min_chunk_z + 1;
-
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wvla" // I know what I'm doing
-    bool mem[num_chunks_x * num_chunks_z];
-#pragma GCC diagnostic pop
-    memset(mem, 0, num_chunks_x * num_chunks_z);
-    get_loaded_chunks_in_area(min_chunk_x, min_chunk_z, max_chunk_x, max_chunk_z, mem);
+    chunk_pos_set present{};
+    get_loaded_chunks_in_area(min_chunk_x, min_chunk_z, max_chunk_x, max_chunk_z, present);
 
-    for (int x = 0; x < num_chunks_x; x++)
+    for (int x = min_chunk_x; x <= max_chunk_x; x++)
     {
-        for (int z = 0; z < num_chunks_z; z++)
+        for (int z = min_chunk_z; z <= max_chunk_z; z++)
         {
-            if (!mem[x * num_chunks_z + z])
+            chunk_pos pos{x, z};
+            if (!present.contains(pos))
             {
-                debug_printf("Loading chunk %d, %d\n", x + min_chunk_x, z + min_chunk_z);
-                load_chunk({x + min_chunk_x, z + min_chunk_z});
+                debug_printf("Loading chunk %d, %d\n", x, z);
+                load_chunk(pos);
+            }
+            else
+            {
+                // If this chunk was prefetched, it's needed now so let it be moved into the loaded chunks once ready
+                // and move it ahead of the other prefetches if it hasn't started loading yet
+                LoadingChunkEntry* loading = chunk_slot(pos).loading;
+                if (loading != nullptr && loading->pos == pos && loading->prefetch)
+                {
+                    loading->prefetch = false;
+                    if (!loading->finished)
+                    {
+                        loading->handle.set_priority(LoadPriority::visible_chunk);
+                    }
+                }
             }
         }
     }
@@ -213,21 +252,276 @@ void Grid::unload_nonvisible_chunks(Camera& camera)
             ++it;
         }
     }
+
+    // Give memory back from the cache if the heap is running low
+    while (getMemoryStats().free_blocks < chunk_cache_min_free_blocks && evict_cached_chunk())
+    {}
 }
 
-void Grid::load_chunk(chunk_pos pos)
+void Grid::cache_chunk(ChunkEntry& entry)
 {
-    uint32_t chunk_offset, chunk_length;
-    definition_.get_chunk_offset_size(pos.first, pos.second, &chunk_offset, &chunk_length);
+    if (getMemoryStats().free_blocks < chunk_cache_min_free_blocks)
+    {
+        return;
+    }
+    if (cached_chunks_.full())
+    {
+        evict_cached_chunk();
+    }
+    cached_chunks_.emplace(entry.pos, std::move(entry.chunk), std::move(entry.gfx), chunk_cache_age_++);
+}
+
+bool Grid::evict_cached_chunk()
+{
+    auto oldest = std::min_element(cached_chunks_.begin(), cached_chunks_.end(), [](const CachedChunkEntry& a, const CachedChunkEntry& b)
+    {
+        return a.age < b.age;
+    });
+    if (oldest == cached_chunks_.end())
+    {
+        return false;
+    }
+    debug_printf("Evicting cached chunk {%d, %d}\n", oldest->pos.first, oldest->pos.second);
+    // relocatable_ptr and the gfx's block_vectors handle freeing the chunk's memory
+    cached_chunks_.erase(oldest);
+    chunk_cache_stats_.evictions++;
+    return true;
+}
+
+// Returns the number of frames until the camera would cover the given distance on one axis at the given velocity,
+// or infinity if it isn't moving towards it. `ahead` is whether the distance is in the positive direction.
+static float axis_arrival_frames(float gap, bool ahead, float vel)
+{
+    if (gap == 0.0f)
+    {
+        return 0.0f;
+    }
+    if ((vel > 0.0f) != ahead || vel == 0.0f)
+    {
+        return std::numeric_limits<float>::infinity();
+    }
+    return gap / std::abs(vel);
+}
 
-    // If the currently loading chunks skipfield is full, continuously process loading chunks until a slot opens up
-    while (loading_chunks_.full())
+float Grid::chunk_arrival_frames(chunk_pos pos, float target_x, float target_z)
+{
+    constexpr float chunk_world_size = chunk_size * tile_size;
+    float chunk_min_x = pos.first * chunk_world_size;
+    float chunk_max_x = chunk_min_x + chunk_world_size;
+    float chunk_min_z = pos.second * chunk_world_size;
+    float chunk_max_z = chunk_min_z + chunk_world_size;
+
+    // Get the distance between the chunk and the visible area on each axis, zero if they overlap on that axis
+    float gap_x = std::max({0.0f, chunk_min_x - (target_x + visible_inner_range_x), (target_x - visible_inner_range_x) - chunk_max_x});
+    float gap_z = std::max({0.0f, chunk_min_z - (target_z + visible_inner_range_pos_z), (target_z - visible_inner_range_neg_z) - chunk_max_z});
+
+    // The chunk becomes visible once the gaps on both axes have closed
+    return std::max(
+        axis_arrival_frames(gap_x, chunk_min_x > target_x, camera_vel_x_),
+        axis_arrival_frames(gap_z, chunk_min_z > target_z, camera_vel_z_));
+}
+
+struct PrefetchCandidate {
+    chunk_pos pos;
+    float arrival_frames;
+    float dist_sq;
+};
+
+void Grid::prefetch_chunks(Camera& camera)
+{
+    constexpr int chunk_world_size = chunk_size * tile_size;
+    float target_x = camera.target[0];
+    float target_z = camera.target[2];
+
+    // Estimate the camera's velocity from how far its target moved since the last frame, smoothed to ignore jitter
+    if (has_prev_target_)
+    {
+        float delta_x = target_x - prev_target_x_;
+        float delta_z = target_z - prev_target_z_;
+        // Moving more than a chunk in a frame is a warp rather than movement, so start the estimate over
+        if (std::abs(delta_x) > chunk_world_size || std::abs(delta_z) > chunk_world_size)
+        {
+            camera_vel_x_ = 0.0f;
+            camera_vel_z_ = 0.0f;
+        }
+        else
+        {
+            camera_vel_x_ += (delta_x - camera_vel_x_) * prefetch_velocity_smoothing;
+            camera_vel_z_ += (delta_z - camera_vel_z_) * prefetch_velocity_smoothing;
+        }
+    }
+    prev_target_x_ = target_x;
+    prev_target_z_ = target_z;
+    has_prev_target_ = true;
+
+    // Cancel any prefetched chunks the camera is no longer heading towards and count the ones that are still useful
+    // Loads that are being read or built right now can't be cancelled since the DMA or the chunk thread is writing into
+    // the chunk, so those get cancelled on a later frame
+    size_t num_prefetching = 0;
+    for (auto it = loading_chunks_.begin(); it != loading_chunks_.end();)
+    {
+        if (it->prefetch)
+        {
+            if (chunk_arrival_frames(it->pos, target_x, target_z) > prefetch_lookahead_frames && try_cancel_chunk_load(*it))
+            {
+                debug_printf("Cancelling stale prefetch of chunk {%d, %d}\n", it->pos.first, it->pos.second);
+                it = cancel_loading_chunk(it);
+                continue;
+            }
+            num_prefetching++;
+        }
+        ++it;
+    }
+
+    if (num_prefetching >= max_prefetching_chunks)
+    {
+        return;
+    }
+    if (std::abs(camera_vel_x_) < prefetch_min_speed && std::abs(camera_vel_z_) < prefetch_min_speed)
+    {
+        return;
+    }
+
+    // Extend the visible area by how far the camera will travel within the lookahead window, at most one chunk so that
+    // the prefetched and visible chunks all still fit in the chunk table without colliding
+    int ahead_x = std::clamp(static_cast<int>(lround(camera_vel_x_ * prefetch_lookahead_frames)), -chunk_world_size, chunk_world_size);
+    int ahead_z = std::clamp(static_cast<int>(lround(camera_vel_z_ * prefetch_lookahead_frames)), -chunk_world_size, chunk_world_size);
+    int pos_x = static_cast<int>(target_x);
+    int pos_z = static_cast<int>(target_z);
+
+    int min_chunk_x = round_down_divide<chunk_world_size>(pos_x + std::min(ahead_x, 0) - visible_inner_range_x);
+    min_chunk_x = std::clamp(min_chunk_x, 0, definition_.num_chunks_x - 1);
+
+    int max_chunk_x = round_down_divide<chunk_world_size>(pos_x + std::max(ahead_x, 0) + visible_inner_range_x);
+    max_chunk_x = std::clamp(max_chunk_x, 0, definition_.num_chunks_x - 1);
+
+    int min_chunk_z = round_down_divide<chunk_world_size>(pos_z + std::min(ahead_z, 0) - visible_inner_range_neg_z);
+    min_chunk_z = std::clamp(min_chunk_z, 0, definition_.num_chunks_z - 1);
+
+    int max_chunk_z = round_down_divide<chunk_world_size>(pos_z + std::max(ahead_z, 0) + visible_inner_range_pos_z);
+    max_chunk_z = std::clamp(max_chunk_z, 0, definition_.num_chunks_z - 1);
+
+    // Gather the chunks in the extended area that aren't visible yet but will be within the lookahead window
+    static_vector<PrefetchCandidate, (max_chunks_x + 1) * (max_chunks_z + 1)> candidates;
+    for (int x = min_chunk_x; x <= max_chunk_x; x++)
+    {
+        for (int z = min_chunk_z; z <= max_chunk_z; z++)
+        {
+            chunk_pos pos{x, z};
+            // Cached chunks are already in memory and go straight back into the loaded chunks once they're visible
+            if (is_loaded_or_loading(pos) || find_cached_chunk(pos) != cached_chunks_.end())
+            {
+                continue;
+            }
+            float arrival_frames = chunk_arrival_frames(pos, target_x, target_z);
+            // Chunks that are already visible are requested by load_visible_chunks
+            if (arrival_frames == 0.0f || arrival_frames > prefetch_lookahead_frames)
+            {
+                continue;
+            }
+            float dx = (x + 0.5f) * chunk_world_size - target_x;
+            float dz = (z + 0.5f) * chunk_world_size - target_z;
+            candidates.emplace_back(pos, arrival_frames, dx * dx + dz * dz);
+        }
+    }
+
+    // Request the chunks that will be needed soonest first, breaking ties by distance
+    std::sort(candidates.begin(), candidates.end(), [](const PrefetchCandidate& a, const PrefetchCandidate& b)
+    {
+        if (a.arrival_frames != b.arrival_frames)
+        {
+            return a.arrival_frames < b.arrival_frames;
+        }
+        return a.dist_sq < b.dist_sq;
+    });
+
+    for (const auto& candidate : candidates)
+    {
+        if (num_prefetching >= max_prefetching_chunks || loading_chunks_.full())
+        {
+            break;
+        }
+        debug_printf("Prefetching chunk {%d, %d}, visible in %d frames\n", candidate.pos.first, candidate.pos.second, static_cast<int>(candidate.arrival_frames));
+        load_chunk(candidate.pos, true);
+        num_prefetching++;
+    }
+}
+
+// Relocation callback for chunk allocations, fixes up the column pointers after the compactor moves a chunk
+void relocate_chunk(void *new_addr, void *old_addr)
+{
+    static_cast<Chunk*>(new_addr)->relocate(old_addr);
+}
+
+void finish_chunk_load(void *data, void *arg);
+
+void Grid::load_chunk(chunk_pos pos, bool prefetch)
+{
+    const ChunkArrayElement& chunk_element = get_chunk_array_element(pos);
+    uint32_t chunk_offset = chunk_element.offset;
+    uint32_t chunk_length = chunk_element.size;
+    uint32_t chunk_compressed_length = chunk_element.compressed_size;
+
+    ChunkTableSlot& slot = chunk_slot(pos);
+    // A prefetch in this chunk's table slot is outside of the visible area, so it can be dropped if nothing is writing into it
+    if (slot.loading != nullptr && slot.loading->prefetch && try_cancel_chunk_load(*slot.loading))
+    {
+        loading_chunks_.erase(slot.loading);
+        slot.loading = nullptr;
+    }
+    // If this chunk's table slot is still taken by a chunk that left the visible area but hasn't been unloaded yet,
+    // try again next frame once it has been
+    if (slot.loaded != nullptr || slot.loading != nullptr)
+    {
+        return;
+    }
+
+    // If the chunk was unloaded recently it may still be cached, in which case it doesn't need to be loaded again
+    auto cached = find_cached_chunk(pos);
+    if (cached != cached_chunks_.end())
+    {
+        // Prefetches leave the chunk in the cache until it's visible
+        if (!prefetch && !loaded_chunks_.full())
+        {
+            debug_printf("Restoring cached chunk {%d, %d}\n", pos.first, pos.second);
+            slot.loaded = &*loaded_chunks_.emplace(pos, std::move(cached->chunk), std::move(cached->gfx));
+            cached_chunks_.erase(cached);
+            chunk_cache_stats_.hits++;
+        }
+        return;
+    }
+
+    // If the currently loading chunks skipfield is full, try to finish some of the loads
+    // If none are done yet then try again next frame instead of stalling this one
+    if (loading_chunks_.full())
     {
         process_loading_chunks();
+        if (loading_chunks_.full())
+        {
+            return;
+        }
     }
 
-    LoadHandle handle = start_data_load(nullptr, (u32)(_assetsSegmentStart + chunk_offset), chunk_length);
-    loading_chunks_.emplace(pos, std::move(handle));
+    // Chunks are relocatable so the heap compactor can move them once loaded, pin it until the DMA is done
+    reloc_handle_t chunk_alloc = allocRelocatable(chunk_length, ALLOC_CHUNK, relocate_chunk);
+    // Cached chunks and unreferenced assets only use spare memory, so free them to make room if needed
+    while (chunk_alloc == nullptr && (evict_cached_chunk() || evict_unreferenced_asset()))
+    {
+        chunk_alloc = allocRelocatable(chunk_length, ALLOC_CHUNK, relocate_chunk);
+    }
+    relocatable_ptr<Chunk> chunk{chunk_alloc};
+    if (!chunk)
+    {
+        // Out of memory, try again next frame
+        return;
+    }
+    chunk.pin();
+    // The entry doesn't move once emplaced, so the chunk thread can fill in its gfx once the data arrives
+    LoadingChunkEntry& entry = *loading_chunks_.emplace(pos, std::move(chunk), LoadHandle{}, prefetch, false, false, tile_types_.data(), tile_lods_.data());
+    entry.handle = start_compressed_data_load(entry.chunk.get(), (u32)(_assetsSegmentStart + chunk_offset), chunk_compressed_length, chunk_length,
+        finish_chunk_load, &entry, prefetch ? LoadPriority::prefetch : LoadPriority::visible_chunk);
+    slot.loading = &entry;
+    chunk_cache_stats_.misses++;
 
 
     // Chunk *chunk = (Chunk*)load_data(nullptr, (u32)(_assetsSegmentStart + chunk_offset), chunk_length);
@@ -295,60 +589,622 @@ void copy_rotation_scale(Mtx* out, Mtx* in)
     __asm__ __volatile__(".set gp=32");
 }
 
-std::array<block_vector<Mtx>, num_frame_buffers> get_matrices(Chunk* chunk)
+// Whether a tile gets drawn
+bool tile_drawn(const Tile& tile, const TileType* tile_types)
+{
+    // Don't draw walls facing away from the camera
+    if (tile.id == empty_tile || (tile.id == 16 && tile.rotation == 2))
+    {
+        return false;
+    }
+    return tile_types[tile.id].model != nullptr;
+}
+
+// Writes a switch between two materials into a display list being baked for the given layer
+Gfx* write_material_switch(Gfx* gfx_pos, MaterialHeader* from, MaterialHeader* to, DrawLayer layer)
+{
+    if (from == to)
+    {
+        return gfx_pos;
+    }
+    gfx_pos = writeMaterialReset(gfx_pos, from, layer);
+    gSPDisplayList(gfx_pos++, to->gfx);
+    return gfx_pos;
+}
+
+// Whether every draw of a tile model is on the opaque layer, so nothing behind the tile can be seen through it
+bool tile_model_opaque(const Model* model)
+{
+    const Joint& joint = model->joints[0];
+    for (size_t cur_layer = 0; cur_layer < gfx::draw_layers; cur_layer++)
+    {
+        if (cur_layer != static_cast<size_t>(DrawLayer::opa_surf) && joint.layers[cur_layer].num_draws != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Whether a column has an opaque floor tile at the given height
+bool column_has_opaque_floor(const ChunkColumn& col, int y, const TileType* tile_types)
+{
+    int tile_idx = y - col.base_height;
+    if (tile_idx < 0 || tile_idx >= col.num_tiles)
+    {
+        return false;
+    }
+    const Tile& cover = col.tiles[tile_idx];
+    return tile_drawn(cover, tile_types) && tile_types[cover.id].flags == TileCollision::floor && tile_model_opaque(tile_types[cover.id].model);
+}
+
+// How far around a tile the floor above it has to be opaque for the tile to be hidden, in tiles
+// The camera looks down at 45 degrees with a 60 degree field of view, so the shallowest view ray is 15 degrees below
+// horizontal and has to cross the floor less than 4 tiles away from anything it reaches below the floor
+constexpr int tile_occlusion_radius = 4;
+
+// Whether a tile is hidden from the camera by the floors above it and around it
+bool tile_occluded(const Chunk* chunk, int x, int z, int y, const TileType* tile_types)
+{
+    constexpr int edge = chunk_size;
+    // Tiles near the edge of the chunk could be seen through the neighbouring chunk, which may not be loaded
+    if (x < tile_occlusion_radius || x >= edge - tile_occlusion_radius || z < tile_occlusion_radius || z >= edge - tile_occlusion_radius)
+    {
+        return false;
+    }
+    // Check the tile's own column first, since that rules out most tiles
+    if (!column_has_opaque_floor(chunk->columns[x][z], y + 1, tile_types))
+    {
+        return false;
+    }
+    for (int cover_x = x - tile_occlusion_radius; cover_x <= x + tile_occlusion_radius; cover_x++)
+    {
+        for (int cover_z = z - tile_occlusion_radius; cover_z <= z + tile_occlusion_radius; cover_z++)
+        {
+            if (!column_has_opaque_floor(chunk->columns[cover_x][cover_z], y + 1, tile_types))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Returns the number of material draws in a tile's model
+size_t count_tile_draws(const Model* model)
+{
+    size_t num_draws = 0;
+    for (const auto& mesh_layer : model->joints[0].layers)
+    {
+        for (size_t draw_idx = 0; draw_idx < mesh_layer.num_draws; draw_idx++)
+        {
+            if (mesh_layer.draws[draw_idx].num_groups != 0)
+            {
+                num_draws++;
+            }
+        }
+    }
+    return num_draws;
+}
+
+// Visibility of a chunk's columns, one row per x position with bit z set if the column at that z position is visible
+using ChunkColumnMask = std::array<uint16_t, chunk_size>;
+
+// Whether a tile draw's column is visible, every column is if there's no mask
+bool tile_draw_visible(const ChunkTileDraw& draw, const ChunkColumnMask* visible)
 {
-    std::array<block_vector<Mtx>, num_frame_buffers> ret{};
+    return visible == nullptr || ((*visible)[draw.x] >> draw.z) & 1;
+}
 
+// Returns the most commands that writing the visible tile draws can take, and how many of the draws are visible
+size_t tile_draws_gfx_length(const ChunkTileDraw* draws_begin, const ChunkTileDraw* draws_end, const ChunkColumnMask* visible, size_t* num_visible)
+{
+    // Each draw takes a matrix push, the draw's DL and a pop, each layer needs an end and each material after the
+    // first on a layer needs a switch
+    size_t num_gfx = 0;
+    const ChunkTileDraw* prev_draw = nullptr;
+    *num_visible = 0;
+    for (const ChunkTileDraw* cur_draw = draws_begin; cur_draw != draws_end; cur_draw++)
+    {
+        if (!tile_draw_visible(*cur_draw, visible))
+        {
+            continue;
+        }
+        num_gfx += 3;
+        if (prev_draw == nullptr || cur_draw->layer != prev_draw->layer)
+        {
+            num_gfx += 1;
+        }
+        else if (cur_draw->material != prev_draw->material)
+        {
+            num_gfx += material_reset_max_length + 1;
+        }
+        prev_draw = cur_draw;
+        (*num_visible)++;
+    }
+    return num_gfx;
+}
+
+// Writes the visible tile draws into a display list per layer
+// Each draw is wrapped in a push of the tile's matrix onto the chunk's origin matrix
+Gfx* write_tile_draws(Gfx* gfx_pos, const ChunkTileDraw* draws_begin, const ChunkTileDraw* draws_end, const ChunkColumnMask* visible, ChunkLayersGfx& layers)
+{
+    layers = {};
+    ChunkLayerGfx* cur_layer_gfx = nullptr;
+    for (const ChunkTileDraw* cur_draw = draws_begin; cur_draw != draws_end; cur_draw++)
+    {
+        if (!tile_draw_visible(*cur_draw, visible))
+        {
+            continue;
+        }
+        // The draws are sorted by layer, so each layer's draws are contiguous
+        ChunkLayerGfx& layer_gfx = layers[cur_draw->layer];
+        if (&layer_gfx != cur_layer_gfx)
+        {
+            if (cur_layer_gfx != nullptr)
+            {
+                gSPEndDisplayList(gfx_pos++);
+            }
+            cur_layer_gfx = &layer_gfx;
+            layer_gfx = ChunkLayerGfx{cur_draw->material, cur_draw->material, gfx_pos};
+        }
+        else
+        {
+            gfx_pos = write_material_switch(gfx_pos, layer_gfx.last_material, cur_draw->material, static_cast<DrawLayer>(cur_draw->layer));
+            layer_gfx.last_material = cur_draw->material;
+        }
+        gSPMatrix(gfx_pos++, cur_draw->mtx, G_MTX_MODELVIEW | G_MTX_MUL | G_MTX_PUSH);
+        gSPDisplayList(gfx_pos++, cur_draw->gfx);
+        gSPPopMatrix(gfx_pos++, G_MTX_MODELVIEW);
+    }
+    if (cur_layer_gfx != nullptr)
+    {
+        gSPEndDisplayList(gfx_pos++);
+    }
+    return gfx_pos;
+}
+
+// Builds the matrices, sorted tile draws and per-layer display lists for the chunk's tiles
+// Tiles hidden under opaque floors are left out entirely. The display lists only depend on the chunk's origin matrix,
+// so they can be reused every frame without modification while the chunk is entirely in view.
+void build_chunk_tiles(const Chunk* chunk, const TileType* tile_types, ChunkGfx& gfx)
+{
+    constexpr int tile = tile_size;
+    gfx.tile_layers = {};
+    gfx.num_occluded_draws = 0;
+    gfx.min_y = 0;
+    gfx.max_y = 0;
+
+    // Count the chunk's drawn tiles and their draws so that everything can be allocated up front
+    size_t num_tiles = 0;
+    size_t num_draws = 0;
+    size_t num_occluded_draws = 0;
+    int min_y = std::numeric_limits<int>::max();
+    int max_y = std::numeric_limits<int>::min();
     for (unsigned int x = 0; x < chunk_size; x++)
     {
         for (unsigned int z = 0; z < chunk_size; z++)
         {
             const ChunkColumn &col = chunk->columns[x][z];
-            unsigned int tile_idx;
-            for (tile_idx = 0; tile_idx < col.num_tiles; tile_idx++)
+            for (unsigned int tile_idx = 0; tile_idx < col.num_tiles; tile_idx++)
             {
-                const auto& tile = col.tiles[tile_idx];
-                if (tile.id != 0xFF)
+                const auto& cur_tile = col.tiles[tile_idx];
+                if (!tile_drawn(cur_tile, tile_types))
+                {
+                    continue;
+                }
+                // Occluded tiles still count towards the height range, since the chunk's LOD mesh can include them
+                int tile_y = col.base_height + static_cast<int>(tile_idx);
+                min_y = std::min(min_y, tile_y);
+                max_y = std::max(max_y, tile_y);
+                size_t tile_draws = count_tile_draws(tile_types[cur_tile.id].model);
+                if (tile_occluded(chunk, x, z, tile_y, tile_types))
                 {
-                    for (unsigned int i = 0; i < num_frame_buffers; i++)
+                    num_occluded_draws += tile_draws;
+                    continue;
+                }
+                num_tiles++;
+                num_draws += tile_draws;
+            }
+        }
+    }
+    if (min_y <= max_y)
+    {
+        gfx.min_y = static_cast<int16_t>(min_y);
+        gfx.max_y = static_cast<int16_t>(max_y);
+    }
+    gfx.num_occluded_draws = static_cast<uint16_t>(num_occluded_draws);
+    if (num_draws == 0)
+    {
+        return;
+    }
+
+    gfx.matrices.reserve(num_tiles);
+    gfx.tile_draws = dynamic_array<ChunkTileDraw>(num_draws);
+    size_t remaining = num_tiles;
+    size_t draw_count = 0;
+    // Span of matrices in the current block that haven't been written yet
+    std::span<Mtx> cur_span{};
+    auto mtx_iter = cur_span.end();
+    for (unsigned int x = 0; x < chunk_size; x++)
+    {
+        for (unsigned int z = 0; z < chunk_size; z++)
+        {
+            const ChunkColumn &col = chunk->columns[x][z];
+            for (unsigned int tile_idx = 0; tile_idx < col.num_tiles; tile_idx++)
+            {
+                const auto& cur_tile = col.tiles[tile_idx];
+                if (!tile_drawn(cur_tile, tile_types) || tile_occluded(chunk, x, z, col.base_height + static_cast<int>(tile_idx), tile_types))
+                {
+                    continue;
+                }
+                // Grab the next block's worth of matrices once the current span is used up
+                if (mtx_iter == cur_span.end())
+                {
+                    cur_span = gfx.matrices.emplace_back_n(remaining);
+                    remaining -= cur_span.size();
+                    mtx_iter = cur_span.begin();
+                }
+                Mtx* cur_mtx = &(*mtx_iter++);
+                // Copy from the template matrix based on the rotation and place the tile's center relative to the chunk's origin
+                copy_rotation_scale(cur_mtx, &fixed_tile_rotation_matrices[cur_tile.rotation]);
+                int tile_x = x * tile + tile / 2;
+                int tile_y = (col.base_height + static_cast<int>(tile_idx)) * tile;
+                int tile_z = z * tile + tile / 2;
+                cur_mtx->m[1][2] = ((uint32_t)tile_x & 0xFFFF) << 16 | ((uint32_t)tile_y & 0xFFFF);
+                cur_mtx->m[1][3] = ((uint32_t)tile_z & 0xFFFF) << 16 | (1 & 0xFFFF);
+                cur_mtx->m[3][2] = 0;
+                cur_mtx->m[3][3] = 0;
+
+                Model* tile_model = tile_types[cur_tile.id].model;
+                const Joint& joint = tile_model->joints[0];
+                for (size_t cur_layer = 0; cur_layer < gfx::draw_layers; cur_layer++)
+                {
+                    const JointMeshLayer& mesh_layer = joint.layers[cur_layer];
+                    for (size_t draw_idx = 0; draw_idx < mesh_layer.num_draws; draw_idx++)
                     {
-                        // Allocate the matrix
-                        Mtx* curMtx = &(*ret[i].emplace_back());
-                        // Copy from the template matrix based on the rotation
-                        copy_rotation_scale(curMtx, &fixed_tile_rotation_matrices[tile.rotation]);
-                        curMtx->m[3][2] = 0;
-                        curMtx->m[3][3] = 0;
+                        const auto& cur_draw = mesh_layer.draws[draw_idx];
+                        if (cur_draw.num_groups != 0)
+                        {
+                            gfx.tile_draws[draw_count] = ChunkTileDraw{tile_model->materials[cur_draw.material_index], cur_draw.gfx, cur_mtx,
+                                static_cast<uint8_t>(cur_layer), static_cast<uint8_t>(x), static_cast<uint8_t>(z)};
+                            draw_count++;
+                        }
                     }
                 }
             }
         }
     }
 
-    return ret;
+    // Group the draws by layer and then by material, so each material only gets loaded once per layer
+    // The sort is stable so that draws with the same material stay in the order of their columns
+    std::stable_sort(gfx.tile_draws.begin(), gfx.tile_draws.end(), [](const ChunkTileDraw& a, const ChunkTileDraw& b)
+    {
+        if (a.layer != b.layer)
+        {
+            return a.layer < b.layer;
+        }
+        return reinterpret_cast<uintptr_t>(a.material) < reinterpret_cast<uintptr_t>(b.material);
+    });
+
+    const ChunkTileDraw* draws_begin = gfx.tile_draws.data();
+    const ChunkTileDraw* draws_end = draws_begin + gfx.tile_draws.size();
+    size_t num_visible;
+    size_t num_gfx = tile_draws_gfx_length(draws_begin, draws_end, nullptr, &num_visible);
+
+    // Use new instead of make_unique to avoid unnecessary initialization
+    gfx.tile_gfx = std::unique_ptr<Gfx[]>(new Gfx[num_gfx]);
+    Gfx* gfx_end = write_tile_draws(gfx.tile_gfx.get(), draws_begin, draws_end, nullptr, gfx.tile_layers);
+
+    // The RSP reads the matrices and display lists straight from memory
+    for (auto block_it = gfx.matrices.blocks_begin(); block_it != gfx.matrices.blocks_end(); ++block_it)
+    {
+        osWritebackDCache(&(*block_it), mem_block_size);
+    }
+    osWritebackDCache(gfx.tile_gfx.get(), (gfx_end - gfx.tile_gfx.get()) * sizeof(Gfx));
 }
 
-void Grid::process_loading_chunks()
+// Number of LOD quads per vertex load, which fills the 32 entry vertex buffer
+constexpr size_t lod_quads_per_load = 8;
+
+// Whether a LOD quad is drawn, which skips the same tiles that Grid::draw does
+bool lod_quad_drawn(const ChunkLodQuad& quad, const TileLodMaterial* tile_lods)
 {
-    int i = 0;
-    // If there's no room for any more chunks, then don't bother checking the loading chunks
-    if (loaded_chunks_.full())
+    // Don't draw walls facing away from the camera
+    if (quad.id == 16 && quad.shape == (lod_quad_wall | 2))
+    {
+        return false;
+    }
+    return tile_lods[quad.id].material != nullptr;
+}
+
+// Returns the end of the run of quads with the same tile id as the given quad
+const ChunkLodQuad* find_lod_draw_end(const ChunkLodQuad* draw_start, const ChunkLodQuad* quads_end)
+{
+    return std::find_if(draw_start, quads_end, [id = draw_start->id](const ChunkLodQuad& quad) { return quad.id != id; });
+}
+
+void set_lod_vertex(Vtx* vtx, int x, int y, int z, int s, int t, const std::array<uint8_t, 4>& cn)
+{
+    vtx->v.ob[0] = static_cast<s16>(x);
+    vtx->v.ob[1] = static_cast<s16>(y);
+    vtx->v.ob[2] = static_cast<s16>(z);
+    vtx->v.flag = 0;
+    vtx->v.tc[0] = static_cast<s16>(s);
+    vtx->v.tc[1] = static_cast<s16>(t);
+    std::copy(cn.begin(), cn.end(), vtx->v.cn);
+}
+
+// Writes the 4 corners of a LOD quad relative to the chunk's origin
+// Floors and slopes are wound counterclockwise from above, walls are drawn from both sides
+void set_lod_quad_vertices(Vtx* verts, const ChunkLodQuad& quad, const TileLodMaterial& tile_lod)
+{
+    constexpr int tile = tile_size;
+    int x0 = quad.x * tile;
+    int x1 = (quad.x + quad.size_x) * tile;
+    int z0 = quad.z * tile;
+    int z1 = (quad.z + quad.size_z) * tile;
+    int y0 = quad.y * tile;
+    int rotation = quad.shape & 0x3;
+    uint8_t shape = quad.shape & lod_quad_shape_mask;
+    if (shape == lod_quad_wall)
+    {
+        // Walls sit on one edge of their tiles, the same one that the tile model's rotation puts the wall on
+        int y1 = y0 + quad.size_y * tile;
+        int t1 = quad.size_y * tile_lod.t_span;
+        if ((rotation & 1) == 0)
+        {
+            int z = rotation == 0 ? z1 : z0;
+            int s1 = quad.size_x * tile_lod.s_span;
+            set_lod_vertex(&verts[0], x0, y0, z,  0, t1, tile_lod.cn);
+            set_lod_vertex(&verts[1], x1, y0, z, s1, t1, tile_lod.cn);
+            set_lod_vertex(&verts[2], x1, y1, z, s1,  0, tile_lod.cn);
+            set_lod_vertex(&verts[3], x0, y1, z,  0,  0, tile_lod.cn);
+        }
+        else
+        {
+            int x = rotation == 1 ? x0 : x1;
+            int s1 = quad.size_z * tile_lod.s_span;
+            set_lod_vertex(&verts[0], x, y0, z0,  0, t1, tile_lod.cn);
+            set_lod_vertex(&verts[1], x, y0, z1, s1, t1, tile_lod.cn);
+            set_lod_vertex(&verts[2], x, y1, z1, s1,  0, tile_lod.cn);
+            set_lod_vertex(&verts[3], x, y1, z0,  0,  0, tile_lod.cn);
+        }
+        return;
+    }
+    // Slopes rise by one tile towards the side given by their rotation, matching tile_surface_height
+    bool slope = shape == lod_quad_slope;
+    auto corner_y = [&](bool high_x, bool high_z)
+    {
+        bool raised = false;
+        switch (rotation)
+        {
+            case 0: raised = !high_z; break;
+            case 1: raised = high_x;  break;
+            case 2: raised = high_z;  break;
+            case 3: raised = !high_x; break;
+        }
+        return (slope && raised) ? y0 + tile : y0;
+    };
+    int s1 = quad.size_x * tile_lod.s_span;
+    int t1 = quad.size_z * tile_lod.t_span;
+    set_lod_vertex(&verts[0], x0, corner_y(false, false), z0,  0,  0, tile_lod.cn);
+    set_lod_vertex(&verts[1], x0, corner_y(false, true),  z1,  0, t1, tile_lod.cn);
+    set_lod_vertex(&verts[2], x1, corner_y(true,  true),  z1, s1, t1, tile_lod.cn);
+    set_lod_vertex(&verts[3], x1, corner_y(true,  false), z0, s1,  0, tile_lod.cn);
+}
+
+// Builds the chunk's LOD mesh from its LOD quads, with a display list per layer that switches material for each tile id
+void build_chunk_lod(const Chunk* chunk, const TileLodMaterial* tile_lods, ChunkGfx& gfx)
+{
+    const ChunkLodQuad* quads_begin = chunk->lod_quads;
+    const ChunkLodQuad* quads_end = quads_begin + chunk->num_lod_quads;
+    gfx.lod_layers = {};
+
+    // Count the vertices and commands so that the mesh can be allocated up front
+    size_t num_verts = 0;
+    size_t num_gfx = 0;
+    for (const ChunkLodQuad* draw_start = quads_begin; draw_start != quads_end;)
+    {
+        const ChunkLodQuad* draw_end = find_lod_draw_end(draw_start, quads_end);
+        size_t draw_quads = 0;
+        for (const ChunkLodQuad* quad = draw_start; quad != draw_end; quad++)
+        {
+            if (lod_quad_drawn(*quad, tile_lods))
+            {
+                draw_quads++;
+                num_gfx += (quad->shape & lod_quad_shape_mask) == lod_quad_wall ? 2 : 1;
+            }
+        }
+        if (draw_quads != 0)
+        {
+            num_verts += draw_quads * 4;
+            // A vertex load for every batch of quads, plus either a material switch or the end of the layer's DL
+            num_gfx += round_away_divide(draw_quads, lod_quads_per_load) + material_reset_max_length + 1;
+        }
+        draw_start = draw_end;
+    }
+    if (num_verts == 0)
     {
-        // debug_printf("No room to load chunks\n");
         return;
     }
+
+    // Use new instead of make_unique to avoid unnecessary initialization
+    gfx.lod_verts = std::unique_ptr<Vtx[]>(new Vtx[num_verts]);
+    gfx.lod_gfx = std::unique_ptr<Gfx[]>(new Gfx[num_gfx]);
+    Vtx* cur_vtx = gfx.lod_verts.get();
+    Gfx* cur_gfx = gfx.lod_gfx.get();
+
+    for (size_t cur_layer = 0; cur_layer < gfx::draw_layers; cur_layer++)
+    {
+        ChunkLayerGfx& layer_gfx = gfx.lod_layers[cur_layer];
+        for (const ChunkLodQuad* draw_start = quads_begin; draw_start != quads_end;)
+        {
+            const ChunkLodQuad* draw_end = find_lod_draw_end(draw_start, quads_end);
+            const TileLodMaterial& tile_lod = tile_lods[draw_start->id];
+            if (static_cast<size_t>(tile_lod.layer) != cur_layer)
+            {
+                draw_start = draw_end;
+                continue;
+            }
+            bool draw_started = false;
+            // The vertex load command for the current batch is filled in once the batch's size is known
+            Gfx* batch_load = nullptr;
+            Vtx* batch_verts = nullptr;
+            unsigned int batch_quads = 0;
+            for (const ChunkLodQuad* quad = draw_start; quad != draw_end; quad++)
+            {
+                if (!lod_quad_drawn(*quad, tile_lods))
+                {
+                    continue;
+                }
+                if (!draw_started)
+                {
+                    draw_started = true;
+                    if (layer_gfx.gfx == nullptr)
+                    {
+                        layer_gfx = ChunkLayerGfx{tile_lod.material, tile_lod.material, cur_gfx};
+                    }
+                    else
+                    {
+                        cur_gfx = write_material_switch(cur_gfx, layer_gfx.last_material, tile_lod.material, tile_lod.layer);
+                        layer_gfx.last_material = tile_lod.material;
+                    }
+                }
+                if (batch_quads == 0)
+                {
+                    batch_load = cur_gfx++;
+                    batch_verts = cur_vtx;
+                }
+                set_lod_quad_vertices(cur_vtx, *quad, tile_lod);
+                cur_vtx += 4;
+                unsigned int base = batch_quads * 4;
+                gSP2Triangles(cur_gfx++,
+                    base + 0, base + 1, base + 2, 0x00,
+                    base + 0, base + 2, base + 3, 0x00);
+                if ((quad->shape & lod_quad_shape_mask) == lod_quad_wall)
+                {
+                    gSP2Triangles(cur_gfx++,
+                        base + 0, base + 2, base + 1, 0x00,
+                        base + 0, base + 3, base + 2, 0x00);
+                }
+                batch_quads++;
+                if (batch_quads == lod_quads_per_load)
+                {
+                    gSPVertex(batch_load, batch_verts, batch_quads * 4, 0);
+                    batch_quads = 0;
+                }
+            }
+            if (batch_quads != 0)
+            {
+                gSPVertex(batch_load, batch_verts, batch_quads * 4, 0);
+            }
+            draw_start = draw_end;
+        }
+        if (layer_gfx.gfx != nullptr)
+        {
+            gSPEndDisplayList(cur_gfx++);
+        }
+    }
+
+    // The RSP reads the mesh straight from memory
+    osWritebackDCache(gfx.lod_verts.get(), num_verts * sizeof(Vtx));
+    osWritebackDCache(gfx.lod_gfx.get(), (cur_gfx - gfx.lod_gfx.get()) * sizeof(Gfx));
+}
+
+// Loading chunk entries whose data has arrived, sent from the loader thread to the chunk thread
+// Every loading chunk is sent at most once, so the queues can't fill up
+OSMesgQueue chunk_arrived_queue;
+OSMesg chunk_arrived_mesgs[max_loading_chunks];
+// Loading chunk entries that the chunk thread has finished building, sent back to the game thread
+OSMesgQueue chunk_built_queue;
+OSMesg chunk_built_mesgs[max_loading_chunks];
+
+void initChunkThread()
+{
+    osCreateMesgQueue(&chunk_arrived_queue, chunk_arrived_mesgs, max_loading_chunks);
+    osCreateMesgQueue(&chunk_built_queue, chunk_built_mesgs, max_loading_chunks);
+}
+
+// Fixes up chunks and builds their gfx once their data has arrived
+// Runs below the game thread's priority, so the work only happens while the game thread is waiting on the frame and
+// never holds up the loader or the game thread
+void chunkThreadFunc(void *)
+{
+    while (1)
+    {
+        OSMesg arrived;
+        osRecvMesg(&chunk_arrived_queue, &arrived, OS_MESG_BLOCK);
+        LoadingChunkEntry *entry = static_cast<LoadingChunkEntry*>(arrived);
+        // The chunk stays pinned until the game thread has been told it's built, so the compactor can't move it
+        Chunk *chunk = entry->chunk.get();
+        chunk->adjust_offsets();
+        build_chunk_tiles(chunk, entry->tile_types, entry->gfx);
+        build_chunk_lod(chunk, entry->tile_lods, entry->gfx);
+        osSendMesg(&chunk_built_queue, entry, OS_MESG_BLOCK);
+    }
+}
+
+// Load callback for chunks, run on the loader thread once the chunk's data has arrived
+// Only hands the chunk to the chunk thread, so the loader can go straight on to the next DMA
+void finish_chunk_load(void *, void *arg)
+{
+    osSendMesg(&chunk_arrived_queue, arg, OS_MESG_NOBLOCK);
+}
+
+// Takes a chunk that the chunk thread has finished building, waiting for one if block is OS_MESG_BLOCK
+// Returns false if block is OS_MESG_NOBLOCK and no chunk was ready
+bool receive_built_chunk(s32 block)
+{
+    OSMesg built;
+    if (osRecvMesg(&chunk_built_queue, &built, block) != 0)
+    {
+        return false;
+    }
+    LoadingChunkEntry *entry = static_cast<LoadingChunkEntry*>(built);
+    entry->built = true;
+    // The chunk thread is done with the chunk, so the compactor is free to move it
+    entry->chunk.unpin();
+    return true;
+}
+
+void Grid::wait_for_chunk_builds()
+{
+    for (LoadingChunkEntry& entry : loading_chunks_)
+    {
+        // The loader hands the chunk to the chunk thread before it marks the load as finished
+        while (!entry.built && (entry.finished || entry.handle.is_finished()))
+        {
+            receive_built_chunk(OS_MESG_BLOCK);
+        }
+    }
+}
+
+void Grid::process_loading_chunks()
+{
+    while (receive_built_chunk(OS_MESG_NOBLOCK))
+    {}
+
+    int i = 0;
     for (auto it = loading_chunks_.begin(); it != loading_chunks_.end();)
     {
-        if (it->second.is_finished() && !loaded_chunks_.full())
+        // Release the handles of finished loads even if they can't be moved into the loaded chunks yet, so that they
+        // don't keep rx slots from the other loads
+        if (!it->finished && it->handle.is_finished())
+        {
+            it->handle.join();
+            it->handle = LoadHandle{};
+            it->finished = true;
+            debug_printf("Chunk %08X {%d, %d} finished loading\n", it->chunk.get(), it->pos.first, it->pos.second);
+        }
+        // Prefetched chunks wait here until they become visible
+        if (!it->prefetch && it->finished && it->built && !loaded_chunks_.full())
         {
-            Chunk *chunk = reinterpret_cast<Chunk*>(it->second.join());
-            debug_printf("Chunk %08X {%d, %d} finished loading\n", chunk, it->first.first, it->first.second);
-            chunk->adjust_offsets();
-            std::unique_ptr<Chunk, alloc_deleter> chunk_ptr{chunk};
-            std::array<block_vector<Mtx>, num_frame_buffers> chunk_matrices = get_matrices(chunk);
-            loaded_chunks_.emplace(it->first, std::move(chunk_ptr), ChunkGfx{std::move(chunk_matrices)});
+            ChunkTableSlot& slot = chunk_slot(it->pos);
+            slot.loaded = &*loaded_chunks_.emplace(it->pos, std::move(it->chunk), std::move(it->gfx));
+            slot.loading = nullptr;
             it = loading_chunks_.erase(it);
             i++;
-            if (loaded_chunks_.full()) break;
         }
         else
         {
@@ -361,77 +1217,228 @@ void Grid::process_loading_chunks()
     }
 }
 
-void drawTileModel(Model *toDraw, Mtx* curMtx);
+constinit Mtx fixed_identity_matrix = float_to_fixed({
+    { 1.0f, 0.0f, 0.0f, 0.0f},
+    { 0.0f, 1.0f, 0.0f, 0.0f},
+    { 0.0f, 0.0f, 1.0f, 0.0f},
+    { 0.0f, 0.0f, 0.0f, 1.0f},
+});
+
+// Draws a chunk's baked display lists with the chunk's origin at the given camera relative position
+void draw_chunk_layers(const ChunkLayersGfx& layers, int origin_x, int origin_z)
+{
+    Mtx* chunk_mtx = nullptr;
+    for (size_t cur_layer = 0; cur_layer < gfx::draw_layers; cur_layer++)
+    {
+        const ChunkLayerGfx& layer_gfx = layers[cur_layer];
+        if (layer_gfx.gfx == nullptr)
+        {
+            continue;
+        }
+        // The chunk's origin matrix is the only thing that changes per frame, and is shared by all of its layers
+        if (chunk_mtx == nullptr)
+        {
+            chunk_mtx = (Mtx*)allocGfx(sizeof(Mtx));
+            copy_rotation_scale(chunk_mtx, &fixed_identity_matrix);
+            chunk_mtx->m[1][2] = ((uint32_t)origin_x & 0xFFFF) << 16;
+            chunk_mtx->m[1][3] = ((uint32_t)origin_z & 0xFFFF) << 16 | (1 & 0xFFFF);
+            chunk_mtx->m[3][2] = 0;
+            chunk_mtx->m[3][3] = 0;
+        }
+        drawBakedGfx(static_cast<DrawLayer>(cur_layer), layer_gfx.first_material, layer_gfx.last_material, layer_gfx.gfx, chunk_mtx);
+    }
+}
+
+// Columns per side of the square groups of columns that are tested against the view together, before their columns are
+// tested individually
+constexpr unsigned int column_sector_size = 4;
+
+// Finds which of a chunk's columns are in view, returns how many aren't
+unsigned int find_visible_columns(const Frustum* frustum, const Vec3 chunk_min, const Vec3 chunk_max, ChunkColumnMask& visible)
+{
+    constexpr float tile = tile_size;
+    constexpr uint16_t sector_bits = (1 << column_sector_size) - 1;
+    unsigned int num_culled = 0;
+    visible = {};
+    for (unsigned int sector_x = 0; sector_x < chunk_size; sector_x += column_sector_size)
+    {
+        for (unsigned int sector_z = 0; sector_z < chunk_size; sector_z += column_sector_size)
+        {
+            Vec3 sector_min = {chunk_min[0] + sector_x * tile, chunk_min[1], chunk_min[2] + sector_z * tile};
+            Vec3 sector_max = {sector_min[0] + column_sector_size * tile, chunk_max[1], sector_min[2] + column_sector_size * tile};
+            FrustumTest sector_test = frustumTestAABB(frustum, sector_min, sector_max);
+            if (sector_test == FrustumTest::outside)
+            {
+                num_culled += column_sector_size * column_sector_size;
+                continue;
+            }
+            for (unsigned int x = sector_x; x < sector_x + column_sector_size; x++)
+            {
+                if (sector_test == FrustumTest::inside)
+                {
+                    visible[x] |= sector_bits << sector_z;
+                    continue;
+                }
+                for (unsigned int z = sector_z; z < sector_z + column_sector_size; z++)
+                {
+                    Vec3 column_min = {chunk_min[0] + x * tile, chunk_min[1], chunk_min[2] + z * tile};
+                    Vec3 column_max = {column_min[0] + tile, chunk_max[1], column_min[2] + tile};
+                    if (frustumTestAABB(frustum, column_min, column_max) == FrustumTest::outside)
+                    {
+                        num_culled++;
+                    }
+                    else
+                    {
+                        visible[x] |= 1 << z;
+                    }
+                }
+            }
+        }
+    }
+    return num_culled;
+}
 
 void Grid::draw(Camera *camera)
 {
+    constexpr int chunk_world_size = tile_size * chunk_size;
+    constexpr int tile = tile_size;
     int pos_x = static_cast<int>(g_Camera.target[0]) - camera->model_offset[0];
     int pos_z = static_cast<int>(g_Camera.target[2]) - camera->model_offset[2];
-    int min_draw_x = pos_x - visible_inner_range_x;
-    int max_draw_x = pos_x + visible_inner_range_x;
-    int min_draw_z = pos_z - visible_inner_range_neg_z;
-    int max_draw_z = pos_z + visible_inner_range_pos_z;
+    draw_stats_ = {};
+    // The view projection matrix is camera relative like the chunks' origins
+    Frustum frustum;
+    frustumFromViewProj(&frustum, g_gfxContexts[g_curGfxContext].viewProjMtxF);
     for (auto& entry : loaded_chunks_)
     {
         // debug_printf("Drawing chunk {%d, %d}\n", entry.pos.first, entry.pos.second);
-        int32_t chunk_world_x = entry.pos.first  * static_cast<int32_t>(tile_size * chunk_size) + tile_size / 2 - camera->model_offset[0];
-        int32_t chunk_world_z = entry.pos.second * static_cast<int32_t>(tile_size * chunk_size) + tile_size / 2 - camera->model_offset[2];
-        auto& chunk = entry.chunk;
-        int32_t cur_x = chunk_world_x;
-        auto& cur_matrices = entry.gfx.matrices[g_curGfxContext];
-        auto mtx_iter = cur_matrices.begin();
-        for (unsigned int x = 0; x < chunk_size; x++)
-        {
-            bool outside_x = cur_x > max_draw_x || cur_x < min_draw_x;
-            int32_t cur_z = chunk_world_z;
-            for (unsigned int z = 0; z < chunk_size; z++)
-            {
-                bool outside_z = cur_z > max_draw_z || cur_z < min_draw_z;
-                const ChunkColumn &col = chunk->columns[x][z];
-                unsigned int tile_idx;
-                int y;
-                for (tile_idx = 0, y = col.base_height; y < col.base_height + col.num_tiles; tile_idx++, y++)
-                {
-                    const auto& tile = col.tiles[tile_idx];
-                    if (tile.id != 0xFF)
-                    {
-                        Mtx* cur_mtx = &(*mtx_iter);
+        int chunk_origin_x = entry.pos.first  * chunk_world_size - camera->model_offset[0];
+        int chunk_origin_z = entry.pos.second * chunk_world_size - camera->model_offset[2];
+        Vec3 chunk_min = {
+            static_cast<float>(chunk_origin_x),
+            static_cast<float>(entry.gfx.min_y * tile),
+            static_cast<float>(chunk_origin_z)};
+        Vec3 chunk_max = {
+            static_cast<float>(chunk_origin_x + chunk_world_size),
+            static_cast<float>((entry.gfx.max_y + 1) * tile),
+            static_cast<float>(chunk_origin_z + chunk_world_size)};
+        FrustumTest chunk_test = frustumTestAABB(&frustum, chunk_min, chunk_max);
+        if (chunk_test == FrustumTest::outside)
+        {
+            draw_stats_.chunks_culled++;
+            continue;
+        }
+        // Draw chunks that are far enough from the camera target with their LOD mesh instead of each tile's model
+        int lod_dist_x = std::max({0, chunk_origin_x - pos_x, pos_x - (chunk_origin_x + chunk_world_size)});
+        int lod_dist_z = std::max({0, chunk_origin_z - pos_z, pos_z - (chunk_origin_z + chunk_world_size)});
+        if (lod_dist_x * lod_dist_x + lod_dist_z * lod_dist_z > chunk_lod_distance * chunk_lod_distance)
+        {
+            draw_chunk_layers(entry.gfx.lod_layers, chunk_origin_x, chunk_origin_z);
+            draw_stats_.chunks_drawn++;
+            continue;
+        }
 
-                        if (!outside_x && !outside_z)
-                        {
-                            // Don't draw walls facing away from the camera
-                            if (!(tile.id == 16 && tile.rotation == 2))
-                            {
-                                Model* tile_model = tile_types_[tile.id].model;
-                                if (tile_model != nullptr)
-                                {
-                                    // Set up the translation in the matrix
-                                    cur_mtx->m[1][2] = ((uint32_t)cur_x & 0xFFFF) << 16 | ((uint32_t)(y * tile_size) & 0xFFFF);
-                                    cur_mtx->m[1][3] = ((uint32_t)cur_z & 0xFFFF) << 16 | (1 & 0xFFFF);
+        const ChunkTileDraw* draws_begin = entry.gfx.tile_draws.data();
+        const ChunkTileDraw* draws_end = draws_begin + entry.gfx.tile_draws.size();
+        draw_stats_.tile_draws_total += entry.gfx.tile_draws.size() + entry.gfx.num_occluded_draws;
+        draw_stats_.tile_draws_occluded += entry.gfx.num_occluded_draws;
+        if (chunk_test == FrustumTest::inside)
+        {
+            draw_chunk_layers(entry.gfx.tile_layers, chunk_origin_x, chunk_origin_z);
+            draw_stats_.chunks_drawn++;
+            draw_stats_.tile_draws_issued += entry.gfx.tile_draws.size();
+            continue;
+        }
 
-                                    drawTileModel(tile_types_[tile.id].model, cur_mtx);
-                                }
-                            }
-                        }
+        // The chunk crosses the edge of the view, so only draw the tiles in the columns that are in view
+        ChunkColumnMask visible;
+        unsigned int num_culled = find_visible_columns(&frustum, chunk_min, chunk_max, visible);
+        if (num_culled == 0)
+        {
+            draw_chunk_layers(entry.gfx.tile_layers, chunk_origin_x, chunk_origin_z);
+            draw_stats_.chunks_drawn++;
+            draw_stats_.tile_draws_issued += entry.gfx.tile_draws.size();
+            continue;
+        }
+        draw_stats_.columns_culled += num_culled;
+        size_t num_visible;
+        size_t num_gfx = tile_draws_gfx_length(draws_begin, draws_end, &visible, &num_visible);
+        if (num_visible == 0)
+        {
+            draw_stats_.chunks_culled++;
+            continue;
+        }
+        ChunkLayersGfx visible_layers;
+        write_tile_draws((Gfx*)allocGfx(num_gfx * sizeof(Gfx)), draws_begin, draws_end, &visible, visible_layers);
+        draw_chunk_layers(visible_layers, chunk_origin_x, chunk_origin_z);
+        draw_stats_.chunks_partial++;
+        draw_stats_.tile_draws_issued += num_visible;
+    }
+}
 
-                        ++mtx_iter;
-                    }
-                }
-                cur_z += tile_size;
-            }
-            cur_x += tile_size;
+// Returns the height of a floor or slope tile's surface at the given position in the tile
+// Slopes are raised by the query radius so that the edge of the query is what rests on them
+int tile_surface_height(bool slope, int rotation, int tile_y, int local_x, int local_z, int radius_int)
+{
+    int tile_bottom = tile_y * static_cast<int>(tile_size);
+    if (!slope)
+    {
+        return tile_bottom;
+    }
+    int slope_y;
+    switch (rotation)
+    {
+        default:
+            slope_y = static_cast<int>(tile_size) + tile_bottom - local_z;
+            break;
+        case 1:
+            slope_y = tile_bottom + local_x;
+            break;
+        case 2:
+            slope_y = tile_bottom + local_z;
+            break;
+        case 3:
+            slope_y = static_cast<int>(tile_size) + tile_bottom - local_x;
+            break;
+    }
+    slope_y += radius_int;
+    if (slope_y > tile_bottom && slope_y < (tile_bottom + static_cast<int>(tile_size)))
+    {
+        return slope_y;
+    }
+    return tile_bottom;
+}
+
+bool Grid::find_lower_floor(const ChunkColumn& column, int below_y, int local_x, int local_z, int radius_int, float min_y, float max_y, float* floor_y, tile_id* floor_id)
+{
+    for (int tile_index = below_y - column.base_height - 1; tile_index >= 0; tile_index--)
+    {
+        tile_id cur_id = column.tiles[tile_index].id;
+        if (cur_id == empty_tile)
+        {
+            continue;
+        }
+        TileCollision tile_collision = tile_types_[cur_id].flags;
+        if (tile_collision != TileCollision::floor && tile_collision != TileCollision::slope)
+        {
+            continue;
         }
-        for (auto block_it = cur_matrices.blocks_begin(); block_it != cur_matrices.blocks_end(); ++block_it)
+        float tile_y_world = static_cast<float>(tile_surface_height(tile_collision == TileCollision::slope,
+            column.tiles[tile_index].rotation, tile_index + column.base_height, local_x, local_z, radius_int));
+        if (tile_y_world >= min_y && tile_y_world < max_y)
         {
-            osWritebackDCache(&(*block_it), mem_block_size);
+            *floor_y = tile_y_world;
+            *floor_id = cur_id;
+            return true;
         }
     }
+    return false;
 }
 
 float Grid::get_height(float x, float z, float radius, float min_y, float max_y, int16_t* floor_tile_x, int16_t* floor_tile_z, tile_id* floor_tile)
 {
     int x_int = lround(x);
     int z_int = lround(z);
+    int radius_int = lround(radius);
     int found_floor_x = 0, found_floor_z = 0;
     // Default to an unreasonably low grid height
     float found_y = std::numeric_limits<decltype(ChunkColumn::base_height)>::min() * static_cast<float>(tile_size);
@@ -468,20 +1475,22 @@ float Grid::get_height(float x, float z, float radius, float min_y, float max_y,
 
     // Convert the tile bounds to exclusive upper bounds
     max_pos_x += 1;
-    max_pos_y += 1;
     max_pos_z += 1;
 
     // debug_printf("  Looking for tiles in region [%d, %d], (%d, %d)\n", min_pos_x, min_pos_z, max_pos_x, max_pos_z);
     
-    // Iterate over every loaded chunk to see which ones exist that contain tiles in the query
-    for (const auto& chunk_entry : loaded_chunks_)
+    // Look up every chunk within the calculated chunk bounds in the chunk table to find the loaded ones
+    for (int chunk_x = std::max(0, min_chunk_x); chunk_x <= max_chunk_x; chunk_x++)
     {
-        // Get the position of this chunk
-        int chunk_x = chunk_entry.pos.first;
-        int chunk_z = chunk_entry.pos.second;
-        // Check if the current chunk is within the calculated chunk bounds
-        if (between_inclusive(min_chunk_x, max_chunk_x, chunk_x) && between_inclusive(min_chunk_z, max_chunk_z, chunk_z))
+        for (int chunk_z = std::max(0, min_chunk_z); chunk_z <= max_chunk_z; chunk_z++)
         {
+            const ChunkEntry* found_entry = find_loaded_chunk({chunk_x, chunk_z});
+            if (found_entry == nullptr)
+            {
+                // debug_printf("    Chunk %d, %d is not loaded\n", chunk_x, chunk_z);
+                continue;
+            }
+            const ChunkEntry& chunk_entry = *found_entry;
             // debug_printf("    Chunk %d, %d intersects with the region\n", chunk_x, chunk_z);
             // Get the tile bounds of this chunk
             int cur_chunk_min_x = chunk_x * chunk_size;
@@ -503,122 +1512,53 @@ float Grid::get_height(float x, float z, float radius, float min_y, float max_y,
 
             // debug_printf("    Checking local tile region [%d, %d], (%d %d)\n", cur_local_min_x, cur_local_min_z, cur_local_max_x, cur_local_max_z);
 
-            const auto& chunk_columns = chunk_entry.chunk->columns;
+            const Chunk& chunk = *chunk_entry.chunk;
 
-            // Check the columns in the current chunk to see if they contain any floors in the given bounds
+            // Check the baked topmost floor of each column in the current chunk to see if it's in the given bounds
             for (int local_tile_x = cur_local_min_x; local_tile_x < cur_local_max_x; local_tile_x++)
             {
                 for (int local_tile_z = cur_local_min_z; local_tile_z < cur_local_max_z; local_tile_z++)
                 {
-                    const auto& cur_column = chunk_columns[local_tile_x][local_tile_z];
-
-                    // Get the start and end tiles to search through in this column
-                    int min_tile_index = std::max(0, min_pos_y - cur_column.base_height);
-                    int num_tiles = std::min(cur_column.num_tiles - min_tile_index, max_pos_y + 1 - cur_column.base_height);
+                    const ChunkFloor& floor = chunk.floors[local_tile_x][local_tile_z];
+                    // Columns without floors have nothing to find, and if the topmost floor is below the query then so is every other floor
+                    if (!(floor.flags & chunk_floor_present) || floor.y < min_pos_y)
+                    {
+                        continue;
+                    }
 
                     int tile_x = (local_tile_x + cur_chunk_min_x) * static_cast<int>(tile_size);
                     int tile_z = (local_tile_z + cur_chunk_min_z) * static_cast<int>(tile_size);
                     int local_x = x_int - tile_x;
                     int local_z = z_int - tile_z;
 
-                    // debug_printf("      Checking tiles %d through %d in column [%d, %d]\n", min_tile_index, num_tiles, local_tile_x, local_tile_z);
-                    // debug_printf("      -> local (%d, %d)\n", local_x, local_z);
-
-                    for (int tile_index = min_tile_index + num_tiles - 1; tile_index >= min_tile_index; tile_index--)
+                    float tile_y_world = found_y;
+                    tile_id floor_id = floor.id;
+                    bool in_query = false;
+                    if (floor.y <= max_pos_y)
                     {
-                        int tile_id = cur_column.tiles[tile_index].id;
-                        int rotation = cur_column.tiles[tile_index].rotation;
-                        if (tile_id != -1)
-                        {
-                            TileCollision tile_collision = tile_types_[tile_id].flags;
-                            int tile_y = tile_index + cur_column.base_height;
-                            float tile_y_world;
-                            int tile_bottom = tile_y * static_cast<int>(tile_size);
-                            switch (tile_collision)
-                            {
-                                case TileCollision::floor:
-                                    tile_y_world = static_cast<float>(tile_bottom);
-                                    break;
-                                case TileCollision::slope:
-                                    {
-                                        int radius_int = lround(radius);
-                                        int slope_y;
-                                        switch (rotation)
-                                        {
-                                            default:
-                                                slope_y = static_cast<int>(tile_size) + tile_bottom - local_z;
-                                                break;
-                                            case 1:
-                                                slope_y = tile_bottom + local_x;
-                                                break;
-                                            case 2:
-                                                slope_y = tile_bottom + local_z;
-                                                break;
-                                            case 3:
-                                                slope_y = static_cast<int>(tile_size) + tile_bottom - local_x;
-                                                break;
-                                        }
-                                        slope_y += radius_int;
-                                        if (slope_y > tile_bottom && slope_y < (tile_bottom + static_cast<int>(tile_size)))
-                                        {
-                                            tile_y_world = static_cast<float>(slope_y);
-                                        }
-                                        else
-                                        {
-                                            tile_y_world = static_cast<float>(tile_bottom);
-                                        }
-                                    }
-                                    break;
-                                default:
-                                    tile_y_world = found_y;
-                                    break;
-                            }
-                            if (tile_y_world > found_y && tile_y_world >= min_y && tile_y_world < max_y)
-                            {
-                                // debug_printf("        Found new max height at %5.2f\n", tile_y_world);
-                                found_y = tile_y_world;
-                                found_floor_x = local_tile_x + cur_chunk_min_x;
-                                found_floor_z = local_tile_z + cur_chunk_min_z;
-                                found_type = tile_id;
-                                // This is the highest tile in the column that fits the query, so don't check any more in the column
-                                break;
-                            }
-                        }
+                        tile_y_world = static_cast<float>(tile_surface_height(floor.flags & chunk_floor_slope,
+                            floor.flags & 0x3, floor.y, local_x, local_z, radius_int));
+                        in_query = tile_y_world >= min_y && tile_y_world < max_y;
                     }
 
-                    
-                    // const auto& cur_column = chunk_columns[x][z];
-
-                    // // Get the start and end tiles to search through in this column
-                    // int min_tile_index = std::max(0, min_pos_y - cur_column.base_height);
-                    // int max_tile_index = std::min(static_cast<int>(cur_column.num_tiles), max_pos_y - cur_column.base_height);
-
-                    // debug_printf("      Checking tiles [%d, %d) in column [%d, %d]\n", min_tile_index, max_tile_index, x, z);
-
-                    // for (int tile_index = max_tile_index - 1; tile_index >= min_tile_index; tile_index--)
-                    // {
-                    //     int tile_id = cur_column.tiles[tile_index].id;
-                    //     if (tile_id != -1 && tile_types_[tile_id].flags == TileCollision::floor)
-                    //     {
-                    //         int y = tile_index + cur_column.base_height;
-
-                    //         if (y > found_y)
-                    //         {
-                    //             debug_printf("        Found new max height at %d\n", y);
-                    //             found_y = y;
-                    //         }
+                    // If the topmost floor is above the query, a floor lower in the column may still be in it
+                    if (!in_query && (floor.flags & chunk_floor_stacked))
+                    {
+                        in_query = find_lower_floor(chunk.columns[local_tile_x][local_tile_z], floor.y, local_x, local_z,
+                            radius_int, min_y, max_y, &tile_y_world, &floor_id);
+                    }
 
-                    //         // This is the highest tile in the column that fits the query, so don't check any more in the column
-                    //         break;
-                    //     }
-                    // }
+                    if (in_query && tile_y_world > found_y)
+                    {
+                        // debug_printf("        Found new max height at %5.2f\n", tile_y_world);
+                        found_y = tile_y_world;
+                        found_floor_x = local_tile_x + cur_chunk_min_x;
+                        found_floor_z = local_tile_z + cur_chunk_min_z;
+                        found_type = floor_id;
+                    }
                 }
             }
         }
-        else
-        {
-            // debug_printf("    Chunk %d, %d does not intersect with the region\n", chunk_x, chunk_z);
-        }
     }
 
     *floor_tile_x = found_floor_x;
@@ -686,15 +1626,18 @@ int Grid::get_wall_collisions(Vec3 hits[4], float dists[4], float x, float z, fl
 
     // debug_printf("  Looking for tiles in region [%d, %d], (%d, %d)\n", min_pos_x, min_pos_z, max_pos_x, max_pos_z);
     
-    // Iterate over every loaded chunk to see which ones exist that contain tiles in the query
-    for (const auto& chunk_entry : loaded_chunks_)
+    // Look up every chunk within the calculated chunk bounds in the chunk table to find the loaded ones
+    for (int chunk_x = std::max(0, min_chunk_x); chunk_x <= max_chunk_x; chunk_x++)
     {
-        // Get the position of this chunk
-        int chunk_x = chunk_entry.pos.first;
-        int chunk_z = chunk_entry.pos.second;
-        // Check if the current chunk is within the calculated chunk bounds
-        if (between_inclusive(min_chunk_x, max_chunk_x, chunk_x) && between_inclusive(min_chunk_z, max_chunk_z, chunk_z))
+        for (int chunk_z = std::max(0, min_chunk_z); chunk_z <= max_chunk_z; chunk_z++)
         {
+            const ChunkEntry* found_entry = find_loaded_chunk({chunk_x, chunk_z});
+            if (found_entry == nullptr)
+            {
+                // debug_printf("    Chunk %d, %d is not loaded\n", chunk_x, chunk_z);
+                continue;
+            }
+            const ChunkEntry& chunk_entry = *found_entry;
             // debug_printf("    Chunk %d, %d intersects with the region\n", chunk_x, chunk_z);
             // Get the tile bounds of this chunk
             int cur_chunk_min_x = chunk_x * chunk_size;
@@ -716,51 +1659,59 @@ int Grid::get_wall_collisions(Vec3 hits[4], float dists[4], float x, float z, fl
 
             // debug_printf("    Checking local tile region [%d, %d], (%d %d)\n", cur_local_min_x, cur_local_min_z, cur_local_max_x, cur_local_max_z);
 
-            const auto& chunk_columns = chunk_entry.chunk->columns;
+            const Chunk& chunk = *chunk_entry.chunk;
+
+            // Get the wall layers of this chunk that are in the query's tile height bounds
+            int min_layer = std::max(0, min_pos_y - chunk.wall_base_height);
+            int max_layer = std::min(static_cast<int>(chunk.num_wall_layers), max_pos_y - chunk.wall_base_height);
+            if (min_layer >= max_layer)
+            {
+                continue;
+            }
+
+            // Bits of each wall layer row that are within the query's z bounds
+            uint16_t z_mask = ((1u << cur_local_max_z) - 1) & ~((1u << cur_local_min_z) - 1);
 
-            // Check the columns in the current chunk to see if they contain any floors in the given bounds
             for (int local_tile_x = cur_local_min_x; local_tile_x < cur_local_max_x; local_tile_x++)
             {
-                for (int local_tile_z = cur_local_min_z; local_tile_z < cur_local_max_z; local_tile_z++)
+                // Find every column in this row of the query that has a wall in any of the layers
+                uint32_t wall_columns = 0;
+                for (int layer = min_layer; layer < max_layer; layer++)
                 {
-                    const auto& cur_column = chunk_columns[local_tile_x][local_tile_z];
+                    wall_columns |= chunk.wall_layers[layer][local_tile_x];
+                }
+                wall_columns &= z_mask;
 
-                    // Get the start and end tiles to search through in this column
-                    int min_tile_index = std::max(0, min_pos_y - cur_column.base_height);
-                    int num_tiles = std::min(cur_column.num_tiles - min_tile_index, max_pos_y + 1 - cur_column.base_height);
+                int tile_x = (local_tile_x + cur_chunk_min_x) * static_cast<int>(tile_size);
 
-                    int tile_x = (local_tile_x + cur_chunk_min_x) * static_cast<int>(tile_size);
-                    int tile_z = (local_tile_z + cur_chunk_min_z) * static_cast<int>(tile_size);
+                while (wall_columns != 0)
+                {
+                    int local_tile_z = std::countr_zero(wall_columns);
+                    wall_columns &= wall_columns - 1;
 
-                    // debug_printf("      Checking tiles %d through %d in column [%d, %d]\n", min_tile_index, num_tiles, local_tile_x, local_tile_z);
-                    // debug_printf("      -> local (%d, %d)\n", local_x, local_z);
+                    int tile_z = (local_tile_z + cur_chunk_min_z) * static_cast<int>(tile_size);
 
-                    for (int tile_index = min_tile_index + num_tiles - 1; tile_index >= min_tile_index; tile_index--)
+                    for (int layer = max_layer - 1; layer >= min_layer; layer--)
                     {
-                        int tile_id = cur_column.tiles[tile_index].id;
-                        if (tile_id != -1)
+                        if (!(chunk.wall_layers[layer][local_tile_x] & (1u << local_tile_z)))
+                        {
+                            continue;
+                        }
+                        int tile_y = layer + chunk.wall_base_height;
+                        float tile_y_world = tile_y * static_cast<int>(tile_size);
+                        if (tile_y_world >= min_y && tile_y_world < max_y)
                         {
-                            TileCollision tile_collision = tile_types_[tile_id].flags;
-                            if (tile_collision == TileCollision::wall)
+                            if (circle_aabb_intersect(
+                                x, z,
+                                tile_x, tile_x + static_cast<int>(tile_size),
+                                tile_z, tile_z + static_cast<int>(tile_size),
+                                rad_sq, &dists[num_hits], hits[num_hits]))
                             {
-                                int tile_y = tile_index + cur_column.base_height;
-                                float tile_y_world = tile_y * static_cast<int>(tile_size);
-                                if (tile_y_world >= min_y && tile_y_world < max_y)
+                                hits[num_hits][1] = tile_y_world;
+                                num_hits++;
+                                if (num_hits >= 4)
                                 {
-
-                                    if (circle_aabb_intersect(
-                                        x, z,
-                                        tile_x, tile_x + static_cast<int>(tile_size),
-                                        tile_z, tile_z + static_cast<int>(tile_size),
-                                        rad_sq, &dists[num_hits], hits[num_hits]))
-                                    {
-                                        num_hits++;
-                                        hits[num_hits][1] = tile_y_world;
-                                        if (num_hits >= 4)
-                                        {
-                                            return num_hits;
-                                        }
-                                    }
+                                    return num_hits;
                                 }
                             }
                         }
@@ -768,10 +1719,6 @@ int Grid::get_wall_collisions(Vec3 hits[4], float dists[4], float x, float z, fl
                 }
             }
         }
-        else
-        {
-            // debug_printf("    Chunk %d, %d does not intersect with the region\n", chunk_x, chunk_z);
-        }
     }
 
     return num_hits;
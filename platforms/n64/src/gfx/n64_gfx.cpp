@@ -19,6 +19,8 @@
 #include <interaction.h>
 #include <text.h>
 #include <player.h>
+#include <files.h>
+#include <asset_ids.h>
 
 extern "C" {
 #include <debug.h>
@@ -193,27 +195,35 @@ void addMtxToDrawLayer(DrawLayer drawLayer, Mtx* mtx)
 
 constexpr s32 default_geometry_mode = G_ZBUFFER | G_SHADE | G_SHADING_SMOOTH | G_CULL_BACK | G_LIGHTING;
 
-void resetMaterial(MaterialHeader* material, DrawLayer drawLayer)
+Gfx* writeMaterialReset(Gfx* gfx_pos, MaterialHeader* material, DrawLayer drawLayer)
 {
-    gDPPipeSync(drawLayerHeads[static_cast<int>(drawLayer)]++);
-    removeDrawLayerSlot(drawLayer);
+    gDPPipeSync(gfx_pos++);
     if ((material->flags & MaterialFlags::set_rendermode) != MaterialFlags::none)
     {
-        addGfxToDrawLayer(drawLayer, drawLayerRenderModes1Cycle[static_cast<int>(drawLayer)].data());
+        gSPDisplayList(gfx_pos++, drawLayerRenderModes1Cycle[static_cast<int>(drawLayer)].data());
     }
     if ((material->flags & MaterialFlags::set_geometry_mode) != MaterialFlags::none)
     {
-        gSPLoadGeometryMode(drawLayerHeads[static_cast<int>(drawLayer)]++, default_geometry_mode);
-        removeDrawLayerSlot(drawLayer);
+        gSPLoadGeometryMode(gfx_pos++, default_geometry_mode);
     }
     if ((material->flags & MaterialFlags::two_cycle) != MaterialFlags::none)
     {
-        gDPSetCycleType(drawLayerHeads[static_cast<int>(drawLayer)]++, G_CYC_1CYCLE);
-        removeDrawLayerSlot(drawLayer);
+        gDPSetCycleType(gfx_pos++, G_CYC_1CYCLE);
     }
     if ((material->flags & MaterialFlags::point_filter) != MaterialFlags::none)
     {
-        gDPSetTextureFilter(drawLayerHeads[static_cast<int>(drawLayer)]++, G_TF_BILERP);
+        gDPSetTextureFilter(gfx_pos++, G_TF_BILERP);
+    }
+    return gfx_pos;
+}
+
+void resetMaterial(MaterialHeader* material, DrawLayer drawLayer)
+{
+    std::array<Gfx, material_reset_max_length> reset_gfx;
+    Gfx* reset_end = writeMaterialReset(reset_gfx.data(), material, drawLayer);
+    for (Gfx* cur_gfx = reset_gfx.data(); cur_gfx != reset_end; cur_gfx++)
+    {
+        *drawLayerHeads[static_cast<int>(drawLayer)]++ = *cur_gfx;
         removeDrawLayerSlot(drawLayer);
     }
 }
@@ -402,6 +412,25 @@ void drawTileModel(Model *toDraw, Mtx* curMtx)
     }
 }
 
+// Draws a display list that does its own material switches, only loading the first material if it isn't already the
+// layer's current one
+// Does not inherit from or affect the matrix stack
+void drawBakedGfx(DrawLayer layer, MaterialHeader *firstMaterial, MaterialHeader *lastMaterial, Gfx *toDraw, Mtx* curMtx)
+{
+    size_t cur_layer = static_cast<size_t>(layer);
+    addMtxToDrawLayer(layer, curMtx);
+    if (firstMaterial != cur_layer_materials[cur_layer])
+    {
+        if (cur_layer_materials[cur_layer] != nullptr)
+        {
+            resetMaterial(cur_layer_materials[cur_layer], layer);
+        }
+        addGfxToDrawLayer(layer, firstMaterial->gfx);
+    }
+    addGfxToDrawLayer(layer, toDraw);
+    cur_layer_materials[cur_layer] = lastMaterial;
+}
+
 // Draws a model (TODO add posing)
 void drawModel(Model *toDraw, Animation *anim, u32 frame)
 {
@@ -1211,8 +1240,8 @@ void drawAllHitboxes(void)
 {
     if (cylinder_hitbox_model == nullptr)
     {
-        cylinder_hitbox_model = load_model("models/HitboxCylinder");
-        rectangle_hitbox_model = load_model("models/HitboxCube");
+        cylinder_hitbox_model = load_model(assets::models::HitboxCylinder);
+        rectangle_hitbox_model = load_model(assets::models::HitboxCube);
     }
     iterateOverEntities(draw_cylinder_hitboxes_callback, nullptr, ARCHETYPE_CYLINDER_HITBOX, Bit_Rotation);
     iterateOverEntities(draw_rectangle_hitboxes_callback, nullptr, ARCHETYPE_RECTANGLE_HITBOX, 0);
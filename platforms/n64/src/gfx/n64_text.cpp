@@ -93,6 +93,6 @@ void draw_all_text()
             x += 6;
         }
     }
-    text_entries = {};
-    text_storage = {};
+    text_entries.clear_retain();
+    text_storage.clear_retain();
 }
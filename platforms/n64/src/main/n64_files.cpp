@@ -1,13 +1,18 @@
 
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <optional>
 
 #include <ultra64.h>
 
+#include <compression.h>
 #include <files.h>
 #include <mem.h>
 #include <n64_mem.h>
 #include <n64_model.h>
 #include <skipfield.h>
+#include <static_vector.h>
 
 extern "C" {
 #include <PR/os_cache.h>
@@ -17,6 +22,14 @@ extern "C" {
 #define debug_printf(...)
 
 constexpr size_t num_load_slots = 16;
+// Size of each of the buffers that compressed data is DMA'd into before being decompressed
+constexpr size_t compressed_stream_buffer_size = 1024;
+// Most data read for one load before the loader goes back to see if a higher priority load is waiting
+// Each DMA holds the PI for as long as it runs, so this also bounds how long audio DMAs can be kept waiting
+constexpr size_t load_slice_size = 8 * 1024;
+// Compressed slices have to end on a piece boundary so that the next slice starts at an even rom address, and plain
+// slices have to stay a multiple of the cache line size so that the next slice's destination stays aligned
+static_assert(load_slice_size % compressed_stream_buffer_size == 0 && load_slice_size % 16 == 0);
 
 constexpr FORCEINLINE void free_rx_slot(LoadRxSlot *slot);
 
@@ -26,18 +39,32 @@ struct LoadRxSlot
 {
     OSMesgQueue queue;
     OSMesg mesg_buf;
-    uint32_t rom_pos;
-    uint32_t data_size;
-    void *dest;
+    // The rom ranges to read and where to put them, compressed loads have one segment holding the decompressed size
+    std::array<LoadSegment, max_load_segments> segments;
+    uint8_t num_segments;
+    // Size of the data in rom if it's compressed, zero if it isn't
+    uint32_t compressed_size;
     uint32_t id;
+    load_callback_t callback;
+    void *callback_arg;
+    // Can be changed by the game thread until the load is finished
+    LoadPriority priority;
+    // Set by the loader thread while a slice of the load is being read, during which the load can't be cancelled
+    bool in_flight;
     // Non-default constructor purposefully leaves queue and mesg_buf alone
     // They will have been initialized by a first pass during startup
-    LoadRxSlot(uint32_t rom_pos, uint32_t data_size, void *dest, uint32_t id) :
-        rom_pos(rom_pos),
-        data_size(data_size),
-        dest(dest),
-        id(id)
+    LoadRxSlot(const LoadSegment *segments, size_t num_segments, uint32_t compressed_size, uint32_t id, load_callback_t callback, void *callback_arg,
+            LoadPriority priority) :
+        segments{},
+        num_segments(static_cast<uint8_t>(num_segments)),
+        compressed_size(compressed_size),
+        id(id),
+        callback(callback),
+        callback_arg(callback_arg),
+        priority(priority),
+        in_flight(false)
     {
+        std::copy_n(segments, num_segments, this->segments.begin());
         // TODO figure out why this is needed, since the queues are all created in the load thread startup
         osCreateMesgQueue(&queue, &mesg_buf, 1);
     }
@@ -82,30 +109,30 @@ extern uint8_t _assetsSegmentStart[];
 
 uint32_t load_id_counter = 1;
 
-LoadHandle start_data_load(void *ret, uint32_t rom_pos, uint32_t size)
+LoadHandle start_load(const LoadSegment *segments, size_t num_segments, uint32_t compressed_size, load_callback_t callback, void *callback_arg,
+    LoadPriority priority)
 {
     // Get a new load transaction id
     uint32_t new_id = load_id_counter++;
     // Wait for a free rx slot
     // debug_printf("Getting a free rx slot\n");
     while (load_rx_slots.full()) { osYieldThread(); }
-    // Allocate memory for the destination if none was provided
-    if (ret == nullptr)
-    {
-        ret = allocRegion(size, ALLOC_FILE);
-    }
     // Get an rx slot and set its parameters
-    auto rx_iter = load_rx_slots.emplace(rom_pos, size, ret, new_id);
+    auto rx_iter = load_rx_slots.emplace(segments, num_segments, compressed_size, new_id, callback, callback_arg, priority);
     LoadRxSlot* rx_slot = &(*rx_iter);
     
     // debug_printf("Getting a free tx slot\n");
     // Wait for a free tx slot
     while (load_tx_slots.full()) { osYieldThread(); }
     // Get a tx slot and point it at the current rx slot
+    // The loader thread frees tx slots and runs at a higher priority, so it could otherwise wake up from a DMA interrupt
+    // partway through the skipfield's free list update, masking interrupts keeps it from running until that's done
+    OSIntMask prev_mask = osSetIntMask(OS_IM_NONE);
     auto tx_iter = load_tx_slots.emplace(rx_slot, new_id);
+    osSetIntMask(prev_mask);
     LoadTxSlot* tx_slot = &(*tx_iter);
 
-    // debug_printf("Starting data load of 0x%08X bytes at 0x%08X\n", size, rom_pos);
+    // debug_printf("Starting data load of 0x%08X bytes at 0x%08X\n", segments[0].size, segments[0].rom_pos);
     // Send the tx slot to the loading thread
     // Block in case the message queue is full, as this message needs to go through
     osSendMesg(&loading_queue, tx_slot, OS_MESG_BLOCK);
@@ -113,11 +140,55 @@ LoadHandle start_data_load(void *ret, uint32_t rom_pos, uint32_t size)
     return LoadHandle{rx_slot};
 }
 
-LoadHandle start_file_load(const char *path)
+LoadHandle start_data_load(void *ret, uint32_t rom_pos, uint32_t size, load_callback_t callback, void *callback_arg, LoadPriority priority)
+{
+    // Allocate memory for the destination if none was provided
+    if (ret == nullptr)
+    {
+        ret = allocRegion(size, ALLOC_FILE);
+    }
+    LoadSegment segment{rom_pos, ret, size};
+    return start_load(&segment, 1, 0, callback, callback_arg, priority);
+}
+
+LoadHandle start_compressed_data_load(void *ret, uint32_t rom_pos, uint32_t compressed_size, uint32_t size, load_callback_t callback, void *callback_arg,
+    LoadPriority priority)
+{
+    // Allocate memory for the destination if none was provided
+    if (ret == nullptr)
+    {
+        ret = allocRegion(size, ALLOC_FILE);
+    }
+    LoadSegment segment{rom_pos, ret, size};
+    return start_load(&segment, 1, compressed_size, callback, callback_arg, priority);
+}
+
+LoadHandle start_scatter_load(const LoadSegment *segments, size_t num_segments, load_callback_t callback, void *callback_arg, LoadPriority priority)
+{
+    return start_load(segments, num_segments, 0, callback, callback_arg, priority);
+}
+
+AssetRecord get_asset_record(const char *path)
 {
     const struct filerecord *file_record = FileRecords::get_offset(path, strlen(path));
-    uint32_t rom_pos = (uint32_t)(_assetsSegmentStart + file_record->offset);
-    return start_data_load(nullptr, rom_pos, OS_DCACHE_ROUNDUP_SIZE(file_record->size));
+    return AssetRecord{file_record->offset, file_record->size};
+}
+
+LoadHandle start_file_load(const AssetRecord& asset)
+{
+    uint32_t rom_pos = (uint32_t)(_assetsSegmentStart + asset.offset);
+    return start_data_load(nullptr, rom_pos, OS_DCACHE_ROUNDUP_SIZE(asset.size));
+}
+
+LoadHandle start_file_load(const char *path)
+{
+    return start_file_load(get_asset_record(path));
+}
+
+void *load_file(const AssetRecord& asset)
+{
+    LoadHandle handle = start_file_load(asset);
+    return handle.join();
 }
 
 void *load_file(const char *path)
@@ -158,22 +229,34 @@ void *load_data(void *ret, uint32_t rom_pos, uint32_t size)
     return handle.join();
 }
 
-Model *load_model(const char *path)
+Model *load_model(const AssetRecord& asset)
 {
-    Model *ret = load_file<Model>(path);
-#ifndef NDEBUG
-//????
-    auto start = osGetCount();
-    while (osGetCount() - start < OS_USEC_TO_CYCLES(1000))
-    {
-        ;
-    }
-#endif
-    ret->adjust_offsets();
-    ret->setup_gfx();
+    Model *ret = load_file<Model>(asset);
+    setup_loaded_model(ret);
     return ret;
 }
 
+Model *load_model(const char *path)
+{
+    return load_model(get_asset_record(path));
+}
+
+void setup_loaded_model(Model *model)
+{
+    adjust_loaded_model(model);
+    setup_model_gfx(model);
+}
+
+void adjust_loaded_model(Model *model)
+{
+    model->adjust_offsets();
+}
+
+void setup_model_gfx(Model *model)
+{
+    model->setup_gfx();
+}
+
 // Deleter for LoadHandle's LoadRxSlot unique_ptr
 // Invalidates the slot by setting the id to zero and frees the slot
 void LoadRxSlotDeleter::operator()(void *ptr)
@@ -188,7 +271,7 @@ void *LoadHandle::join()
     // Wait for the message from the loading thread
     osRecvMesg(&handle_slot_->queue, nullptr, OS_MESG_BLOCK);
     // Return the rx handle's destination pointer
-    return handle_slot_->dest;
+    return handle_slot_->segments[0].dest;
 }
 
 bool LoadHandle::is_finished()
@@ -196,6 +279,209 @@ bool LoadHandle::is_finished()
     return !MQ_IS_EMPTY(&handle_slot_->queue);
 }
 
+void LoadHandle::set_priority(LoadPriority priority)
+{
+    handle_slot_->priority = priority;
+}
+
+bool LoadHandle::cancel()
+{
+    // The loader thread runs at a higher priority and only wakes up from an interrupt or a message from this thread, so
+    // masking interrupts keeps it from starting a DMA between checking and cancelling
+    OSIntMask prev_mask = osSetIntMask(OS_IM_NONE);
+    bool cancelled = !handle_slot_->in_flight;
+    if (cancelled)
+    {
+        handle_slot_->id = 0;
+    }
+    osSetIntMask(prev_mask);
+    if (cancelled)
+    {
+        handle_slot_.reset();
+    }
+    return cancelled;
+}
+
+// A load request that the loader thread has received but hasn't finished yet
+struct PendingLoad
+{
+    LoadRxSlot *rx_slot;
+    uint32_t id;
+    // How far into the load the previous slices got, the offset is into the current segment or into the compressed data
+    uint8_t segment;
+    uint32_t offset;
+    // Decompression state of a compressed load, kept between slices
+    std::optional<LzDecoder> decoder;
+};
+
+// Reads data from rom and waits for the DMA to finish
+void dma_read(OSIoMesg& io_msg, void *dest, uint32_t rom_pos, uint32_t size)
+{
+    // Set up the DMA parameters
+    io_msg.dramAddr = dest;
+    io_msg.devAddr = rom_pos;
+    io_msg.size = size;
+
+    // debug_printf("Received request to load 0x%08X bytes of data from rom address 0x%08X\n", size, rom_pos);
+
+    // Invalidate the data cache for the region being DMA'd to
+    osInvalDCache(io_msg.dramAddr, io_msg.size); 
+    // Start the DMA
+    osEPiStartDma(g_romHandle, &io_msg, OS_READ);
+
+    // Load time simulation
+    // {
+    //     OSMesgQueue sleep_queue;
+    //     OSMesg sleep_mesg;
+    //     osCreateMesgQueue(&sleep_queue, &sleep_mesg, 1);
+    //     OSTimer timer;
+    //     osSetTimer(&timer, 0, OS_USEC_TO_CYCLES(10000), &sleep_queue, nullptr);
+    //     osRecvMesg(&sleep_queue, nullptr, OS_MESG_BLOCK);
+    //     osStopTimer(&timer);
+    // }
+
+    osRecvMesg(&dma_queue, nullptr, OS_MESG_BLOCK);
+}
+
+// Reads the next slice of an uncompressed load, which never crosses a segment boundary
+// Returns whether the whole load has been read
+bool read_load_slice(OSIoMesg& io_msg, PendingLoad& load)
+{
+    const LoadSegment& segment = load.rx_slot->segments[load.segment];
+    uint32_t slice_size = std::min<uint32_t>(segment.size - load.offset, load_slice_size);
+    dma_read(io_msg, static_cast<uint8_t*>(segment.dest) + load.offset, segment.rom_pos + load.offset, slice_size);
+    load.offset += slice_size;
+    if (load.offset == segment.size)
+    {
+        load.segment++;
+        load.offset = 0;
+    }
+    return load.segment == load.rx_slot->num_segments;
+}
+
+// Staging buffers for compressed loads, one gets decompressed while the other is being DMA'd into
+alignas(16) uint8_t compressed_stream_buffers[2][compressed_stream_buffer_size];
+
+// Streams the next slice of a compressed load's data through the staging buffers, decompressing each piece into the
+// destination while the next piece is DMA'd
+// Returns whether the whole load has been decompressed
+bool stream_compressed_load(OSIoMesg& io_msg, PendingLoad& load)
+{
+    LoadRxSlot *rx_slot = load.rx_slot;
+    const LoadSegment& segment = rx_slot->segments[0];
+    if (!load.decoder)
+    {
+        load.decoder.emplace(segment.dest, segment.size);
+    }
+    uint32_t rom_pos = segment.rom_pos + load.offset;
+    uint32_t remaining = std::min<uint32_t>(rx_slot->compressed_size - load.offset, load_slice_size);
+    load.offset += remaining;
+    int cur_buffer = 0;
+
+    // Starts the DMA of the next piece into the given buffer and returns the piece's size
+    auto start_piece = [&](int buffer)
+    {
+        uint32_t piece_size = std::min<uint32_t>(remaining, compressed_stream_buffer_size);
+        io_msg.dramAddr = compressed_stream_buffers[buffer];
+        io_msg.devAddr = rom_pos;
+        // PI DMAs have to be an even length, the extra byte is never fed to the decoder
+        io_msg.size = (piece_size + 1) & ~1;
+        osInvalDCache(io_msg.dramAddr, io_msg.size);
+        osEPiStartDma(g_romHandle, &io_msg, OS_READ);
+        rom_pos += piece_size;
+        remaining -= piece_size;
+        return piece_size;
+    };
+
+    uint32_t cur_piece_size = start_piece(cur_buffer);
+    while (cur_piece_size != 0)
+    {
+        osRecvMesg(&dma_queue, nullptr, OS_MESG_BLOCK);
+        uint32_t next_piece_size = 0;
+        if (remaining != 0)
+        {
+            next_piece_size = start_piece(cur_buffer ^ 1);
+        }
+        load.decoder->feed(compressed_stream_buffers[cur_buffer], cur_piece_size);
+        cur_buffer ^= 1;
+        cur_piece_size = next_piece_size;
+    }
+
+    if (load.offset != rx_slot->compressed_size)
+    {
+        return false;
+    }
+    // Write the decompressed data back to memory so that it's in the same state as data from an uncompressed load
+    osWritebackDCache(segment.dest, segment.size);
+    return true;
+}
+
+constinit LoadQueueStats load_queue_stats{};
+
+const LoadQueueStats& get_load_queue_stats()
+{
+    return load_queue_stats;
+}
+
+// Whether a load's handle was destroyed or cancelled, which invalidates the id in its rx slot
+bool load_cancelled(const PendingLoad& load)
+{
+    return load.id != load.rx_slot->id;
+}
+
+// Whether a load should be served before another one
+// Within a class the oldest load goes first, so a load that's been partially read continues before newer ones start
+bool load_precedes(const PendingLoad& a, const PendingLoad& b)
+{
+    if (a.rx_slot->priority != b.rx_slot->priority)
+    {
+        return a.rx_slot->priority < b.rx_slot->priority;
+    }
+    return a.id < b.id;
+}
+
+// Whether a load can be merged with others, which is only the case for small single segment loads that haven't started
+// Compressed loads go through the staging buffers, so they're never merged
+bool load_mergeable(const PendingLoad& load)
+{
+    const LoadRxSlot *rx_slot = load.rx_slot;
+    return rx_slot->compressed_size == 0 && rx_slot->num_segments == 1 && load.offset == 0 && rx_slot->segments[0].size <= load_slice_size;
+}
+
+using PendingLoads = static_vector<PendingLoad, num_load_slots>;
+
+// Moves the pending loads that continue where the given batch of loads ends in both rom and ram into the batch, so the
+// whole batch can be read with one DMA of at most a slice
+void merge_adjacent_loads(PendingLoads& pending, PendingLoads& batch)
+{
+    if (!load_mergeable(batch[0]))
+    {
+        return;
+    }
+    uint32_t batch_size = batch[0].rx_slot->segments[0].size;
+    bool merged = true;
+    while (merged && !batch.full())
+    {
+        merged = false;
+        const LoadSegment& last = batch.back().rx_slot->segments[0];
+        uint32_t rom_end = last.rom_pos + last.size;
+        uint8_t *dest_end = static_cast<uint8_t*>(last.dest) + last.size;
+        for (auto it = pending.begin(); it != pending.end(); ++it)
+        {
+            const LoadSegment& cur = it->rx_slot->segments[0];
+            if (load_mergeable(*it) && cur.rom_pos == rom_end && cur.dest == dest_end && batch_size + cur.size <= load_slice_size)
+            {
+                batch_size += cur.size;
+                batch.push_back(*it);
+                pending.erase_unordered(it);
+                load_queue_stats.merged++;
+                merged = true;
+                break;
+            }
+        }
+    }
+}
+
 void loadThreadFunc(UNUSED void *arg)
 {
     // Set up the message queues in the rx slots
@@ -216,48 +502,123 @@ void loadThreadFunc(UNUSED void *arg)
     io_msg.hdr.pri = OS_MESG_PRI_NORMAL;
     io_msg.hdr.retQueue = &dma_queue;
 
+    // Requests that have been received but not finished, every live rx slot has at most one so this can't overflow
+    // once cancelled requests are dropped
+    PendingLoads pending;
+    // Requests being served by the current slice
+    PendingLoads batch;
+
+    // Takes a request from the tx slot and frees the tx slot
+    auto receive_load = [&](LoadTxSlot *tx_slot)
+    {
+        PendingLoad load{tx_slot->rx_slot, tx_slot->id, 0, 0, std::nullopt};
+        // The game thread can't interrupt this since it runs at a lower priority, and it masks interrupts while it takes
+        // a tx slot so this thread never sees the skipfield mid-update
+        load_tx_slots.erase(tx_slot);
+        if (load_cancelled(load))
+        {
+            load_queue_stats.cancelled++;
+            return;
+        }
+        pending.push_back(load);
+    };
+
     while (1)
     {
-        // Wait for incoming load requests
-        LoadTxSlot *cur_tx_slot;
-        osRecvMesg(&loading_queue, (OSMesg*)&cur_tx_slot, OS_MESG_BLOCK);
+        // Drop requests whose handles were destroyed or cancelled while they weren't being read
+        for (auto it = pending.begin(); it != pending.end();)
+        {
+            if (load_cancelled(*it))
+            {
+                load_queue_stats.cancelled++;
+                it = pending.erase_unordered(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
 
-        uint32_t cur_id = cur_tx_slot->id;
-        LoadRxSlot *cur_rx_slot = cur_tx_slot->rx_slot;
+        // Wait for incoming load requests if there's nothing left to do, then take every request that's come in since
+        // the last slice so they can all be considered for the next one
+        LoadTxSlot *cur_tx_slot;
+        if (pending.empty())
+        {
+            osRecvMesg(&loading_queue, (OSMesg*)&cur_tx_slot, OS_MESG_BLOCK);
+            receive_load(cur_tx_slot);
+        }
+        while (osRecvMesg(&loading_queue, (OSMesg*)&cur_tx_slot, OS_MESG_NOBLOCK) == 0)
+        {
+            receive_load(cur_tx_slot);
+        }
 
-        // Free the tx slot
-        load_tx_slots.erase(cur_tx_slot);
-        
-        // Set up the DMA parameters
-        io_msg.dramAddr = cur_rx_slot->dest;
-        io_msg.devAddr = cur_rx_slot->rom_pos;
-        io_msg.size = cur_rx_slot->data_size;
+        std::fill(std::begin(load_queue_stats.queued), std::end(load_queue_stats.queued), 0);
+        for (const auto& load : pending)
+        {
+            load_queue_stats.queued[static_cast<size_t>(load.rx_slot->priority)]++;
+        }
+        load_queue_stats.max_queued = std::max<uint16_t>(load_queue_stats.max_queued, pending.size());
+        if (pending.empty())
+        {
+            continue;
+        }
 
-        // debug_printf("Received request to load 0x%08X bytes of data from rom address 0x%08X\n", cur_rx_slot->data_size, cur_rx_slot->rom_pos);
+        // Serve a slice of the highest priority request, or the request along with any small requests that directly
+        // follow it
+        auto next = std::min_element(pending.begin(), pending.end(), load_precedes);
+        batch.clear();
+        batch.push_back(*next);
+        pending.erase_unordered(next);
+        merge_adjacent_loads(pending, batch);
+        // The game thread can't run until this thread blocks on the DMA, so nothing can be cancelled in between
+        for (auto& load : batch)
+        {
+            load.rx_slot->in_flight = true;
+        }
 
-        // Invalidate the data cache for the region being DMA'd to
-        osInvalDCache(io_msg.dramAddr, io_msg.size); 
-        // Start the DMA
-        osEPiStartDma(g_romHandle, &io_msg, OS_READ);
+        bool finished;
+        if (batch.size() > 1)
+        {
+            const LoadSegment& first = batch[0].rx_slot->segments[0];
+            uint32_t batch_size = 0;
+            for (const auto& load : batch)
+            {
+                batch_size += load.rx_slot->segments[0].size;
+            }
+            dma_read(io_msg, first.dest, first.rom_pos, batch_size);
+            finished = true;
+        }
+        else if (batch[0].rx_slot->compressed_size != 0)
+        {
+            finished = stream_compressed_load(io_msg, batch[0]);
+        }
+        else
+        {
+            finished = read_load_slice(io_msg, batch[0]);
+        }
+        load_queue_stats.slices++;
 
-        // Load time simulation
-        // {
-        //     OSMesgQueue sleep_queue;
-        //     OSMesg sleep_mesg;
-        //     osCreateMesgQueue(&sleep_queue, &sleep_mesg, 1);
-        //     OSTimer timer;
-        //     osSetTimer(&timer, 0, OS_USEC_TO_CYCLES(10000), &sleep_queue, nullptr);
-        //     osRecvMesg(&sleep_queue, nullptr, OS_MESG_BLOCK);
-        //     osStopTimer(&timer);
-        // }
-        
-        osRecvMesg(&dma_queue, nullptr, OS_MESG_BLOCK);
+        // Put unfinished requests back to be continued once any higher priority requests are done
+        if (!finished)
+        {
+            batch[0].rx_slot->in_flight = false;
+            pending.push_back(batch[0]);
+            continue;
+        }
 
-        // Check if the rx slot's id still matches the tx slot
-        // If it does, send a completed message to the rx slot
-        if (cur_id == cur_rx_slot->id)
+        for (const auto& load : batch)
         {
-            osSendMesg(&cur_rx_slot->queue, nullptr, OS_MESG_NOBLOCK);
+            // Check if the rx slot's id still matches the request
+            // If it does, run the load's callback and then send a completed message to the rx slot
+            if (!load_cancelled(load))
+            {
+                if (load.rx_slot->callback != nullptr)
+                {
+                    load.rx_slot->callback(load.rx_slot->segments[0].dest, load.rx_slot->callback_arg);
+                }
+                osSendMesg(&load.rx_slot->queue, nullptr, OS_MESG_NOBLOCK);
+            }
+            load_queue_stats.completed++;
         }
 
         // debug_printf("Completed data load\n");
@@ -266,27 +627,99 @@ void loadThreadFunc(UNUSED void *arg)
 
 struct LoadedImageEntry
 {
-    uint32_t rom_pos;
+    asset_id_t id;
+    // Null until the image's load has been waited on
     std::unique_ptr<uint8_t> data;
+    LoadHandle handle;
 };
 
+// Most image prefetches that can be waiting on the loader at once, each one holds a load slot until it's finished
+constexpr size_t max_pending_image_loads = 4;
+
+// Images stay loaded for as long as the game runs, since nothing tracks which materials still point at them
+// They're kept out of the asset cache so that they don't permanently take up its entries
 constinit skipfield<LoadedImageEntry, 64> images{};
+uint16_t pending_image_loads = 0;
 
-void* get_or_load_image(const char* path)
+LoadedImageEntry* find_image(asset_id_t id)
 {
-    const struct filerecord *file_record = FileRecords::get_offset(path, strlen(path));
-    uint32_t rom_pos = (uint32_t)(_assetsSegmentStart + file_record->offset);
-
     for (auto it = images.begin(); it != images.end(); ++it)
     {
-        if (it->rom_pos == rom_pos)
+        if (it->id == id)
         {
-            return it->data.get();
+            return &*it;
         }
     }
+    return nullptr;
+}
+
+// Waits for an image's load if it's still pending and frees its load slot
+void finish_image_load(LoadedImageEntry& entry)
+{
+    if (entry.data == nullptr)
+    {
+        entry.data.reset(static_cast<uint8_t*>(entry.handle.join()));
+        entry.handle = LoadHandle{};
+        pending_image_loads--;
+    }
+}
+
+// Starts loading an image if it isn't loaded or loading already, returns whether it's loaded
+// Returns false without starting the load if max_pending_image_loads images are already loading
+bool prefetch_image(const char* path)
+{
+    AssetRecord asset = get_asset_record(path);
+    LoadedImageEntry* entry = find_image(asset.offset);
+    if (entry == nullptr)
+    {
+        // With no room to track the image, get_or_load_image will have to load it the slow way anyway
+        if (images.full())
+        {
+            return true;
+        }
+        if (pending_image_loads == max_pending_image_loads)
+        {
+            return false;
+        }
+        images.emplace(asset.offset, std::unique_ptr<uint8_t>{}, start_file_load(asset));
+        pending_image_loads++;
+        return false;
+    }
+    if (entry->data == nullptr)
+    {
+        if (!entry->handle.is_finished())
+        {
+            return false;
+        }
+        finish_image_load(*entry);
+    }
+    return true;
+}
+
+bool prefetch_model_images(const Model *model)
+{
+    // Keep going after an image that isn't loaded so that the rest of them start loading too
+    bool loaded = true;
+    for (size_t img_idx = 0; img_idx < model->num_images; img_idx++)
+    {
+        loaded = prefetch_image(model->images[img_idx]) && loaded;
+    }
+    return loaded;
+}
+
+void* get_or_load_image(const char* path)
+{
+    AssetRecord asset = get_asset_record(path);
+
+    LoadedImageEntry* entry = find_image(asset.offset);
+    if (entry != nullptr)
+    {
+        finish_image_load(*entry);
+        return entry->data.get();
+    }
 
-    uint8_t* data = (uint8_t*)load_data(rom_pos, file_record->size);
-    images.emplace(rom_pos, std::unique_ptr<uint8_t>(data));
+    uint8_t* data = static_cast<uint8_t*>(load_file(asset));
+    images.emplace(asset.offset, std::unique_ptr<uint8_t>(data), LoadHandle{});
 
     return data;
 }
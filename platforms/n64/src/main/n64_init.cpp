@@ -16,6 +16,8 @@ extern "C" {
 #include <n64_audio.h>
 
 void loadThreadFunc(void *);
+void initChunkThread();
+void chunkThreadFunc(void *);
 
 #include <array>
 
@@ -25,10 +27,16 @@ void platformInit()
 {
 }
 
+uint32_t platformTimeUs()
+{
+    return static_cast<uint32_t>(OS_CYCLES_TO_USEC(osGetTime()));
+}
+
 u8 idleThreadStack[IDLE_THREAD_STACKSIZE] __attribute__((aligned (16)));
 u8 mainThreadStack[MAIN_THREAD_STACKSIZE] __attribute__((aligned (16)));
 u8 audioThreadStack[AUDIO_THREAD_STACKSIZE] __attribute__((aligned (16)));
 u8 loadThreadStack[LOAD_THREAD_STACKSIZE] __attribute__((aligned (16)));
+u8 chunkThreadStack[CHUNK_THREAD_STACKSIZE] __attribute__((aligned (16)));
 
 static OSMesgQueue piMesgQueue;
 static std::array<OSMesg, NUM_PI_MESSAGES> piMessages;
@@ -107,6 +115,12 @@ void idle(__attribute__ ((unused)) void *arg)
     // Start the load thread
     osStartThread(&g_threads[LOAD_THREAD_INDEX]);
 
+    // Create the chunk thread, its queues have to exist before the main thread can run since it won't run first
+    initChunkThread();
+    osCreateThread(&g_threads[CHUNK_THREAD_INDEX], CHUNK_THREAD, chunkThreadFunc, nullptr, chunkThreadStack + CHUNK_THREAD_STACKSIZE, CHUNK_THREAD_PRI);
+    // Start the chunk thread
+    osStartThread(&g_threads[CHUNK_THREAD_INDEX]);
+
     // Create the main thread
     osCreateThread(&g_threads[MAIN_THREAD_INDEX], MAIN_THREAD, mainThreadFunc, nullptr, mainThreadStack + MAIN_THREAD_STACKSIZE, MAIN_THREAD_PRI);
     // Start the main thread
@@ -0,0 +1,59 @@
+#ifndef __PLATFORM_FILES_H__
+#define __PLATFORM_FILES_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+struct LoadRequest;
+struct LoadSegment;
+enum class LoadPriority : uint8_t;
+
+// Called on a loader thread once a load's data has arrived, before the load is marked as finished
+// Receives the load's destination and the argument that was passed to start_data_load
+using load_callback_t = void(*)(void* data, void* arg);
+
+// On PC, rom positions are offsets into the packed asset file, which gets mapped into memory on the first load
+class LoadHandle
+{
+public:
+    // Default constructor
+    LoadHandle() = default;
+    // Cancels the load if it hasn't started yet
+    ~LoadHandle();
+    // Not copyable or copy assignable
+    LoadHandle(const LoadHandle&) = delete;
+    LoadHandle& operator=(const LoadHandle&) = delete;
+    // Move constructor
+    LoadHandle(LoadHandle&& rhs) :
+        request_(std::exchange(rhs.request_, nullptr))
+    {}
+    // Move assignment operator
+    LoadHandle& operator=(LoadHandle&& rhs)
+    {
+        release();
+        request_ = std::exchange(rhs.request_, nullptr);
+        return *this;
+    }
+
+    // Checks if the corresponding load is complete
+    bool is_finished();
+    // Waits for the corresponding load to complete
+    void* join();
+    // Moves the load to a different class if it hasn't started yet
+    void set_priority(LoadPriority priority);
+    // Cancels the load if it hasn't started yet and releases the handle, returns whether the load was cancelled
+    bool cancel();
+private:
+    std::shared_ptr<LoadRequest> request_;
+    LoadHandle(std::shared_ptr<LoadRequest> request) :
+        request_(std::move(request))
+    {}
+    // Cancels the load if it hasn't started yet and drops the handle's reference to it
+    void release();
+
+    friend LoadHandle start_load(const LoadSegment*, size_t, uint32_t, load_callback_t, void*, LoadPriority);
+};
+
+#endif
@@ -0,0 +1,437 @@
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <compression.h>
+#include <files.h>
+#include <mem.h>
+
+// Packed asset file and asset table written by tools/assetpack, looked for in the working directory
+constexpr const char* asset_pack_path = "assets.bin";
+constexpr const char* asset_table_path = "assets.txt";
+// Most threads that serve loads, loads are mostly memcpys so more than a few doesn't help
+constexpr unsigned int max_load_threads = 4;
+
+enum class LoadState : uint8_t {
+    queued,
+    running,
+    finished,
+    cancelled,
+};
+
+// A load that a handle points to, shared between the handle and the thread serving it
+struct LoadRequest
+{
+    std::array<LoadSegment, max_load_segments> segments;
+    uint8_t num_segments;
+    // Size of the data in the asset file if it's compressed, zero if it isn't
+    uint32_t compressed_size;
+    load_callback_t callback;
+    void *callback_arg;
+    uint32_t id;
+    // Guarded by load_mutex
+    LoadPriority priority;
+    LoadState state;
+};
+
+// The packed asset file mapped into memory
+// The mapping is read-only, so only data that's never written to can be used from it directly (images), everything else
+// gets copied into the memory pool where it can be fixed up and freed like on N64
+struct AssetPack
+{
+    const uint8_t *data;
+    size_t size;
+    std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> records;
+
+    AssetPack();
+    ~AssetPack();
+    AssetPack(const AssetPack&) = delete;
+    AssetPack& operator=(const AssetPack&) = delete;
+};
+
+AssetPack::AssetPack() : data(nullptr), size(0), records{}
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(asset_pack_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Could not open asset file " << asset_pack_path << std::endl;
+        exit(1);
+    }
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+    size = static_cast<size_t>(file_size.QuadPart);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    data = mapping != nullptr ? static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    // The view keeps the file mapped on its own
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    int file = open(asset_pack_path, O_RDONLY);
+    if (file < 0)
+    {
+        std::cerr << "Could not open asset file " << asset_pack_path << std::endl;
+        exit(1);
+    }
+    struct stat file_stat;
+    fstat(file, &file_stat);
+    size = static_cast<size_t>(file_stat.st_size);
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    data = mapped != MAP_FAILED ? static_cast<const uint8_t*>(mapped) : nullptr;
+    // The mapping keeps the file mapped on its own
+    close(file);
+#endif
+    if (data == nullptr)
+    {
+        std::cerr << "Could not map asset file " << asset_pack_path << std::endl;
+        exit(1);
+    }
+
+    // Each line of the asset table is "path, offset, size"
+    std::ifstream table(asset_table_path);
+    std::string line;
+    while (std::getline(table, line))
+    {
+        size_t size_sep = line.rfind(", ");
+        size_t offset_sep = size_sep != std::string::npos ? line.rfind(", ", size_sep - 1) : std::string::npos;
+        if (offset_sep == std::string::npos)
+        {
+            continue;
+        }
+        uint32_t offset = std::stoul(line.substr(offset_sep + 2, size_sep - offset_sep - 2));
+        uint32_t file_size = std::stoul(line.substr(size_sep + 2));
+        records.emplace(line.substr(0, offset_sep), std::make_pair(offset, file_size));
+    }
+    if (records.empty())
+    {
+        std::cerr << "Could not read asset table " << asset_table_path << std::endl;
+        exit(1);
+    }
+}
+
+AssetPack::~AssetPack()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data);
+#else
+    munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
+
+AssetPack& asset_pack()
+{
+    // Mapped on first use, which is thread safe for function statics
+    static AssetPack pack{};
+    return pack;
+}
+
+// Returns a pointer to the given range of the asset file
+const uint8_t *asset_data(uint32_t rom_pos, uint32_t size)
+{
+    AssetPack& pack = asset_pack();
+    if (static_cast<size_t>(rom_pos) + size > pack.size)
+    {
+        std::cerr << "Load of " << size << " bytes at " << rom_pos << " is past the end of the asset file" << std::endl;
+        exit(1);
+    }
+    return pack.data + rom_pos;
+}
+
+// Guards the load queue, every request's priority and state, and the stats
+std::mutex load_mutex;
+// Signalled when a load is queued, or when the load threads should exit
+std::condition_variable load_queued_cv;
+// Signalled when a load finishes
+std::condition_variable load_finished_cv;
+std::vector<std::shared_ptr<LoadRequest>> load_queue;
+LoadQueueStats load_queue_stats{};
+uint32_t load_id_counter = 1;
+bool load_threads_stopping = false;
+
+const LoadQueueStats& get_load_queue_stats()
+{
+    return load_queue_stats;
+}
+
+// Whether a load should be served before another one
+bool load_precedes(const std::shared_ptr<LoadRequest>& a, const std::shared_ptr<LoadRequest>& b)
+{
+    if (a->priority != b->priority)
+    {
+        return a->priority < b->priority;
+    }
+    return a->id < b->id;
+}
+
+// Counts the queued loads in each class, must be called with load_mutex held
+void update_queue_stats()
+{
+    std::fill(std::begin(load_queue_stats.queued), std::end(load_queue_stats.queued), 0);
+    for (const auto& request : load_queue)
+    {
+        load_queue_stats.queued[static_cast<size_t>(request->priority)]++;
+    }
+    load_queue_stats.max_queued = std::max<uint16_t>(load_queue_stats.max_queued, load_queue.size());
+}
+
+// Copies or decompresses a load's data into its destinations
+void read_load(const LoadRequest& request)
+{
+    if (request.compressed_size != 0)
+    {
+        const LoadSegment& segment = request.segments[0];
+        LzDecoder decoder{segment.dest, segment.size};
+        decoder.feed(asset_data(segment.rom_pos, request.compressed_size), request.compressed_size);
+        return;
+    }
+    for (size_t segment_idx = 0; segment_idx < request.num_segments; segment_idx++)
+    {
+        const LoadSegment& segment = request.segments[segment_idx];
+        memcpy(segment.dest, asset_data(segment.rom_pos, segment.size), segment.size);
+    }
+}
+
+void loadThreadFunc()
+{
+    while (1)
+    {
+        std::shared_ptr<LoadRequest> request;
+        {
+            std::unique_lock lock(load_mutex);
+            load_queued_cv.wait(lock, []{ return !load_queue.empty() || load_threads_stopping; });
+            if (load_threads_stopping)
+            {
+                return;
+            }
+            auto next = std::min_element(load_queue.begin(), load_queue.end(), load_precedes);
+            request = std::move(*next);
+            load_queue.erase(next);
+            request->state = LoadState::running;
+            update_queue_stats();
+        }
+
+        read_load(*request);
+        if (request->callback != nullptr)
+        {
+            request->callback(request->segments[0].dest, request->callback_arg);
+        }
+
+        {
+            std::lock_guard lock(load_mutex);
+            request->state = LoadState::finished;
+            load_queue_stats.completed++;
+            load_queue_stats.slices += request->num_segments;
+        }
+        load_finished_cv.notify_all();
+    }
+}
+
+// The threads that serve loads, which exit once the program does
+struct LoadThreads
+{
+    std::vector<std::thread> threads;
+
+    LoadThreads()
+    {
+        unsigned int num_threads = std::clamp(std::thread::hardware_concurrency(), 1u, max_load_threads);
+        for (unsigned int i = 0; i < num_threads; i++)
+        {
+            threads.emplace_back(loadThreadFunc);
+        }
+    }
+    ~LoadThreads()
+    {
+        {
+            std::lock_guard lock(load_mutex);
+            load_threads_stopping = true;
+        }
+        load_queued_cv.notify_all();
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+};
+
+// Starts the load threads the first time a load is queued
+void start_load_threads()
+{
+    // Function statics are destroyed before the globals the threads use, so they're stopped while those still exist
+    static LoadThreads load_threads{};
+}
+
+LoadHandle start_load(const LoadSegment *segments, size_t num_segments, uint32_t compressed_size, load_callback_t callback, void *callback_arg,
+    LoadPriority priority)
+{
+    auto request = std::make_shared<LoadRequest>();
+    std::copy_n(segments, num_segments, request->segments.begin());
+    request->num_segments = static_cast<uint8_t>(num_segments);
+    request->compressed_size = compressed_size;
+    request->callback = callback;
+    request->callback_arg = callback_arg;
+    request->priority = priority;
+
+    start_load_threads();
+    {
+        std::lock_guard lock(load_mutex);
+        request->id = load_id_counter++;
+        request->state = LoadState::queued;
+        load_queue.push_back(request);
+        update_queue_stats();
+    }
+    load_queued_cv.notify_one();
+    return LoadHandle{std::move(request)};
+}
+
+LoadHandle start_data_load(void *ret, uint32_t rom_pos, uint32_t size, load_callback_t callback, void *callback_arg, LoadPriority priority)
+{
+    // Allocate memory for the destination if none was provided
+    if (ret == nullptr)
+    {
+        ret = allocRegion(size, ALLOC_FILE);
+    }
+    LoadSegment segment{rom_pos, ret, size};
+    return start_load(&segment, 1, 0, callback, callback_arg, priority);
+}
+
+LoadHandle start_compressed_data_load(void *ret, uint32_t rom_pos, uint32_t compressed_size, uint32_t size, load_callback_t callback, void *callback_arg,
+    LoadPriority priority)
+{
+    // Allocate memory for the destination if none was provided
+    if (ret == nullptr)
+    {
+        ret = allocRegion(size, ALLOC_FILE);
+    }
+    LoadSegment segment{rom_pos, ret, size};
+    return start_load(&segment, 1, compressed_size, callback, callback_arg, priority);
+}
+
+LoadHandle start_scatter_load(const LoadSegment *segments, size_t num_segments, load_callback_t callback, void *callback_arg, LoadPriority priority)
+{
+    return start_load(segments, num_segments, 0, callback, callback_arg, priority);
+}
+
+AssetRecord get_asset_record(const char *path)
+{
+    AssetPack& pack = asset_pack();
+    auto record = pack.records.find(path);
+    if (record == pack.records.end())
+    {
+        std::cerr << "Asset " << path << " is not in the asset table" << std::endl;
+        exit(1);
+    }
+    return AssetRecord{record->second.first, record->second.second};
+}
+
+LoadHandle start_file_load(const AssetRecord& asset)
+{
+    return start_data_load(nullptr, asset.offset, asset.size);
+}
+
+LoadHandle start_file_load(const char *path)
+{
+    return start_file_load(get_asset_record(path));
+}
+
+void *load_file(const AssetRecord& asset)
+{
+    LoadHandle handle = start_file_load(asset);
+    return handle.join();
+}
+
+void *load_file(const char *path)
+{
+    LoadHandle handle = start_file_load(path);
+    return handle.join();
+}
+
+void *load_data(uint32_t rom_pos, uint32_t size)
+{
+    LoadHandle handle = start_data_load(nullptr, rom_pos, size);
+    return handle.join();
+}
+
+void *load_data(void *ret, uint32_t rom_pos, uint32_t size)
+{
+    LoadHandle handle = start_data_load(ret, rom_pos, size);
+    return handle.join();
+}
+
+void* get_or_load_image(const char* path)
+{
+    // Images are only ever read, so they're used straight from the asset file's mapping and there's nothing to cache
+    // or free, writing to one would fault
+    AssetRecord record = get_asset_record(path);
+    return const_cast<uint8_t*>(asset_data(record.offset, record.size));
+}
+
+LoadHandle::~LoadHandle()
+{
+    release();
+}
+
+void LoadHandle::release()
+{
+    // A load that's already running keeps its request alive until it finishes, so the handle can always let go of it
+    if (request_ != nullptr && !cancel())
+    {
+        request_.reset();
+    }
+}
+
+bool LoadHandle::is_finished()
+{
+    std::lock_guard lock(load_mutex);
+    return request_->state == LoadState::finished;
+}
+
+void *LoadHandle::join()
+{
+    std::unique_lock lock(load_mutex);
+    load_finished_cv.wait(lock, [this]{ return request_->state == LoadState::finished; });
+    return request_->segments[0].dest;
+}
+
+void LoadHandle::set_priority(LoadPriority priority)
+{
+    std::lock_guard lock(load_mutex);
+    request_->priority = priority;
+    update_queue_stats();
+}
+
+bool LoadHandle::cancel()
+{
+    {
+        std::lock_guard lock(load_mutex);
+        if (request_->state != LoadState::queued)
+        {
+            return false;
+        }
+        request_->state = LoadState::cancelled;
+        load_queue.erase(std::find(load_queue.begin(), load_queue.end(), request_));
+        load_queue_stats.cancelled++;
+        update_queue_stats();
+    }
+    request_.reset();
+    return true;
+}
@@ -1,3 +1,4 @@
+#include <chrono>
 #include <iostream>
 #include <cstdlib>
 #include <malloc.h>
@@ -29,6 +30,12 @@ constexpr int window_height = 600;
 
 SDL_Window* window;
 
+uint32_t platformTimeUs(void)
+{
+    static const auto start_time = std::chrono::steady_clock::now();
+    return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time).count());
+}
+
 void platformInit(void)
 {
     uint8_t *allMem = static_cast<uint8_t*>(malloc(mem_pool_size));
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -17,7 +18,7 @@
 BeamDefinition beam_definitions[] = {
     { // Zap-E
         { // base
-            "models/beam_Beam-E", // model_name
+            &assets::models::beam_Beam_E, // model_asset
             nullptr,      // model
             "Zap-E",     // enemy_name
             100,          // max_health
@@ -90,7 +91,7 @@ void setup_beam_hitbox(const Vec3& beam_pos, const Vec3s& beam_rot, Vec3& beam_v
 
     if (beam_weapon_model == nullptr)
     {
-        beam_weapon_model = load_model("models/BeamLaser");
+        beam_weapon_model = load_model(assets::models::BeamLaser);
     }
     *model = beam_weapon_model;
 
@@ -272,7 +273,7 @@ void on_beam_enter(BaseEnemyState* base_state, InputData* input, void** player_c
 
     if (beam_weapon_model == nullptr)
     {
-        beam_weapon_model = load_model("models/BeamLaser");
+        beam_weapon_model = load_model(assets::models::BeamLaser);
     }
 }
 
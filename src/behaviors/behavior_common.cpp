@@ -2,6 +2,7 @@
 #include <cmath>
 
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <interaction.h>
 #include <behaviors.h>
@@ -118,9 +119,9 @@ void init_enemy_common(BaseEnemyInfo* base_info, Model** model_out, HealthState*
     // Set up the enemy's model
     // Load the model if it isn't already loaded
     // Don't try to load the model if the model name is null
-    if (base_info->model == nullptr && base_info->model_name != nullptr)
+    if (base_info->model == nullptr && base_info->model_asset != nullptr)
     {
-        base_info->model = load_model(base_info->model_name);
+        base_info->model = load_model(*base_info->model_asset);
     }
     *model_out = base_info->model;
 
@@ -267,7 +268,6 @@ void apply_recoil(const Vec3& pos, Vec3& vel, Entity* hit, float recoil_strength
 }
 
 Model* explosion_model = nullptr;
-const char explosion_model_name[] = "models/Explosion";
 
 void create_explosion(Vec3 pos, int radius, int time, int mask)
 {
@@ -277,7 +277,7 @@ void create_explosion(Vec3 pos, int radius, int time, int mask)
 
     if (explosion_model == nullptr)
     {
-        explosion_model = load_model(explosion_model_name);
+        explosion_model = load_model(assets::models::Explosion);
     }
 
     Model** model_out = get_component<Bit_Model, Model*>(explosion_components, ARCHETYPE_EXPLOSION);
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -14,7 +15,7 @@
 BombDefinition bomber_definitions[] = {
     { // Herb-E
         { // base
-            "models/bomb_Herb-E", // model_name
+            &assets::models::bomb_Herb_E, // model_asset
             nullptr,      // model
             "Herb-E",     // enemy_name
             100,          // max_health
@@ -24,7 +25,7 @@ BombDefinition bomber_definitions[] = {
             81, // head_y_offset
         },
         { // params
-            "models/Sphere", // bomb_model_name
+            &assets::models::Sphere, // bomb_model_asset
             nullptr, // bomb_model
             1536.0f, // sight_radius
             50.0f,  // follow_distance
@@ -199,7 +200,7 @@ Entity* create_bomb_enemy(float x, float y, float z, int subtype)
     // Load the projectile model if it isn't already loaded
     if (definition.params.bomb_model == nullptr)
     {
-        definition.params.bomb_model = load_model(definition.params.bomb_model_name);
+        definition.params.bomb_model = load_model(*definition.params.bomb_model_asset);
     }
 
     return bomber;
@@ -217,7 +218,7 @@ void on_bomber_enter(BaseEnemyState* base_state, InputData* input, void** player
     // Load the projectile model if it isn't already loaded
     if (definition->params.bomb_model == nullptr)
     {
-        definition->params.bomb_model = load_model(definition->params.bomb_model_name);
+        definition->params.bomb_model = load_model(*definition->params.bomb_model_asset);
     }
 }
 
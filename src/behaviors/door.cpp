@@ -1,6 +1,7 @@
 #include <behaviors.h>
 #include <collision.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <gameplay.h>
 #include <audio.h>
 
@@ -62,7 +63,7 @@ Entity* create_door(float x, float y, float z, uint32_t param)
 
     if (door_model == nullptr)
     {
-        door_model = load_model("models/Door");
+        door_model = load_model(assets::models::Door);
     }
     *model_out = door_model;
 
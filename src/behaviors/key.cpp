@@ -1,6 +1,7 @@
 #include <behaviors.h>
 #include <collision.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <gameplay.h>
 #include <audio.h>
 
@@ -38,7 +39,7 @@ Entity* create_key(float x, float y, float z)
 
     if (key_model == nullptr)
     {
-        key_model = load_model("models/Keycard");
+        key_model = load_model(assets::models::Keycard);
     }
     *model_out = key_model;
 
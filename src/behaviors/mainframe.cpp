@@ -16,7 +16,7 @@ struct MainframeState : public BaseEnemyState {
 
 MainframeDefinition mainframe_definition {
     {
-        nullptr, // model_name
+        nullptr, // model_asset
         nullptr, // model
         "Mainframe", // enemy_name
         100,  // max_health
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -17,7 +18,7 @@
 MortarDefinition mortar_definitions[] = {
     { // Blast-E
         { // base
-            "models/mortar_Boom-R", // model_name
+            &assets::models::mortar_Boom_R, // model_asset
             nullptr,      // model
             "Boom-R",    // enemy_name
             100,          // max_health
@@ -28,7 +29,7 @@ MortarDefinition mortar_definitions[] = {
             -20, // head_z_offset
         },
         { // params
-            "models/Sphere", // mortar_model_name
+            &assets::models::Sphere, // mortar_model_asset
             nullptr, // mortar_model
             1536.0f, // sight_radius
             512.0f,  // follow_distance
@@ -241,7 +242,7 @@ Entity* create_mortar_enemy(float x, float y, float z, int subtype)
     // Load the projectile model if it isn't already loaded
     if (definition.params.mortar_model == nullptr)
     {
-        definition.params.mortar_model = load_model(definition.params.mortar_model_name);
+        definition.params.mortar_model = load_model(*definition.params.mortar_model_asset);
     }
 
     return mortar;
@@ -259,7 +260,7 @@ void on_mortar_enter(BaseEnemyState* base_state, InputData* input, void** player
     // Load the projectile model if it isn't already loaded
     if (definition->params.mortar_model == nullptr)
     {
-        definition->params.mortar_model = load_model(definition->params.mortar_model_name);
+        definition->params.mortar_model = load_model(*definition->params.mortar_model_asset);
     }
 }
 
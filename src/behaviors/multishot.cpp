@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -15,7 +16,7 @@
 MultishotDefinition multishoter_definitions[] = {
     { // Gas-E
         { // base
-            "models/multishot_Fume-R", // model_name
+            &assets::models::multishot_Fume_R, // model_asset
             nullptr,      // model
             "Gas-E",      // enemy_name
             100,          // max_health
@@ -25,7 +26,7 @@ MultishotDefinition multishoter_definitions[] = {
             110 // head_y_offset
         },
         { // params
-            "models/Sphere", // shot_model_name
+            &assets::models::Sphere, // shot_model_asset
             nullptr, // shot_model
             1536.0f, // sight_radius
             512.0f,  // follow_distance
@@ -205,7 +206,7 @@ Entity* create_multishot_enemy(float x, float y, float z, int subtype)
     // Load the projectile model if it isn't already loaded
     if (definition.params.shot_model == nullptr)
     {
-        definition.params.shot_model = load_model(definition.params.shot_model_name);
+        definition.params.shot_model = load_model(*definition.params.shot_model_asset);
     }
 
     return enemy;
@@ -223,7 +224,7 @@ void on_multishoter_enter(BaseEnemyState* base_state, InputData* input, void** p
     // Load the projectile model if it isn't already loaded
     if (definition->params.shot_model == nullptr)
     {
-        definition->params.shot_model = load_model(definition->params.shot_model_name);
+        definition->params.shot_model = load_model(*definition->params.shot_model_asset);
     }
 }
 
@@ -18,6 +18,7 @@ extern "C" {
 #include <platform.h>
 #include <platform_gfx.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <behaviors.h>
 #include <control.h>
 #include <text.h>
@@ -252,7 +253,7 @@ void createPlayerCallback(UNUSED size_t count, UNUSED void *arg, void **componen
 
     if (pointer_model == nullptr)
     {
-        pointer_model = load_model("models/Pointer");
+        pointer_model = load_model(assets::models::Pointer);
     }
 
     if (pointer_entity != nullptr)
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -18,7 +19,7 @@ constexpr float ram_stop_time_constant = 0.2f;
 RamDefinition ram_definitions[] = {
     { // Till-R
         { // base
-            "models/ram_Till-R", // model_name
+            &assets::models::ram_Till_R, // model_asset
             nullptr,      // model
             "Till-R",     // enemy_name
             100,          // max_health
@@ -97,7 +98,7 @@ void setup_ram_hitbox(const Vec3& rammer_pos, Vec3s& rammer_rot, Vec3& rammer_ve
 
     if (ram_weapon_model == nullptr)
     {
-        ram_weapon_model = load_model("models/Weapon");
+        ram_weapon_model = load_model(assets::models::Weapon);
     }
     *model = ram_weapon_model;
 
@@ -295,7 +296,7 @@ void on_ram_enter(BaseEnemyState* base_state, InputData* input, void** player_co
 
     if (ram_weapon_model == nullptr)
     {
-        ram_weapon_model = load_model("models/Weapon");
+        ram_weapon_model = load_model(assets::models::Weapon);
     }
 }
 
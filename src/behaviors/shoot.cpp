@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -15,7 +16,7 @@
 ShootDefinition shooter_definitions[] = {
     { // Grease-E
         { // base
-            "models/shot_Grease-E", // model_name
+            &assets::models::shot_Grease_E, // model_asset
             nullptr,      // model
             "Grease-E",   // enemy_name
             100,          // max_health
@@ -26,7 +27,7 @@ ShootDefinition shooter_definitions[] = {
             -25, // head_z_offset
         },
         { // params
-            "models/Sphere", // shot_model_name
+            &assets::models::Sphere, // shot_model_asset
             nullptr, // shot_model
             1536.0f, // sight_radius
             512.0f,  // follow_distance
@@ -162,7 +163,7 @@ Entity* create_shoot_enemy(float x, float y, float z, int subtype)
     // Load the projectile model if it isn't already loaded
     if (definition.params.shot_model == nullptr)
     {
-        definition.params.shot_model = load_model(definition.params.shot_model_name);
+        definition.params.shot_model = load_model(*definition.params.shot_model_asset);
     }
 
     return shooter;
@@ -180,7 +181,7 @@ void on_shooter_enter(BaseEnemyState* base_state, InputData* input, void** playe
     // Load the projectile model if it isn't already loaded
     if (definition->params.shot_model == nullptr)
     {
-        definition->params.shot_model = load_model(definition->params.shot_model_name);
+        definition->params.shot_model = load_model(*definition->params.shot_model_asset);
     }
 }
 
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -15,7 +16,7 @@
 SlasherDefinition slasher_definitions[] = {
     { // 0
         { // base
-            "models/slash_Mend-E", // model_name
+            &assets::models::slash_Mend_E, // model_asset
             nullptr,      // model
             "Mend-E",     // enemy_name
             100,          // max_health
@@ -96,7 +97,7 @@ void setup_slash_hitbox(const Vec3& slasher_pos, const Vec3s& slasher_rot, Vec3&
 
     if (slash_weapon_model == nullptr)
     {
-        slash_weapon_model = load_model("models/arm_Mend-E");
+        slash_weapon_model = load_model(assets::models::arm_Mend_E);
     }
     *model = slash_weapon_model;
 
@@ -283,7 +284,7 @@ void on_slasher_enter(BaseEnemyState* base_state, InputData* input, void** playe
 
     if (slash_weapon_model == nullptr)
     {
-        slash_weapon_model = load_model("models/arm_Mend-E");
+        slash_weapon_model = load_model(assets::models::arm_Mend_E);
     }
 }
 
@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -16,7 +17,7 @@
 SpinnerDefinition spinner_definitions[] = {
     { // Harv-E
         { // base
-            "models/spinner_Harv-E", // model_name
+            &assets::models::spinner_Harv_E, // model_asset
             nullptr,      // model
             "Harv-E",     // enemy_name
             100,          // max_health
@@ -26,7 +27,7 @@ SpinnerDefinition spinner_definitions[] = {
             120, // head_y_offset
         },
         { // params
-            "models/blade_Harv-E", // blade_model_name
+            &assets::models::blade_Harv_E, // blade_model_asset
             nullptr, // blade_model
             1536.0f, // sight_radius
             150.0f, // follow_distance
@@ -80,7 +81,7 @@ void setup_blade_hitbox(const Vec3& spinner_pos, SpinnerState* state, void** hit
 
     if (params->blade_model == nullptr)
     {
-        params->blade_model = load_model(params->blade_model_name);
+        params->blade_model = load_model(*params->blade_model_asset);
     }
     *model = params->blade_model;
 
@@ -252,7 +253,7 @@ void on_spinner_enter(BaseEnemyState* base_state, InputData* input, void** playe
 
     if (definition->params.blade_model == nullptr)
     {
-        definition->params.blade_model = load_model(definition->params.blade_model_name);
+        definition->params.blade_model = load_model(*definition->params.blade_model_asset);
     }
     
     queue_entity_creation(ARCHETYPE_SPINNER_HITBOX, get_entity(player_components), 1, create_player_spinner_blade_callback);
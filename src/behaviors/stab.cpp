@@ -2,6 +2,7 @@
 #include <player.h>
 #include <behaviors.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <mathutils.h>
 #include <physics.h>
 #include <collision.h>
@@ -15,7 +16,7 @@
 StabDefinition stab_definitions[] = {
     { // 0
         { // base
-            "models/stab_Drill-R", // model_name
+            &assets::models::stab_Drill_R, // model_asset
             nullptr,      // model
             "Drill-R",     // enemy_name
             100,          // max_health
@@ -108,7 +109,7 @@ void setup_stab_hitbox(const Vec3& stab_pos, const Vec3s& stab_rot, Vec3& stab_v
 
     if (stab_weapon_model == nullptr)
     {
-        stab_weapon_model = load_model("models/drill_Drill-R");
+        stab_weapon_model = load_model(assets::models::drill_Drill_R);
     }
     *model = stab_weapon_model;
 
@@ -262,7 +263,7 @@ void on_stab_enter(BaseEnemyState* base_state, InputData* input, void** player_c
 
     if (stab_weapon_model == nullptr)
     {
-        stab_weapon_model = load_model("models/drill_Drill-R");
+        stab_weapon_model = load_model(assets::models::drill_Drill_R);
     }
 }
 
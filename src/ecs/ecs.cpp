@@ -57,6 +57,8 @@ struct EntityCreationParams {
 
 block_vector<Entity*> queued_deletions;
 block_vector<EntityCreationParams> queued_creations;
+// Creation queue currently being processed, swapped with queued_creations so that neither has to reallocate
+block_vector<EntityCreationParams> processing_creations;
 
 
 void queue_entity_deletion(Entity *e)
@@ -91,13 +93,13 @@ void process_entity_queues()
     // The callbacks are allowed to create more entities, so we need to repeat processing of the creation queue.
     while (!queued_creations.empty())
     {
-        // Move the current creation queue into a temporary to allow callbacks to spawn more entities
-        // This also clears queued_creations via the move operation
-        block_vector<EntityCreationParams> cur_queued_creations = std::move(queued_creations);
-        for (const EntityCreationParams& params : cur_queued_creations)
+        // Swap the current creation queue with the (empty) processing queue to allow callbacks to spawn more entities
+        processing_creations.swap(queued_creations);
+        for (const EntityCreationParams& params : processing_creations)
         {
             createEntitiesCallback(params.archetype, params.arg, params.count, params.callback);
         }
+        processing_creations.clear_retain();
     }
 }
 
@@ -109,9 +111,9 @@ void iterateOverEntities(EntityArrayCallback callback, void *arg, archetype_t co
     auto components = std::unique_ptr<size_t[]>(new size_t[numComponents]);
     archetype_t componentBits = componentMask;
 
-    // Clear the entity queues
-    queued_deletions = {};
-    queued_creations = {};
+    // Clear the entity queues, keeping their memory for reuse
+    queued_deletions.clear_retain();
+    queued_creations.clear_retain();
 
     componentIndex = 0;
     while (componentBits)
@@ -168,9 +170,9 @@ void iterateOverEntitiesAllComponents(EntityArrayCallbackAll callback, void *arg
 {
     int curArchetypeIndex;
 
-    // Clear the entity queues
-    queued_deletions = {};
-    queued_creations = {};
+    // Clear the entity queues, keeping their memory for reuse
+    queued_deletions.clear_retain();
+    queued_creations.clear_retain();
 
     for (curArchetypeIndex = 0; curArchetypeIndex < numArchetypes; curArchetypeIndex++)
     {
@@ -1,6 +1,8 @@
 #include <misc_scenes.h>
 #include <input.h>
 #include <files.h>
+#include <asset_cache.h>
+#include <asset_ids.h>
 #include <mem.h>
 #include <gameplay.h>
 #include <save.h>
@@ -13,14 +15,14 @@ ControlsScene::~ControlsScene()
 {
     if (howtoplay_image_ != nullptr)
     {
-        freeAlloc(howtoplay_image_);
+        release_asset(howtoplay_image_);
         howtoplay_image_ = nullptr;
     }
 }
 
 bool ControlsScene::load()
 {
-    howtoplay_image_ = load_file("textures/howtoplay");
+    howtoplay_image_ = acquire_asset(assets::textures::howtoplay, AssetType::file);
     load_save();
     return true;
 }
@@ -1,4 +1,5 @@
 #include <cmath>
+#include <iterator>
 
 #include <gameplay.h>
 #include <camera.h>
@@ -8,6 +9,8 @@
 #include <ecs.h>
 #include <main.h>
 #include <files.h>
+#include <asset_cache.h>
+#include <asset_ids.h>
 #include <input.h>
 #include <collision.h>
 #include <behaviors.h>
@@ -19,14 +22,26 @@ extern "C" {
 #include <debug.h>
 }
 
-extern GridDefinition get_grid_definition(const char *file);
+extern GridDefinition get_grid_definition(const AssetRecord& level);
 
-GameplayScene::GameplayScene(int level_index) : grid_{}, level_index_{level_index}, unload_timer_{0}, keys_{0}, timer_{0}
+// CPU time GameplayScene::load can spend each frame before leaving the rest of the load for the next frame
+constexpr uint32_t scene_load_budget_us = 8000;
+
+GameplayScene::GameplayScene(int level_index) : grid_{}, level_index_{level_index}, unload_timer_{0}, keys_{0}, timer_{0},
+    load_stage_{LoadStage::player}, tiles_prefetched_{0}, tiles_acquired_{0}, tiles_{}
 {
 }
 
 GameplayScene::~GameplayScene()
 {
+    // Tile models that were acquired but never handed to the grid
+    for (size_t i = 0; i < tiles_acquired_ && i < tiles_.size(); i++)
+    {
+        if (tiles_[i].model != nullptr)
+        {
+            release_asset(tiles_[i].model);
+        }
+    }
     deleteAllEntities();
     stopMusic();
 }
@@ -36,12 +51,50 @@ GameplayScene::~GameplayScene()
 // Entity* rect_hitbox;
 
 std::array levels {
-    "levels/1",
-    "levels/2",
-    "levels/3"
+    &assets::levels::_1,
+    &assets::levels::_2,
+    &assets::levels::_3
 };
 
-bool GameplayScene::load()
+// Model of each tile id, the tile ids' collision types are in tile_collisions (shared with levelconv, which bakes each
+// chunk's floors and walls from them)
+constexpr const AssetRecord* tile_models[] = {
+    &assets::models::metalRim_mid,
+    &assets::models::metalGrate,
+    &assets::models::dirtrocky_B,
+    &assets::models::stone_A,
+    &assets::models::grass_A,
+    &assets::models::dirt_A,
+    &assets::models::metalEmboss,
+    &assets::models::water_dirtrocky_A,
+    &assets::models::metalRamp,
+    &assets::models::stoneLava_A,
+    &assets::models::dirtRockyRamp,
+    &assets::models::stone_Ramp,
+    &assets::models::dirtrockyXstone_Ramp,
+    &assets::models::stone_Obstacle,
+    &assets::models::SlopeWhite,
+    &assets::models::crop_B,
+    &assets::models::wall_Out,
+    &assets::models::crop_Obstacle,
+    &assets::models::WallBrown,
+    &assets::models::wall_stone2,
+    &assets::models::metalObstacle,
+    &assets::models::WallRed,
+    &assets::models::WallWhite,
+    &assets::models::WallYellow,
+    &assets::models::wallC_Out,
+    &assets::models::grass_B,
+    &assets::models::grass_C,
+    &assets::models::wallC_stone2,
+    &assets::models::grass_D,
+    &assets::models::CornerRed,
+    nullptr, // invisible wall
+    &assets::models::mainframe,
+};
+static_assert(std::size(tile_models) == tile_collisions.size(), "Every tile id needs both a model and a collision type");
+
+void GameplayScene::load_player()
 {
     Vec3 pos;
     switch (level_index_)
@@ -78,50 +131,56 @@ bool GameplayScene::load()
 
     // Create the player entity
     createPlayer(pos);
+}
+
+bool GameplayScene::load_tiles(uint32_t start_time)
+{
+    while (tiles_acquired_ < std::size(tile_models))
+    {
+        // Take the upcoming tile models that have arrived, which frees up their load slots and starts loading their images
+        for (size_t tile_idx = tiles_acquired_; tile_idx < tiles_prefetched_; tile_idx++)
+        {
+            if (tile_models[tile_idx] != nullptr)
+            {
+                is_asset_loaded(*tile_models[tile_idx]);
+            }
+        }
+
+        // Keep as many of the upcoming tile models loading as the asset cache allows
+        // Models that are still in memory from the last level are reused instead of being loaded again
+        while (tiles_prefetched_ < std::size(tile_models) &&
+            (tile_models[tiles_prefetched_] == nullptr || prefetch_asset(*tile_models[tiles_prefetched_], AssetType::model)))
+        {
+            tiles_prefetched_++;
+        }
 
-    debug_printf("Loading tiles\n");
-
-    dynamic_array<TileType> tiles(32);
-
-    int i = 0;
-
-    tiles[i++] = TileType{load_model("models/metalRim.mid"),  TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/metalGrate"),     TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/dirtrocky.B"),    TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/stone.A"),     TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/grass.A"),    TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/dirt.A"),      TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/metalEmboss"),   TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/water_dirtrocky.A"),   TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/metalRamp"),     TileCollision::slope};
-    tiles[i++] = TileType{load_model("models/stoneLava.A"),     TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/dirtRockyRamp"),    TileCollision::slope};
-    tiles[i++] = TileType{load_model("models/stone_Ramp"),     TileCollision::slope};
-    tiles[i++] = TileType{load_model("models/dirtrockyXstone_Ramp"),    TileCollision::slope};
-    tiles[i++] = TileType{load_model("models/stone_Obstacle"),      TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/SlopeWhite"),    TileCollision::slope};
-    tiles[i++] = TileType{load_model("models/crop.B"),   TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/wall_Out"),      TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/crop_Obstacle"),      TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/WallBrown"),     TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/wall_stone2"),      TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/metalObstacle"),     TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/WallRed"),       TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/WallWhite"),     TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/WallYellow"),    TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/wallC_Out"),     TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/grass.B"),       TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/grass.C"),       TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/wallC_stone2"),    TileCollision::wall};
-    tiles[i++] = TileType{load_model("models/grass.D"),       TileCollision::floor};
-    tiles[i++] = TileType{load_model("models/CornerRed"),     TileCollision::wall};
-    tiles[i++] = TileType{nullptr,                         TileCollision::wall}; // invisible wall
-    tiles[i++] = TileType{load_model("models/mainframe"),  TileCollision::wall};
+        // Come back next frame instead of blocking on the loader while the model or its images are loading (prefetching it
+        // again covers a model that was evicted after its prefetch finished)
+        // If the cache can't take the load at all, e.g. because it's full of referenced assets, acquire it right away
+        // instead, which loads an untracked copy rather than waiting for room that may never free up
+        const AssetRecord* model = tile_models[tiles_acquired_];
+        if (model != nullptr && !is_asset_loaded(*model) && prefetch_asset(*model, AssetType::model))
+        {
+            return false;
+        }
+        // With the model and its images in memory, acquiring it only has to set up its display lists
+        tiles_[tiles_acquired_] = TileType{model != nullptr ? acquire_model(*model) : nullptr, tile_collisions[tiles_acquired_]};
+        tiles_acquired_++;
 
+        if (platformTimeUs() - start_time >= scene_load_budget_us)
+        {
+            break;
+        }
+    }
+    return tiles_acquired_ == std::size(tile_models);
+}
+
+void GameplayScene::load_level()
+{
     debug_printf("Getting grid definition\n");
 
-    GridDefinition def = get_grid_definition(levels[level_index_]);
-    grid_ = Grid{def, std::move(tiles)};
+    GridDefinition def = get_grid_definition(*levels[level_index_]);
+    grid_ = Grid{def, std::move(tiles_)};
 
     debug_printf("Finished GameplayScene::load\n");
 
@@ -144,14 +203,67 @@ bool GameplayScene::load()
     }
 
     playMusic(level_index_);
+}
 
-    return true;
+bool GameplayScene::load()
+{
+    uint32_t start_time = platformTimeUs();
+    while (load_stage_ != LoadStage::done)
+    {
+        switch (load_stage_)
+        {
+            case LoadStage::player:
+                load_player();
+                debug_printf("Loading tiles\n");
+                tiles_ = dynamic_array<TileType>(std::size(tile_models));
+                load_stage_ = LoadStage::tiles;
+                break;
+            case LoadStage::tiles:
+                if (!load_tiles(start_time))
+                {
+                    return false;
+                }
+                load_stage_ = LoadStage::level;
+                break;
+            case LoadStage::level:
+                load_level();
+                load_stage_ = LoadStage::done;
+                break;
+            case LoadStage::done:
+                break;
+        }
+        if (platformTimeUs() - start_time >= scene_load_budget_us)
+        {
+            break;
+        }
+    }
+    return load_stage_ == LoadStage::done;
+}
+
+int GameplayScene::load_progress()
+{
+    // Setting up the tile models is most of the work, the level's objects take about as long as a few models
+    constexpr int level_weight = 4;
+    constexpr int total_weight = static_cast<int>(std::size(tile_models)) + level_weight;
+    switch (load_stage_)
+    {
+        case LoadStage::player:
+            return 0;
+        case LoadStage::tiles:
+            return tiles_acquired_ * 100 / total_weight;
+        case LoadStage::level:
+            return static_cast<int>(std::size(tile_models)) * 100 / total_weight;
+        case LoadStage::done:
+            break;
+    }
+    return 100;
 }
 
 void GameplayScene::update()
 {
     grid_.unload_nonvisible_chunks(g_Camera);
     grid_.load_visible_chunks(g_Camera);
+    grid_.prefetch_chunks(g_Camera);
     grid_.process_loading_chunks();
     // if ((g_PlayerInput.buttonsHeld & R_TRIG) || (g_PlayerInput.buttonsPressed & L_TRIG))
     {
@@ -285,10 +397,17 @@ void LevelTransitionScene::update()
     }
 }
 // Called every frame while the scene is active every frame for drawing the scene contents
-void LevelTransitionScene::draw(UNUSED bool unloading)
+void LevelTransitionScene::draw(bool unloading)
 {
     char text[32];
-    sprintf(text, "Loading level %d", level_index_ + 1);
+    if (unloading)
+    {
+        sprintf(text, "Loading level %d... %d%%", level_index_ + 1, get_scene_load_progress());
+    }
+    else
+    {
+        sprintf(text, "Loading level %d", level_index_ + 1);
+    }
     print_text_centered(screen_width / 2, screen_height / 2, text);
     draw_all_text();
 }
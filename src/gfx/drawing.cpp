@@ -6,6 +6,7 @@
 #include <ecs.h>
 #include <model.h>
 #include <files.h>
+#include <asset_ids.h>
 #include <behaviors.h>
 #include <gameplay.h>
 #include <interaction.h>
@@ -323,11 +324,11 @@ void draw_enemy_heads()
 {
     if (head_model == nullptr)
     {
-        head_model = load_model("models/Head_Enemy");
+        head_model = load_model(assets::models::Head_Enemy);
     }
     if (player_head_model == nullptr)
     {
-        player_head_model = load_model("models/Head_Player");
+        player_head_model = load_model(assets::models::Head_Player);
     }
     void* player_components[NUM_COMPONENTS(ARCHETYPE_PLAYER) + 1];
     getEntityComponents(g_PlayerEntity, player_components);
@@ -0,0 +1,305 @@
+#include <algorithm>
+#include <array>
+#include <bit>
+
+#include <asset_cache.h>
+#include <mem.h>
+#include <skipfield.h>
+
+enum class AssetState : uint8_t {
+    // Waiting for the loader
+    loading,
+    // Loaded, with its offsets adjusted, and waiting for the loader to bring in its images (models only)
+    loading_images,
+    // Loaded and being set up for its type
+    setting_up,
+    // Ready to be used, and evicted if unreferenced
+    ready,
+};
+
+struct AssetCacheEntry
+{
+    asset_id_t id;
+    AssetType type;
+    AssetState state;
+    uint16_t refcount;
+    // When the asset was last released, the least recently released unreferenced asset is evicted first
+    uint32_t age;
+    void* data;
+    LoadHandle handle;
+};
+
+constexpr size_t asset_index_size = std::bit_ceil(max_cached_assets * 2);
+
+uintptr_t asset_id_key(const AssetCacheEntry* entry)
+{
+    return entry->id;
+}
+
+uintptr_t asset_data_key(const AssetCacheEntry* entry)
+{
+    return reinterpret_cast<uintptr_t>(entry->data);
+}
+
+// Index of the cached assets by one of their fields, linear probing with twice as many slots as there can be assets
+template <uintptr_t (*KeyOf)(const AssetCacheEntry*)>
+class AssetIndex
+{
+public:
+    constexpr AssetIndex() : slots_{} {}
+
+    AssetCacheEntry* find(uintptr_t key) const
+    {
+        for (size_t slot = slot_for(key); slots_[slot] != nullptr; slot = next_slot(slot))
+        {
+            if (KeyOf(slots_[slot]) == key)
+            {
+                return slots_[slot];
+            }
+        }
+        return nullptr;
+    }
+
+    void insert(AssetCacheEntry* entry)
+    {
+        size_t slot = slot_for(KeyOf(entry));
+        while (slots_[slot] != nullptr)
+        {
+            slot = next_slot(slot);
+        }
+        slots_[slot] = entry;
+    }
+
+    void remove(const AssetCacheEntry* entry)
+    {
+        size_t hole = slot_for(KeyOf(entry));
+        while (slots_[hole] != entry)
+        {
+            hole = next_slot(hole);
+        }
+        // Shift back any later entries in the run that would no longer be found past the hole, so lookups never need
+        // to skip over removed slots
+        for (size_t slot = next_slot(hole); slots_[slot] != nullptr; slot = next_slot(slot))
+        {
+            size_t home = slot_for(KeyOf(slots_[slot]));
+            if (((slot - home) & (asset_index_size - 1)) >= ((slot - hole) & (asset_index_size - 1)))
+            {
+                slots_[hole] = slots_[slot];
+                hole = slot;
+            }
+        }
+        slots_[hole] = nullptr;
+    }
+private:
+    std::array<AssetCacheEntry*, asset_index_size> slots_;
+
+    static size_t slot_for(uintptr_t key)
+    {
+        // Asset ids are offsets into the asset file and data pointers are heap allocations, both of which are mostly
+        // aligned, so use the top bits of a multiplicative hash. 64-bit pointers have their halves folded together first.
+        constexpr int index_bits = std::countr_zero(asset_index_size);
+        uint64_t wide_key = key;
+        uint32_t folded_key = static_cast<uint32_t>(wide_key) ^ static_cast<uint32_t>(wide_key >> 32);
+        return (folded_key * 0x9E3779B1u) >> (32 - index_bits);
+    }
+
+    static size_t next_slot(size_t slot)
+    {
+        return (slot + 1) & (asset_index_size - 1);
+    }
+};
+
+constinit skipfield<AssetCacheEntry, max_cached_assets> asset_entries{};
+// Every cached asset is indexed by id, and the ones that are ready are also indexed by data pointer for release_asset
+constinit AssetIndex<asset_id_key> asset_index{};
+constinit AssetIndex<asset_data_key> asset_data_index{};
+constinit AssetCacheStats asset_cache_stats{};
+uint32_t asset_cache_age = 0;
+uint16_t pending_asset_loads = 0;
+
+AssetCacheEntry* find_asset(asset_id_t id)
+{
+    return asset_index.find(id);
+}
+
+// Waits for an entry's load and frees its load slot, then starts loading a model's images
+// Files are ready as soon as they arrive, models still have to be set up by finish_asset_load
+void receive_asset_load(AssetCacheEntry& entry)
+{
+    entry.data = entry.handle.join();
+    entry.handle = LoadHandle{};
+    pending_asset_loads--;
+    if (entry.type == AssetType::model)
+    {
+        Model* model = static_cast<Model*>(entry.data);
+        adjust_loaded_model(model);
+        prefetch_model_images(model);
+        entry.state = AssetState::loading_images;
+        return;
+    }
+    entry.state = AssetState::ready;
+    asset_data_index.insert(&entry);
+}
+
+// Waits for an entry's load and sets up the data for its type
+void finish_asset_load(AssetCacheEntry& entry)
+{
+    if (entry.state == AssetState::loading)
+    {
+        receive_asset_load(entry);
+    }
+    if (entry.state != AssetState::loading_images)
+    {
+        return;
+    }
+    // Setting up a model waits for any of its images that are still loading, so keep the entry from being evicted or
+    // finished again until that's done
+    entry.state = AssetState::setting_up;
+    setup_model_gfx(static_cast<Model*>(entry.data));
+    entry.state = AssetState::ready;
+    asset_data_index.insert(&entry);
+}
+
+// Starts loading an asset that isn't in the cache, returns nullptr if the cache is full of referenced assets
+AssetCacheEntry* start_asset_load(const AssetRecord& asset, AssetType type, LoadPriority priority)
+{
+    // Make room in memory and in the cache first
+    while ((getMemoryStats().free_blocks < asset_cache_min_free_blocks || asset_entries.full()) && evict_unreferenced_asset())
+    {}
+    if (asset_entries.full())
+    {
+        return nullptr;
+    }
+    // Each pending load holds a load slot, so don't let prefetches take up too many of them
+    if (pending_asset_loads == max_pending_asset_loads)
+    {
+        auto pending = std::find_if(asset_entries.begin(), asset_entries.end(), [](const AssetCacheEntry& entry) { return entry.state == AssetState::loading; });
+        receive_asset_load(*pending);
+    }
+    AssetCacheEntry& entry = *asset_entries.emplace(asset.offset, type, AssetState::loading, static_cast<uint16_t>(0), asset_cache_age++, nullptr, start_file_load(asset));
+    entry.handle.set_priority(priority);
+    pending_asset_loads++;
+    asset_index.insert(&entry);
+    asset_cache_stats.misses++;
+    asset_cache_stats.unreferenced++;
+    return &entry;
+}
+
+void* acquire_asset(const AssetRecord& asset, AssetType type)
+{
+    AssetCacheEntry* entry = find_asset(asset.offset);
+    if (entry != nullptr)
+    {
+        asset_cache_stats.hits++;
+    }
+    else
+    {
+        entry = start_asset_load(asset, type, LoadPriority::critical);
+        if (entry == nullptr)
+        {
+            // Nothing can be evicted to track the asset, so hand out an untracked copy that release_asset will free
+            void* data = load_file(asset);
+            if (type == AssetType::model)
+            {
+                setup_loaded_model(static_cast<Model*>(data));
+            }
+            return data;
+        }
+    }
+    // Take the reference before finishing the load so the entry can't be evicted while its data is being set up
+    if (entry->refcount++ == 0)
+    {
+        asset_cache_stats.unreferenced--;
+    }
+    finish_asset_load(*entry);
+    return entry->data;
+}
+
+void* acquire_asset(const char* path, AssetType type)
+{
+    return acquire_asset(get_asset_record(path), type);
+}
+
+bool prefetch_asset(const AssetRecord& asset, AssetType type, LoadPriority priority)
+{
+    if (find_asset(asset.offset) != nullptr)
+    {
+        return true;
+    }
+    if (pending_asset_loads == max_pending_asset_loads)
+    {
+        return false;
+    }
+    return start_asset_load(asset, type, priority) != nullptr;
+}
+
+bool is_asset_loaded(const AssetRecord& asset)
+{
+    AssetCacheEntry* entry = find_asset(asset.offset);
+    if (entry == nullptr)
+    {
+        return false;
+    }
+    if (entry->state == AssetState::loading)
+    {
+        if (!entry->handle.is_finished())
+        {
+            return false;
+        }
+        receive_asset_load(*entry);
+    }
+    return entry->state != AssetState::loading_images || prefetch_model_images(static_cast<Model*>(entry->data));
+}
+
+void release_asset(const void* data)
+{
+    AssetCacheEntry* entry = asset_data_index.find(reinterpret_cast<uintptr_t>(data));
+    if (entry == nullptr)
+    {
+        // Untracked copy from acquire_asset
+        freeAlloc(const_cast<void*>(data));
+        return;
+    }
+    if (--entry->refcount == 0)
+    {
+        entry->age = asset_cache_age++;
+        asset_cache_stats.unreferenced++;
+        // Give memory back if the heap is running low
+        while (getMemoryStats().free_blocks < asset_cache_min_free_blocks && evict_unreferenced_asset())
+        {}
+    }
+}
+
+bool evict_unreferenced_asset()
+{
+    AssetCacheEntry* oldest = nullptr;
+    // A model whose images are still loading can be evicted too, the images are kept separately
+    for (AssetCacheEntry& entry : asset_entries)
+    {
+        bool evictable = entry.state == AssetState::ready || entry.state == AssetState::loading_images;
+        if (entry.refcount == 0 && evictable && (oldest == nullptr || entry.age < oldest->age))
+        {
+            oldest = &entry;
+        }
+    }
+    if (oldest == nullptr)
+    {
+        return false;
+    }
+    asset_index.remove(oldest);
+    if (oldest->state == AssetState::ready)
+    {
+        asset_data_index.remove(oldest);
+    }
+    freeAlloc(oldest->data);
+    asset_entries.erase(oldest);
+    asset_cache_stats.evictions++;
+    asset_cache_stats.unreferenced--;
+    return true;
+}
+
+const AssetCacheStats& get_asset_cache_stats()
+{
+    asset_cache_stats.resident = static_cast<uint16_t>(asset_entries.size());
+    return asset_cache_stats;
+}
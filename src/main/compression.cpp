@@ -0,0 +1,63 @@
+#include <algorithm>
+#include <cstring>
+
+#include <compression.h>
+
+void LzDecoder::feed(const uint8_t* data, size_t length)
+{
+    const uint8_t* data_end = data + length;
+    while (data != data_end && out_ != out_end_)
+    {
+        switch (state_)
+        {
+            case State::control:
+                {
+                    uint8_t control = *data++;
+                    if (control & 0x80)
+                    {
+                        count_ = (control & 0x7F) + 3;
+                        state_ = State::distance_high;
+                    }
+                    else
+                    {
+                        count_ = control + 1;
+                        state_ = State::literal;
+                    }
+                }
+                break;
+            case State::literal:
+                {
+                    // Copy as much of the literal run as is available in this piece
+                    size_t to_copy = std::min<size_t>({count_, static_cast<size_t>(data_end - data), static_cast<size_t>(out_end_ - out_)});
+                    memcpy(out_, data, to_copy);
+                    out_ += to_copy;
+                    data += to_copy;
+                    count_ -= to_copy;
+                    if (count_ == 0)
+                    {
+                        state_ = State::control;
+                    }
+                }
+                break;
+            case State::distance_high:
+                distance_ = *data++ << 8;
+                state_ = State::distance_low;
+                break;
+            case State::distance_low:
+                {
+                    distance_ = (distance_ | *data++) + 1;
+                    // The referenced bytes are already in the output, so the whole back-reference can be copied now
+                    // This has to be done a byte at a time, since it can overlap with the bytes it's writing
+                    const uint8_t* src = out_ - distance_;
+                    size_t to_copy = std::min<size_t>(count_, out_end_ - out_);
+                    for (size_t i = 0; i < to_copy; i++)
+                    {
+                        out_[i] = src[i];
+                    }
+                    out_ += to_copy;
+                    state_ = State::control;
+                }
+                break;
+        }
+    }
+}
@@ -1,3 +1,4 @@
+#include <cinttypes>
 #include <cstring>
 #include <memory>
 
@@ -37,8 +38,26 @@ bool is_scene_loading()
     return bool{loading_scene};
 }
 
+int get_scene_load_progress()
+{
+    return loading_scene ? loading_scene->load_progress() : 100;
+}
+
 int cur_level_idx = 0;
 
+// Maximum number of memory blocks the heap compactor can move each frame
+constexpr int compaction_blocks_per_frame = 8;
+
+// Time each iteration of the main loop has before it holds up the next frame
+#ifdef FPS30
+constexpr uint32_t frame_time_us = 33333;
+#else
+constexpr uint32_t frame_time_us = 16667;
+#endif
+// Time that has to be left in the frame for the heap compactor to run, which covers a move larger than the per-frame
+// block budget
+constexpr uint32_t compaction_time_us = 2000;
+
 void update()
 {
     // If there's a scene that is currently loading,
@@ -61,6 +80,26 @@ void update()
 #define PROFILING
 // #endif
 
+#ifdef PROFILING
+// Number of frames between printouts of the grid's draw stats
+constexpr uint32_t draw_stats_interval = 60;
+
+// Prints how much of the grid the last draw culled, once every draw_stats_interval frames
+void printDrawStats()
+{
+    Grid* grid = cur_scene->get_grid();
+    if (grid == nullptr || g_graphicsTimer % draw_stats_interval != 0)
+    {
+        return;
+    }
+    const GridDrawStats& stats = grid->get_draw_stats();
+    debug_printf("Chunks drawn: %u partial: %u culled: %u, columns culled: %u\n",
+        (unsigned int)stats.chunks_drawn, (unsigned int)stats.chunks_partial, (unsigned int)stats.chunks_culled, (unsigned int)stats.columns_culled);
+    debug_printf("Tile draws issued: %" PRIu32 " of %" PRIu32 ", occluded: %" PRIu32 "\n",
+        stats.tile_draws_issued, stats.tile_draws_total, stats.tile_draws_occluded);
+}
+#endif
+
 void audioInit();
 
 int main(UNUSED int argc, UNUSED char **arg)
@@ -81,6 +120,7 @@ int main(UNUSED int argc, UNUSED char **arg)
 
     while (1)
     {
+        uint32_t frame_start = platformTimeUs();
         // Read player input (TODO move this to another thread)
         // debug_printf("before input polling\n");
         beginInputPolling();
@@ -118,12 +158,24 @@ int main(UNUSED int argc, UNUSED char **arg)
 
 #ifdef PROFILING
         profileBeforeGfxMainLoop();
+        printDrawStats();
 #endif
         g_graphicsTimer++;
 
+        // Time spent on this frame's work, not counting endFrame waiting for the previous frame's gfx task
+        uint32_t frame_work_us = platformTimeUs() - frame_start;
+
         endFrame();
 
+        uint32_t after_gfx_start = platformTimeUs();
         cur_scene->after_gfx();
+        frame_work_us += platformTimeUs() - after_gfx_start;
+
+        // Use the remaining time in the frame to defragment the heap a little bit, if there's any to spare
+        if (frame_work_us + compaction_time_us < frame_time_us)
+        {
+            compactHeap(compaction_blocks_per_frame);
+        }
 
 #ifdef PROFILING
         profileEndMainLoop();
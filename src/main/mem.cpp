@@ -1,6 +1,7 @@
 #include <mem.h>
 #include <cstdint>
 #include <cstring>
+#include <algorithm>
 
 #include <iterator>
 #include <array>
@@ -11,6 +12,7 @@ extern "C" {
 }
 
 #include <platform.h>
+#include <skipfield.h>
 #include <mutex>
 
 /**
@@ -92,13 +94,20 @@ private:
     size_t _totalBlocks;
     // First free chunk in the free chunk chain
     MemoryBlock *_firstFree;
+    // The number of free chunks, and the lowest that number has been
+    size_t _freeBlocks;
+    size_t _minFreeBlocks;
 public:
     MemoryPool() = default;
     MemoryPool(void *start, void *end);
     size_t index_from_block(MemoryBlock *t);
     MemoryBlock *block_from_index(size_t index);
     void *alloc(int num_blocks, owner_t owner);
+    void *alloc_below(int num_blocks, owner_t owner, void *limit);
     void free(void *mem) noexcept;
+    MemoryStats stats();
+private:
+    void *claim(size_t start_index, int num_blocks, owner_t owner);
 };
 
 MemoryPool::MemoryPool(void *start, void *end)
@@ -128,6 +137,8 @@ MemoryPool::MemoryPool(void *start, void *end)
     new (curBlock) MemoryBlock(lastBlock, nullptr, _totalBlocks - 1);
     // Clear the block ownership table
     memset(_blockTable, ALLOC_FREE, _totalBlocks);
+    _freeBlocks = _totalBlocks;
+    _minFreeBlocks = _totalBlocks;
 }
 
 // Calculates a block's index from its address
@@ -171,6 +182,8 @@ void *MemoryPool::alloc(int num_blocks, owner_t owner)
         }
         _firstFree = _firstFree->unlink();
         _blockTable[retBlock->index()] = owner;
+        _freeBlocks--;
+        _minFreeBlocks = std::min(_minFreeBlocks, _freeBlocks);
         
         // debug_printf("Allocated %08X\n", retBlock);
         return retBlock;
@@ -200,36 +213,75 @@ void *MemoryPool::alloc(int num_blocks, owner_t owner)
             // If we found a valid region to allocate, allocate it
             if (allocSuccessful)
             {
-                owner_t updatedOwner = owner;
-
-                // Allocate the region
-                for (size_t curBlockIndex = freeBlockIndex; curBlockIndex < endBlockIndex; curBlockIndex++)
-                {
-                    // Get the current block from its index
-                    MemoryBlock *curBlock = block_from_index(curBlockIndex);
-                    // Unlink the current block from the free block chain
-                    MemoryBlock *newLink = curBlock->unlink();
-                    // Update the owner of the current block
-                    _blockTable[curBlockIndex] = updatedOwner;
-                    // Make every block besides the first one owned by a contiguous allocation,
-                    // since only the first block in a contiguous allocation has the actual owner
-                    updatedOwner = ALLOC_CONTIGUOUS;
-                    // If we allocated the first free block, find a new first free block
-                    if (curBlock == _firstFree)
-                        _firstFree = newLink;
-                }
-
                 // debug_printf("Allocated %08X\n", freeBlock);
-                return &freeBlock;
+                return claim(freeBlockIndex, num_blocks, owner);
             }
         }
     }
     return nullptr;
 }
 
+// Allocates the given number of blocks in the lowest addressed free region that ends before the given address
+// Used by the heap compactor to find a destination for an allocation that's being moved down
+void *MemoryPool::alloc_below(int num_blocks, owner_t owner, void *limit)
+{
+    std::lock_guard guard(mem_mutex);
+    size_t limitIndex = index_from_block(static_cast<MemoryBlock*>(limit));
+    size_t runLength = 0;
+    // Scan the ownership table from the bottom of the heap for a long enough run of free blocks
+    for (size_t curBlockIndex = 0; curBlockIndex < limitIndex; curBlockIndex++)
+    {
+        if (_blockTable[curBlockIndex] != ALLOC_FREE)
+        {
+            runLength = 0;
+        }
+        else if (++runLength == static_cast<size_t>(num_blocks))
+        {
+            return claim(curBlockIndex + 1 - num_blocks, num_blocks, owner);
+        }
+    }
+    return nullptr;
+}
+
+// Removes the given free blocks from the free chain and marks them as owned
+// Must be called with the memory mutex held
+void *MemoryPool::claim(size_t start_index, int num_blocks, owner_t owner)
+{
+    owner_t updatedOwner = owner;
+    size_t endBlockIndex = start_index + num_blocks;
+
+    // Allocate the region
+    for (size_t curBlockIndex = start_index; curBlockIndex < endBlockIndex; curBlockIndex++)
+    {
+        // Get the current block from its index
+        MemoryBlock *curBlock = block_from_index(curBlockIndex);
+        // Unlink the current block from the free block chain
+        MemoryBlock *newLink = curBlock->unlink();
+        // Update the owner of the current block
+        _blockTable[curBlockIndex] = updatedOwner;
+        // Make every block besides the first one owned by a contiguous allocation,
+        // since only the first block in a contiguous allocation has the actual owner
+        updatedOwner = ALLOC_CONTIGUOUS;
+        // If we allocated the first free block, find a new first free block
+        if (curBlock == _firstFree)
+            _firstFree = newLink;
+    }
+    _freeBlocks -= num_blocks;
+    _minFreeBlocks = std::min(_minFreeBlocks, _freeBlocks);
+
+    return block_from_index(start_index);
+}
+
 // Frees a previously allocated block(s)
 void MemoryPool::free(void *mem) noexcept
 {
+#ifdef DEBUG_MODE
+    // Freeing memory the pool doesn't own would corrupt the block table, so crash on it in debug builds
+    if (mem != nullptr && ((uintptr_t)mem < _blocksStart || (uintptr_t)mem >= _blocksStart + _totalBlocks * mem_block_size))
+    {
+        *(volatile int*)6 = 0;
+    }
+#endif
     std::lock_guard guard(mem_mutex);
     // debug_printf("Freeing alloc %08X\n", mem);
     // Cast the input memory address to a MemoryBlock
@@ -258,6 +310,7 @@ void MemoryPool::free(void *mem) noexcept
         _blockTable[toFreeIndex] = ALLOC_FREE;
         // Update the start of the free block list with the current block
         _firstFree = toFree;
+        _freeBlocks++;
         // Move on to the next block
         toFreeIndex++;
         // Get the next block to be freed
@@ -266,6 +319,12 @@ void MemoryPool::free(void *mem) noexcept
     } while (_blockTable[toFreeIndex] == ALLOC_CONTIGUOUS);
 }
 
+MemoryStats MemoryPool::stats()
+{
+    std::lock_guard guard(mem_mutex);
+    return MemoryStats{_totalBlocks, _freeBlocks, _minFreeBlocks};
+}
+
 // Global MemoryPool object
 MemoryPool g_memoryPool;
 
@@ -292,6 +351,98 @@ void freeAlloc(void *start) noexcept
     g_memoryPool.free(start);
 }
 
+MemoryStats getMemoryStats()
+{
+    return g_memoryPool.stats();
+}
+
+// Maximum number of relocatable allocations that can exist at once
+constexpr size_t max_relocatable_allocs = 128;
+
+// Handle table for relocatable allocations, skipfield so that handles stay at a fixed address
+// Only accessed from the game thread, so it isn't guarded by the memory mutex
+constinit skipfield<RelocatableAlloc, max_relocatable_allocs> relocatable_allocs{};
+
+reloc_handle_t allocRelocatable(int length, owner_t owner, relocate_callback_t on_relocate)
+{
+    if (relocatable_allocs.full())
+    {
+        return nullptr;
+    }
+    int num_blocks = (length + (mem_block_size - 1)) / mem_block_size;
+    void *ptr = g_memoryPool.alloc(num_blocks, owner);
+    if (ptr == nullptr)
+    {
+        return nullptr;
+    }
+    return &(*relocatable_allocs.emplace(ptr, on_relocate, static_cast<uint16_t>(num_blocks), static_cast<uint8_t>(0), owner));
+}
+
+void freeRelocatable(reloc_handle_t handle) noexcept
+{
+    g_memoryPool.free(handle->ptr);
+    relocatable_allocs.erase(handle);
+}
+
+int compactHeap(int max_blocks)
+{
+    int blocks_moved = 0;
+    // Allocations are visited from the top of the heap down, this is the address of the last one that was visited
+    uintptr_t search_limit = UINTPTR_MAX;
+
+    while (blocks_moved < max_blocks)
+    {
+        // Find the highest addressed unpinned allocation that hasn't been visited yet
+        RelocatableAlloc *to_move = nullptr;
+        for (auto& cur_alloc : relocatable_allocs)
+        {
+            uintptr_t cur_addr = reinterpret_cast<uintptr_t>(cur_alloc.ptr);
+            if (cur_alloc.pin_count == 0 && cur_addr < search_limit &&
+                (to_move == nullptr || cur_addr > reinterpret_cast<uintptr_t>(to_move->ptr)))
+            {
+                to_move = &cur_alloc;
+            }
+        }
+
+        // Stop if there's nothing left to move
+        if (to_move == nullptr)
+        {
+            break;
+        }
+
+        void *old_addr = to_move->ptr;
+        search_limit = reinterpret_cast<uintptr_t>(old_addr);
+
+        // Skip allocations too big for what's left of the budget, so that one large allocation can't stop everything
+        // below it from being compacted. The first allocation moved in a call can go over the budget, otherwise
+        // allocations larger than the whole budget (which fragment the heap the most) would never be moved.
+        if (blocks_moved != 0 && blocks_moved + to_move->num_blocks > max_blocks)
+        {
+            continue;
+        }
+
+        // Try to find a lower free region to move the allocation into, skipping it if there isn't one
+        void *new_addr = g_memoryPool.alloc_below(to_move->num_blocks, to_move->owner, old_addr);
+        if (new_addr == nullptr)
+        {
+            continue;
+        }
+
+        // The new region is always entirely below the old one, so they can't overlap
+        memcpy(new_addr, old_addr, to_move->num_blocks * mem_block_size);
+        to_move->ptr = new_addr;
+        if (to_move->on_relocate != nullptr)
+        {
+            to_move->on_relocate(new_addr, old_addr);
+        }
+        g_memoryPool.free(old_addr);
+
+        blocks_moved += to_move->num_blocks;
+    }
+
+    return blocks_moved;
+}
+
 void* operator new(size_t sz)
 {
     void *ret = allocRegion(sz, ALLOC_NEW);
@@ -228,6 +228,49 @@ void mtxfRotateVec(MtxF mat, Vec3 vecIn, Vec3 vecOut)
     *vec_out = glm::mat3(*mat_mat) * *vec_in;
 }
 
+// Extracts the planes of the frustum that a view projection matrix projects into clip space
+// The matrix is column major (clip = viewProj * pos), so viewProj[i][3] is the bottom row of the matrix
+void frustumFromViewProj(Frustum *out, MtxF viewProj)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        for (int coeff = 0; coeff < 4; coeff++)
+        {
+            // -w <= axis and axis <= w
+            out->planes[axis * 2 + 0][coeff] = viewProj[coeff][3] + viewProj[coeff][axis];
+            out->planes[axis * 2 + 1][coeff] = viewProj[coeff][3] - viewProj[coeff][axis];
+        }
+    }
+}
+
+// Tests an axis-aligned box against a frustum, only checking the corners of the box nearest to and furthest from each plane
+FrustumTest frustumTestAABB(const Frustum *frustum, const Vec3 min, const Vec3 max)
+{
+    FrustumTest ret = FrustumTest::inside;
+    for (const auto& plane : frustum->planes)
+    {
+        // The corner furthest along the plane's normal, if it's outside then the whole box is
+        float far_dist = plane[3] +
+            plane[0] * (plane[0] >= 0.0f ? max[0] : min[0]) +
+            plane[1] * (plane[1] >= 0.0f ? max[1] : min[1]) +
+            plane[2] * (plane[2] >= 0.0f ? max[2] : min[2]);
+        if (far_dist < 0.0f)
+        {
+            return FrustumTest::outside;
+        }
+        // The corner furthest against the plane's normal, if it's outside then the box crosses the plane
+        float near_dist = plane[3] +
+            plane[0] * (plane[0] >= 0.0f ? min[0] : max[0]) +
+            plane[1] * (plane[1] >= 0.0f ? min[1] : max[1]) +
+            plane[2] * (plane[2] >= 0.0f ? min[2] : max[2]);
+        if (near_dist < 0.0f)
+        {
+            ret = FrustumTest::intersecting;
+        }
+    }
+    return ret;
+}
+
 float approachFloatLinear(float current, float goal, float amount)
 {
     if (goal > current)
@@ -1,11 +1,13 @@
 #include <array>
 #include <bit>
 #include <cmath>
+#include <span>
 
 #include <ecs.h>
 #include <grid.h>
 #include <collision.h>
 #include <block_vector.h>
+#include <static_set.h>
 #include <n64_mathutils.h>
 
 extern "C" {
@@ -29,11 +31,6 @@ consteval unsigned int nearest_pow_2(unsigned int x)
     return 1 << width;
 }
 
-// Maximum number of chunks that can be loaded simultaneously in the x direction
-constexpr int max_chunks_x = round_away_divide(visible_inner_range_x * 2, static_cast<int>(tile_size * chunk_size)) + 1;
-// Maximum number of chunks that can be loaded simultaneously in the z direction
-constexpr int max_chunks_z = round_away_divide(visible_outer_range_pos_z + visible_outer_range_neg_z, static_cast<int>(tile_size * chunk_size)) + 1;
-
 // Maximum number of tiles that can be loaded simultaneously in the x direction
 constexpr int max_tiles_x = max_chunks_x * chunk_size;
 // Maximum number of tiles that can be loaded simultaneously in the z direction
@@ -92,18 +89,29 @@ void insert_hitbox_nodes(int min_x, int min_z, int max_x, int max_z, int start_t
         min_array_z = std::max(0, min_array_z);
         max_array_x = std::min(max_tiles_x - 1, max_array_x);
         max_array_z = std::min(max_tiles_z - 1, max_array_z);
+        // Number of nodes that still need to be allocated for this hitbox
+        size_t remaining = (max_array_x - min_array_x + 1) * (max_array_z - min_array_z + 1);
+        // Nodes allocated from the pool that haven't been written yet
+        std::span<HitboxNode> cur_nodes{};
+        auto node_iter = cur_nodes.end();
         // Iterate over the tile extents and insert a new node into each tile pointing to the current hitbox
         for (int x = min_array_x; x <= max_array_x; x++)
         {
             for (int z = min_array_z; z <= max_array_z; z++)
             {
                 // debug_printf("Inserting hitbox %08X in tile %d %d\n", cur_hitbox, x, z);
-                // Get the current start node for this tile
-                auto& cur_node = tile_hitboxes[x][z];
-                // Allocate a new node in the node pool pointing to the start node that was retrieved
-                auto it = node_pool.emplace_back(cur_node, cur_hitbox, cur_entity, cur_pos, cur_rot);
+                // Allocate as many of the remaining nodes as fit in the pool's current block at once
+                if (node_iter == cur_nodes.end())
+                {
+                    cur_nodes = node_pool.emplace_back_n(remaining);
+                    remaining -= cur_nodes.size();
+                    node_iter = cur_nodes.begin();
+                }
+                // Point the new node at the tile's current start node
+                HitboxNode& new_node = *node_iter++;
+                new_node = HitboxNode{tile_hitboxes[x][z], cur_hitbox, cur_entity, cur_pos, cur_rot};
                 // Replace the start node with the newly allocated one
-                tile_hitboxes[x][z] = &(*it);
+                tile_hitboxes[x][z] = &new_node;
             }
         }
     }
@@ -202,7 +210,7 @@ int g_x, g_z;
 void test_collider(
     Entity* entity, ColliderParams* collider, Vec3 pos,
     int min_array_x, int min_array_z, int max_array_x, int max_array_z,
-    skipfield<Entity*, max_hitbox_entities_checked>& checked_entities)
+    static_set<Entity*, max_hitbox_entities_checked>& checked_entities)
 {
     ColliderHit* cur_hit = nullptr;
     // debug_printf("Testing collider entity %08X at {%4.0f %4.0f %4.0f}\n", pos[0], pos[1], pos[2]);
@@ -223,11 +231,10 @@ void test_collider(
                 Vec3& hitbox_pos = *cur_node->pos;
                 Vec3s& hitbox_rot = *cur_node->rot;
                 // If this entity hasn't been checked yet, check it
-                if (std::find(checked_entities.begin(), checked_entities.end(), hitbox_entity) == checked_entities.end())
+                // Add the hitbox entity to the checked entities, which fails if it's already been checked
+                if (checked_entities.insert(hitbox_entity))
                 {
                     // debug_printf("checking %d %d\n", x, z);
-                    // Add the hitbox entity to the checked entities
-                    checked_entities.emplace(hitbox_entity);
 
                     // Check if the collider and hitbox intersect
                     // Start by checking if the masks match
@@ -299,9 +306,8 @@ void test_hitboxes(size_t count, void *arg, void **componentArrays)
     Entity **cur_entity = static_cast<Entity**>(componentArrays[0]);
     Vec3 *cur_pos = static_cast<Vec3*>(componentArrays[COMPONENT_INDEX(Position, ARCHETYPE_COLLIDER)]);
     ColliderParams *cur_collider = static_cast<ColliderParams*>(componentArrays[COMPONENT_INDEX(Collider, ARCHETYPE_COLLIDER)]);
-    // Skipfield for holding the entities that have been checked
-    // TODO replace this with a custom fixed-capacity stack-allocated vector type instead
-    skipfield<Entity*, max_hitbox_entities_checked> checked_entities{};
+    // Set of the entities that have been checked
+    static_set<Entity*, max_hitbox_entities_checked> checked_entities{};
     // Iterate over every entity
     while (count)
     {
@@ -357,11 +363,11 @@ void find_collisions(Grid& grid)
     int start_tile_z = min_chunk.second * chunk_size;
     // debug_printf("start_x %d start_z %d\n", start_tile_x, start_tile_z);
 
-    // Initialize the node and hit pools
-    // This will free the previous frame's pools' memory via move assignment
-    node_pool = {};
-    collider_hit_pool = {};
-    hitbox_hit_pool = {};
+    // Reset the node and hit pools
+    // The previous frame's blocks are kept, so the pools only allocate when they grow past their previous size
+    node_pool.clear_retain();
+    collider_hit_pool.clear_retain();
+    hitbox_hit_pool.clear_retain();
     GatherHitboxesParams params {
         start_tile_x,
         start_tile_z
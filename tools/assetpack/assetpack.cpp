@@ -1,12 +1,22 @@
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstdint>
 #include <cstdlib>
 #include <filesystem>
 #include <vector>
 #include <fstream>
+#include <set>
+#include <string>
+#include <thread>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
 
 #include <fmt/core.h>
 #include <fmt/os.h>
 
+#include "build_cache.h"
 #include "dynamic_array.h"
 
 namespace fs = std::filesystem;
@@ -18,7 +28,11 @@ struct size_offset_t
 };
 
 // Alignment in bytes of file offsets
-constexpr size_t file_alignment_bytes = 4;
+// 16 is the data cache line size that the game rounds its loads up to, and a multiple of the 8 byte alignment that DMA
+// destinations need, so any asset can be DMA'd straight into a cache-aligned buffer
+constexpr size_t file_alignment_bytes = 16;
+// Size of the pieces that files are read in while hashing, comparing and copying them
+constexpr size_t file_block_size = 64 * 1024;
 
 // Rounds the input up to the nearest N, where N is a power of 2
 template <size_t N, typename T>
@@ -28,65 +42,313 @@ constexpr T round_up(T in)
     return (in + N - 1) & -N;
 }
 
-size_t gather_files(const fs::path& dir, std::vector<fs::path>& files)
+void gather_files(const fs::path& dir, std::vector<fs::path>& files)
 {
-    size_t ret = 0;
     for (const auto& cur_entry : fs::directory_iterator(dir))
     {
         if (fs::is_directory(cur_entry))
         {
-            ret += gather_files(cur_entry, files);
+            gather_files(cur_entry, files);
         }
         else if (fs::is_regular_file(cur_entry))
         {
             if (cur_entry.path().filename().c_str()[0] != '.')
             {
                 files.emplace_back(std::move(cur_entry.path()));
-                ret += round_up<file_alignment_bytes>(fs::file_size(cur_entry));
             }
         }
     }
+}
+
+// Sorts the files so that the ones listed in the pack order file come first, in the order they're listed, followed by
+// the rest sorted by path
+// The order file lists asset paths relative to the asset folder, one per line, and is meant for grouping assets that
+// get loaded together (like the tile models every level loads at once) so that their loads are contiguous in rom
+bool sort_files(std::vector<fs::path>& files, const fs::path& asset_folder, const char* order_file_path)
+{
+    std::unordered_map<std::string, size_t> order;
+    if (order_file_path != nullptr)
+    {
+        std::ifstream order_file(order_file_path);
+        if (!order_file.is_open())
+        {
+            fmt::print(stderr, "Could not open pack order file {}\n", order_file_path);
+            return false;
+        }
+        std::string line;
+        while (std::getline(order_file, line))
+        {
+            if (!line.empty() && line[0] != '#')
+            {
+                order.emplace(line, order.size());
+            }
+        }
+    }
+
+    auto order_of = [&](const fs::path& file)
+    {
+        auto it = order.find(fs::relative(file, asset_folder).generic_string());
+        return it == order.end() ? order.size() : it->second;
+    };
+    std::sort(files.begin(), files.end(), [&](const fs::path& a, const fs::path& b)
+    {
+        return std::make_pair(order_of(a), a) < std::make_pair(order_of(b), b);
+    });
+    return true;
+}
+
+struct file_info_t
+{
+    size_t size;
+    uint64_t hash;
+};
+
+// Hashes a file's contents with 64-bit FNV-1a
+file_info_t hash_file(const fs::path& path)
+{
+    file_info_t ret{0, 0xCBF29CE484222325ull};
+    std::ifstream file(path, std::ios_base::binary);
+    std::vector<char> block(file_block_size);
+    while (file.read(block.data(), block.size()) || file.gcount() > 0)
+    {
+        size_t block_length = static_cast<size_t>(file.gcount());
+        for (size_t i = 0; i < block_length; i++)
+        {
+            ret.hash = (ret.hash ^ static_cast<uint8_t>(block[i])) * 0x100000001B3ull;
+        }
+        ret.size += block_length;
+    }
     return ret;
 }
 
-dynamic_array<size_offset_t> write_files(std::ofstream& output_file, std::vector<fs::path>& all_files, size_t total_size)
+// Hashes every file, spread over as many threads as there are cores
+dynamic_array<file_info_t> hash_files(const std::vector<fs::path>& all_files)
 {
-    dynamic_array<size_offset_t> file_offsets(all_files.size());
+    dynamic_array<file_info_t> file_infos(all_files.size());
+    std::atomic<size_t> next_file = 0;
+    auto hash_thread = [&]()
+    {
+        for (size_t file_idx = next_file++; file_idx < all_files.size(); file_idx = next_file++)
+        {
+            file_infos[file_idx] = hash_file(all_files[file_idx]);
+        }
+    };
 
-    dynamic_array<char> output_buf(total_size);
-    size_t cur_offset = 0;
+    unsigned int num_threads = std::clamp<unsigned int>(std::thread::hardware_concurrency(), 1, all_files.size() > 0 ? all_files.size() : 1);
+    std::vector<std::thread> threads;
+    for (unsigned int thread_idx = 1; thread_idx < num_threads; thread_idx++)
+    {
+        threads.emplace_back(hash_thread);
+    }
+    hash_thread();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return file_infos;
+}
+
+// Compares two files' contents, for confirming that files with the same hash really are identical
+bool files_equal(const fs::path& a, const fs::path& b)
+{
+    std::ifstream file_a(a, std::ios_base::binary);
+    std::ifstream file_b(b, std::ios_base::binary);
+    std::vector<char> block_a(file_block_size);
+    std::vector<char> block_b(file_block_size);
+    while (true)
+    {
+        file_a.read(block_a.data(), block_a.size());
+        file_b.read(block_b.data(), block_b.size());
+        if (file_a.gcount() != file_b.gcount())
+        {
+            return false;
+        }
+        if (file_a.gcount() == 0)
+        {
+            return true;
+        }
+        if (!std::equal(block_a.begin(), block_a.begin() + file_a.gcount(), block_b.begin()))
+        {
+            return false;
+        }
+    }
+}
 
+// Assigns each file an offset in the packed file, in order
+// Files with the same contents as an earlier file get that file's offset instead of a copy of their own, the returned
+// array has the index of the file whose data each file uses (its own index if it isn't a duplicate)
+dynamic_array<size_t> lay_out_files(const std::vector<fs::path>& all_files, const dynamic_array<file_info_t>& file_infos,
+    dynamic_array<size_offset_t>& file_offsets, size_t& total_size)
+{
+    dynamic_array<size_t> data_files(all_files.size());
+    std::unordered_multimap<uint64_t, size_t> files_by_hash;
+    size_t cur_offset = 0;
     for (size_t file_idx = 0; file_idx < all_files.size(); file_idx++)
     {
-        // Get the current file's path and size
-        const std::string& cur_file_path = all_files[file_idx];
-        size_t cur_file_size = fs::file_size(cur_file_path);
+        const file_info_t& info = file_infos[file_idx];
         // Record the file's size, rounded up to alignment
-        file_offsets[file_idx].size = round_up<file_alignment_bytes>(cur_file_size);
-        // Record the current output buffer position as the offset for the current file
-        file_offsets[file_idx].offset = cur_offset;
-        // Open the current file and read its contents into the buffer
+        file_offsets[file_idx].size = round_up<file_alignment_bytes>(info.size);
+        data_files[file_idx] = file_idx;
+
+        auto [same_hash, same_hash_end] = files_by_hash.equal_range(info.hash);
+        for (; same_hash != same_hash_end; ++same_hash)
+        {
+            size_t other_idx = same_hash->second;
+            if (file_infos[other_idx].size == info.size && files_equal(all_files[other_idx], all_files[file_idx]))
+            {
+                data_files[file_idx] = other_idx;
+                break;
+            }
+        }
+
+        if (data_files[file_idx] != file_idx)
+        {
+            file_offsets[file_idx].offset = file_offsets[data_files[file_idx]].offset;
+        }
+        else
+        {
+            files_by_hash.emplace(info.hash, file_idx);
+            file_offsets[file_idx].offset = cur_offset;
+            // Advance the output position by the file's size, rounded up to the file alignment
+            cur_offset = round_up<file_alignment_bytes>(cur_offset + info.size);
+        }
+    }
+    total_size = cur_offset;
+    return data_files;
+}
+
+// Copies every file that isn't a duplicate into the packed file a block at a time, padding each to the file alignment
+bool write_files(std::ofstream& output_file, const std::vector<fs::path>& all_files, const dynamic_array<size_t>& data_files,
+    const dynamic_array<size_offset_t>& file_offsets)
+{
+    std::vector<char> block(file_block_size);
+    const char padding[file_alignment_bytes]{};
+    size_t cur_offset = 0;
+    for (size_t file_idx = 0; file_idx < all_files.size(); file_idx++)
+    {
+        if (data_files[file_idx] != file_idx)
+        {
+            continue;
+        }
+        if (file_offsets[file_idx].offset != cur_offset)
+        {
+            fmt::print(stderr, "File {} ended up at the wrong offset\n", all_files[file_idx].c_str());
+            return false;
+        }
         std::ifstream cur_file(all_files[file_idx], std::ios_base::binary);
-        cur_file.read(output_buf.data() + cur_offset, cur_file_size);
-        // Advance the output buffer position by the file's size, rounded up to the file alignment
-        cur_offset = round_up<file_alignment_bytes>(cur_offset + cur_file_size);
+        while (cur_file.read(block.data(), block.size()) || cur_file.gcount() > 0)
+        {
+            output_file.write(block.data(), cur_file.gcount());
+            cur_offset += static_cast<size_t>(cur_file.gcount());
+        }
+        size_t padded_offset = round_up<file_alignment_bytes>(cur_offset);
+        output_file.write(padding, padded_offset - cur_offset);
+        cur_offset = padded_offset;
     }
+    return static_cast<bool>(output_file);
+}
 
-    output_file.write(output_buf.data(), output_buf.size());
-    return file_offsets;
+// Turns a path component into a C++ identifier by replacing anything that can't be in one with an underscore
+// Components that start with a digit (e.g. levels/1) get a leading underscore
+std::string asset_identifier(const std::string& name)
+{
+    std::string ret;
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0])))
+    {
+        ret += '_';
+    }
+    for (char c : name)
+    {
+        ret += std::isalnum(static_cast<unsigned char>(c)) ? c : '_';
+    }
+    return ret;
+}
+
+// Writes a header with a constexpr AssetRecord for every asset, in nested namespaces that follow the asset folder's
+// directories (e.g. models/metalGrate becomes assets::models::metalGrate), so the game can refer to assets without
+// looking their paths up at runtime and a missing asset is a compile error instead of a crash
+bool write_asset_ids(const char* header_path, const fs::path& asset_folder, const std::vector<fs::path>& all_files,
+    const dynamic_array<size_offset_t>& file_offsets)
+{
+    // Sort the assets by path so that each directory's assets are contiguous and only need one namespace block
+    std::vector<size_t> order(all_files.size());
+    for (size_t file_idx = 0; file_idx < order.size(); file_idx++)
+    {
+        order[file_idx] = file_idx;
+    }
+    std::vector<fs::path> relative_paths;
+    relative_paths.reserve(all_files.size());
+    for (const fs::path& file : all_files)
+    {
+        relative_paths.emplace_back(fs::relative(file, asset_folder));
+    }
+    std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return relative_paths[a] < relative_paths[b]; });
+
+    auto header = fmt::output_file(header_path);
+    header.print("// Generated by tools/assetpack, do not edit\n");
+    header.print("#ifndef __ASSET_IDS_H__\n#define __ASSET_IDS_H__\n\n#include <files.h>\n\nnamespace assets {{\n");
+
+    std::vector<std::string> open_namespaces;
+    std::set<std::string> written_names;
+    for (size_t file_idx : order)
+    {
+        const fs::path& relative_path = relative_paths[file_idx];
+        std::vector<std::string> namespaces;
+        for (const fs::path& component : relative_path.parent_path())
+        {
+            namespaces.emplace_back(asset_identifier(component.string()));
+        }
+        // Close the namespaces this asset isn't in and open the ones it is
+        size_t shared = 0;
+        while (shared < open_namespaces.size() && shared < namespaces.size() && open_namespaces[shared] == namespaces[shared])
+        {
+            shared++;
+        }
+        while (open_namespaces.size() > shared)
+        {
+            open_namespaces.pop_back();
+            header.print("{:{}}}}\n", "", open_namespaces.size() * 4);
+        }
+        while (open_namespaces.size() < namespaces.size())
+        {
+            header.print("{:{}}namespace {} {{\n", "", open_namespaces.size() * 4, namespaces[open_namespaces.size()]);
+            open_namespaces.push_back(namespaces[open_namespaces.size()]);
+        }
+
+        std::string name = asset_identifier(relative_path.filename().string());
+        std::string qualified_name = relative_path.parent_path().generic_string() + "/" + name;
+        if (!written_names.insert(qualified_name).second)
+        {
+            fmt::print(stderr, "Asset {} has the same identifier as another asset ({})\n", relative_path.c_str(), name);
+            return false;
+        }
+        header.print("{:{}}inline constexpr AssetRecord {}{{{}, {}}};\n", "", open_namespaces.size() * 4, name,
+            file_offsets[file_idx].offset, file_offsets[file_idx].size);
+    }
+    while (!open_namespaces.empty())
+    {
+        open_namespaces.pop_back();
+        header.print("{:{}}}}\n", "", open_namespaces.size() * 4);
+    }
+
+    header.print("}}\n\n#endif\n");
+    header.close();
+    return true;
 }
 
 int main(int argc, char *argv[])
 {
-    if (argc != 4)
+    if (argc != 5 && argc != 6)
     {
-        fmt::print("Usage: {} [asset folder] [packed asset file] [asset table]\n", argv[0]);
+        fmt::print("Usage: {} [asset folder] [packed asset file] [asset table] [asset id header] [pack order file (optional)]\n", argv[0]);
         return EXIT_SUCCESS;
     }
 
     fs::path asset_folder(argv[1]);
     char *packed_file_path = argv[2];
     char *asset_table_path = argv[3];
+    char *asset_id_header_path = argv[4];
+    char *order_file_path = argc > 5 ? argv[5] : nullptr;
 
     if (!fs::is_directory(asset_folder))
     {
@@ -95,12 +357,55 @@ int main(int argc, char *argv[])
     }
 
     std::vector<fs::path> all_files;
-    size_t total_size = gather_files(asset_folder, all_files);
+    gather_files(asset_folder, all_files);
+    if (!sort_files(all_files, asset_folder, order_file_path))
+    {
+        return EXIT_FAILURE;
+    }
+
+    dynamic_array<file_info_t> file_infos = hash_files(all_files);
+
+    // Everything assetpack writes follows from the files' paths, order and contents, which are already hashed
+    build_cache::BuildCache cache("assetpack", argv[0]);
+    build_cache::Key cache_key = cache.key();
+    for (size_t file_idx = 0; file_idx < all_files.size(); file_idx++)
+    {
+        cache_key.add_string(fs::relative(all_files[file_idx], asset_folder).generic_string());
+        cache_key.add_value(static_cast<uint64_t>(file_infos[file_idx].size));
+        cache_key.add_value(file_infos[file_idx].hash);
+    }
+    const fs::path cache_outputs[] = { packed_file_path, asset_table_path, asset_id_header_path };
+    if (cache.fetch(cache_key, cache_outputs))
+    {
+        fmt::print("Packed {} assets (unchanged, copied from the asset cache)\n", all_files.size());
+        return EXIT_SUCCESS;
+    }
+
+    dynamic_array<size_offset_t> file_offsets(all_files.size());
+    size_t total_size;
+    dynamic_array<size_t> data_files = lay_out_files(all_files, file_infos, file_offsets, total_size);
 
     std::ofstream packed_file(packed_file_path, std::ios_base::binary);
-    dynamic_array<size_offset_t> file_offsets = write_files(packed_file, all_files, total_size);
+    if (!write_files(packed_file, all_files, data_files, file_offsets))
+    {
+        fmt::print(stderr, "Could not write packed asset file {}\n", packed_file_path);
+        return EXIT_FAILURE;
+    }
     packed_file.close();
 
+    size_t num_duplicates = 0;
+    size_t duplicate_bytes = 0;
+    for (size_t file_idx = 0; file_idx < all_files.size(); file_idx++)
+    {
+        if (data_files[file_idx] != file_idx)
+        {
+            num_duplicates++;
+            duplicate_bytes += file_offsets[file_idx].size;
+        }
+    }
+    fmt::print("Packed {} assets into {} bytes, {} duplicates ({} bytes) share another asset's data\n",
+        all_files.size(), total_size, num_duplicates, duplicate_bytes);
+
     auto asset_table = fmt::output_file(asset_table_path);
     for (size_t file_idx = 0; file_idx < file_offsets.size(); file_idx++)
     {
@@ -111,5 +416,12 @@ int main(int argc, char *argv[])
     }
     asset_table.close();
 
+    if (!write_asset_ids(asset_id_header_path, asset_folder, all_files, file_offsets))
+    {
+        return EXIT_FAILURE;
+    }
+
+    cache.store(cache_key, cache_outputs);
+
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,612 @@
+// Host benchmark for the grid's floor and wall queries, see collision.py
+// Loads a level converted by levelconv and runs the same random queries through two versions of Grid::get_height and
+// Grid::get_wall_collisions: one that walks each column's tiles (the game's implementation before floors and walls
+// were baked by levelconv) and one that reads the baked floors and wall layers (the game's current implementation).
+// Both are copies of the game's code with the chunk lookup swapped out, so they need to be kept in step with
+// platforms/n64/src/gameplay/n64_grid.cpp. Every query's results are compared between the two.
+
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <compression.h>
+#include "../levelconv/levelconv.h"
+
+constexpr size_t tile_size = 256;
+
+using Vec3 = float[3];
+
+// Same as the game's round_down_divide, which is an arithmetic shift
+template <size_t D>
+constexpr int round_down_divide(int x)
+{
+    return x >> std::countr_zero(D);
+}
+
+// The game's versions of these use the FPU's rounding instructions, and lround rounds to nearest even
+inline int lround_even(float x) { return static_cast<int>(std::nearbyint(x)); }
+inline int lfloor(float x) { return static_cast<int>(std::floor(x)); }
+inline int lceil(float x) { return static_cast<int>(std::ceil(x)); }
+
+// A chunk decompressed from the level file, with its header and wall layers swapped to host endianness
+struct LoadedChunk {
+    OutputChunk header;
+    std::vector<uint8_t> data;
+
+    const OutputTile* tiles(int x, int z) const
+    {
+        return reinterpret_cast<const OutputTile*>(data.data() + header.columns[x][z].tiles_offset);
+    }
+    const OutputWallLayer* wall_layers() const
+    {
+        return reinterpret_cast<const OutputWallLayer*>(data.data() + header.wall_layers_offset);
+    }
+};
+
+struct Level {
+    int num_chunks_x;
+    int num_chunks_z;
+    std::vector<LoadedChunk> chunks;
+
+    // Stands in for the game's chunk table lookup, with every chunk of the level loaded
+    const LoadedChunk* find_chunk(int chunk_x, int chunk_z) const
+    {
+        if (chunk_x >= num_chunks_x || chunk_z >= num_chunks_z)
+        {
+            return nullptr;
+        }
+        return &chunks[chunk_x * num_chunks_z + chunk_z];
+    }
+};
+
+template <typename T>
+T read_swapped(const std::vector<uint8_t>& file, size_t offset)
+{
+    T value;
+    std::memcpy(&value, file.data() + offset, sizeof(T));
+    value.swap_endianness();
+    return value;
+}
+
+bool load_level(const char* path, Level& level)
+{
+    std::ifstream input(path, std::ios_base::binary);
+    if (!input.is_open())
+    {
+        std::printf("Could not open %s\n", path);
+        return false;
+    }
+    std::vector<uint8_t> file{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+
+    // Same layout as ChunkArrayElement in levelconv
+    struct ChunkArrayEntry {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t compressed_size;
+        void swap_endianness()
+        {
+            offset = ::swap_endianness(offset);
+            size = ::swap_endianness(size);
+            compressed_size = ::swap_endianness(compressed_size);
+        }
+    };
+
+    auto grid_def = read_swapped<OutputGridDefinition>(file, 0);
+    level.num_chunks_x = grid_def.num_chunks_x;
+    level.num_chunks_z = grid_def.num_chunks_z;
+    level.chunks.resize(level.num_chunks_x * level.num_chunks_z);
+    for (size_t chunk_index = 0; chunk_index < level.chunks.size(); chunk_index++)
+    {
+        auto entry = read_swapped<ChunkArrayEntry>(file, grid_def.chunk_array_rom_offset + chunk_index * sizeof(ChunkArrayEntry));
+        LoadedChunk& chunk = level.chunks[chunk_index];
+        chunk.data.resize(entry.size);
+        LzDecoder decoder(chunk.data.data(), chunk.data.size());
+        decoder.feed(file.data() + sizeof(OutputGridDefinition) + entry.offset, entry.compressed_size);
+        if (!decoder.finished())
+        {
+            std::printf("Chunk %zu didn't decompress to its full size\n", chunk_index);
+            return false;
+        }
+        chunk.header = read_swapped<OutputChunk>(chunk.data, 0);
+        OutputWallLayer* layers = reinterpret_cast<OutputWallLayer*>(chunk.data.data() + chunk.header.wall_layers_offset);
+        for (size_t layer = 0; layer < chunk.header.num_wall_layers; layer++)
+        {
+            for (auto& row : layers[layer])
+            {
+                row = ::swap_endianness(row);
+            }
+        }
+    }
+    return true;
+}
+
+// The game indexes its tile types with the tile id, empty tiles have no collision here
+TileCollision tile_collision(tile_id id)
+{
+    return id < tile_collisions.size() ? tile_collisions[id] : TileCollision::none;
+}
+
+int tile_surface_height(bool slope, int rotation, int tile_y, int local_x, int local_z, int radius_int)
+{
+    int tile_bottom = tile_y * static_cast<int>(tile_size);
+    if (!slope)
+    {
+        return tile_bottom;
+    }
+    int slope_y;
+    switch (rotation)
+    {
+        default:
+            slope_y = static_cast<int>(tile_size) + tile_bottom - local_z;
+            break;
+        case 1:
+            slope_y = tile_bottom + local_x;
+            break;
+        case 2:
+            slope_y = tile_bottom + local_z;
+            break;
+        case 3:
+            slope_y = static_cast<int>(tile_size) + tile_bottom - local_x;
+            break;
+    }
+    slope_y += radius_int;
+    if (slope_y > tile_bottom && slope_y < (tile_bottom + static_cast<int>(tile_size)))
+    {
+        return slope_y;
+    }
+    return tile_bottom;
+}
+
+int circle_aabb_intersect(float x, float z, float min_x, float max_x, float min_z, float max_z, float rad_sq, float* dist_out, Vec3 hit_out)
+{
+    float closest_x = std::max(min_x, std::min(x, max_x));
+    float closest_z = std::max(min_z, std::min(z, max_z));
+    float dx = closest_x - x;
+    float dz = closest_z - z;
+    float dist_sq = dx * dx + dz * dz;
+    if (dist_sq < rad_sq)
+    {
+        *dist_out = sqrtf(dist_sq);
+        hit_out[0] = closest_x;
+        hit_out[2] = closest_z;
+        return true;
+    }
+    return false;
+}
+
+// The tile and chunk bounds of a query, calculated the same way by both queries
+struct QueryBounds {
+    int min_pos_x, max_pos_x, min_pos_y, max_pos_y, min_pos_z, max_pos_z;
+    int min_chunk_x, max_chunk_x, min_chunk_z, max_chunk_z;
+
+    QueryBounds(float x, float z, float radius, float min_y, float max_y)
+    {
+        min_pos_y = round_down_divide<tile_size>(lfloor(min_y));
+        max_pos_y = round_down_divide<tile_size>(lceil(max_y));
+        min_pos_x = round_down_divide<tile_size>(lfloor(x - radius));
+        max_pos_x = round_down_divide<tile_size>(lceil(x + radius));
+        min_pos_z = round_down_divide<tile_size>(lfloor(z - radius));
+        max_pos_z = round_down_divide<tile_size>(lceil(z + radius));
+        min_chunk_x = round_down_divide<chunk_size>(min_pos_x);
+        max_chunk_x = round_down_divide<chunk_size>(max_pos_x);
+        min_chunk_z = round_down_divide<chunk_size>(min_pos_z);
+        max_chunk_z = round_down_divide<chunk_size>(max_pos_z);
+        // Convert the tile bounds to exclusive upper bounds
+        max_pos_x += 1;
+        max_pos_z += 1;
+    }
+
+    // Calls func(chunk, chunk tile x, chunk tile z, local min x, local max x, local min z, local max z) for each loaded
+    // chunk that the query overlaps
+    template <typename Func>
+    void for_each_chunk(const Level& level, Func&& func) const
+    {
+        for (int chunk_x = std::max(0, min_chunk_x); chunk_x <= max_chunk_x; chunk_x++)
+        {
+            for (int chunk_z = std::max(0, min_chunk_z); chunk_z <= max_chunk_z; chunk_z++)
+            {
+                const LoadedChunk* chunk = level.find_chunk(chunk_x, chunk_z);
+                if (chunk == nullptr)
+                {
+                    continue;
+                }
+                int cur_chunk_min_x = chunk_x * chunk_size;
+                int cur_chunk_min_z = chunk_z * chunk_size;
+                int local_min_x = std::max(cur_chunk_min_x, min_pos_x) - cur_chunk_min_x;
+                int local_max_x = std::min(cur_chunk_min_x + static_cast<int>(chunk_size), max_pos_x) - cur_chunk_min_x;
+                int local_min_z = std::max(cur_chunk_min_z, min_pos_z) - cur_chunk_min_z;
+                int local_max_z = std::min(cur_chunk_min_z + static_cast<int>(chunk_size), max_pos_z) - cur_chunk_min_z;
+                if (func(*chunk, cur_chunk_min_x, cur_chunk_min_z, local_min_x, local_max_x, local_min_z, local_max_z))
+                {
+                    return;
+                }
+            }
+        }
+    }
+};
+
+struct HeightResult {
+    float y;
+    int tile_x;
+    int tile_z;
+    tile_id id;
+    bool operator==(const HeightResult&) const = default;
+};
+
+// get_height as it was before the floors were baked, searching each column's tiles from the top of the query down
+HeightResult get_height_walk(const Level& level, float x, float z, float radius, float min_y, float max_y)
+{
+    int x_int = lround_even(x);
+    int z_int = lround_even(z);
+    HeightResult found{std::numeric_limits<int16_t>::min() * static_cast<float>(tile_size), 0, 0, 0};
+    QueryBounds bounds(x, z, radius, min_y, max_y);
+    if (bounds.min_pos_y > bounds.max_pos_y) return found;
+    int max_pos_y = bounds.max_pos_y + 1;
+
+    bounds.for_each_chunk(level, [&](const LoadedChunk& chunk, int chunk_min_x, int chunk_min_z, int local_min_x, int local_max_x, int local_min_z, int local_max_z)
+    {
+        for (int local_tile_x = local_min_x; local_tile_x < local_max_x; local_tile_x++)
+        {
+            for (int local_tile_z = local_min_z; local_tile_z < local_max_z; local_tile_z++)
+            {
+                const OutputChunkColumn& cur_column = chunk.header.columns[local_tile_x][local_tile_z];
+                const OutputTile* tiles = chunk.tiles(local_tile_x, local_tile_z);
+                int min_tile_index = std::max(0, bounds.min_pos_y - cur_column.base_height);
+                int num_tiles = std::min(cur_column.num_tiles - min_tile_index, max_pos_y + 1 - cur_column.base_height);
+                int local_x = x_int - (local_tile_x + chunk_min_x) * static_cast<int>(tile_size);
+                int local_z = z_int - (local_tile_z + chunk_min_z) * static_cast<int>(tile_size);
+
+                for (int tile_index = min_tile_index + num_tiles - 1; tile_index >= min_tile_index; tile_index--)
+                {
+                    TileCollision collision = tile_collision(tiles[tile_index].id);
+                    if (collision != TileCollision::floor && collision != TileCollision::slope)
+                    {
+                        continue;
+                    }
+                    float tile_y_world = static_cast<float>(tile_surface_height(collision == TileCollision::slope,
+                        tiles[tile_index].rotation, tile_index + cur_column.base_height, local_x, local_z, lround_even(radius)));
+                    if (tile_y_world > found.y && tile_y_world >= min_y && tile_y_world < max_y)
+                    {
+                        found = HeightResult{tile_y_world, local_tile_x + chunk_min_x, local_tile_z + chunk_min_z, tiles[tile_index].id};
+                        break;
+                    }
+                }
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+bool find_lower_floor(const LoadedChunk& chunk, int x, int z, int below_y, int local_x, int local_z, int radius_int, float min_y, float max_y, float* floor_y, tile_id* floor_id)
+{
+    const OutputChunkColumn& column = chunk.header.columns[x][z];
+    const OutputTile* tiles = chunk.tiles(x, z);
+    for (int tile_index = below_y - column.base_height - 1; tile_index >= 0; tile_index--)
+    {
+        tile_id cur_id = tiles[tile_index].id;
+        if (cur_id == empty_tile)
+        {
+            continue;
+        }
+        TileCollision collision = tile_collision(cur_id);
+        if (collision != TileCollision::floor && collision != TileCollision::slope)
+        {
+            continue;
+        }
+        float tile_y_world = static_cast<float>(tile_surface_height(collision == TileCollision::slope,
+            tiles[tile_index].rotation, tile_index + column.base_height, local_x, local_z, radius_int));
+        if (tile_y_world >= min_y && tile_y_world < max_y)
+        {
+            *floor_y = tile_y_world;
+            *floor_id = cur_id;
+            return true;
+        }
+    }
+    return false;
+}
+
+// get_height as it is now, reading each column's baked topmost floor
+HeightResult get_height_baked(const Level& level, float x, float z, float radius, float min_y, float max_y)
+{
+    int x_int = lround_even(x);
+    int z_int = lround_even(z);
+    int radius_int = lround_even(radius);
+    HeightResult found{std::numeric_limits<int16_t>::min() * static_cast<float>(tile_size), 0, 0, 0};
+    QueryBounds bounds(x, z, radius, min_y, max_y);
+    if (bounds.min_pos_y > bounds.max_pos_y) return found;
+
+    bounds.for_each_chunk(level, [&](const LoadedChunk& chunk, int chunk_min_x, int chunk_min_z, int local_min_x, int local_max_x, int local_min_z, int local_max_z)
+    {
+        for (int local_tile_x = local_min_x; local_tile_x < local_max_x; local_tile_x++)
+        {
+            for (int local_tile_z = local_min_z; local_tile_z < local_max_z; local_tile_z++)
+            {
+                const OutputChunkFloor& floor = chunk.header.floors[local_tile_x][local_tile_z];
+                if (!(floor.flags & chunk_floor_present) || floor.y < bounds.min_pos_y)
+                {
+                    continue;
+                }
+                int local_x = x_int - (local_tile_x + chunk_min_x) * static_cast<int>(tile_size);
+                int local_z = z_int - (local_tile_z + chunk_min_z) * static_cast<int>(tile_size);
+
+                float tile_y_world = found.y;
+                tile_id floor_id = floor.id;
+                bool in_query = false;
+                if (floor.y <= bounds.max_pos_y)
+                {
+                    tile_y_world = static_cast<float>(tile_surface_height(floor.flags & chunk_floor_slope,
+                        floor.flags & 0x3, floor.y, local_x, local_z, radius_int));
+                    in_query = tile_y_world >= min_y && tile_y_world < max_y;
+                }
+                if (!in_query && (floor.flags & chunk_floor_stacked))
+                {
+                    in_query = find_lower_floor(chunk, local_tile_x, local_tile_z, floor.y, local_x, local_z,
+                        radius_int, min_y, max_y, &tile_y_world, &floor_id);
+                }
+                if (in_query && tile_y_world > found.y)
+                {
+                    found = HeightResult{tile_y_world, local_tile_x + chunk_min_x, local_tile_z + chunk_min_z, floor_id};
+                }
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+// get_wall_collisions as it was before the walls were baked, searching each column's tiles for walls
+// The old version wrote each hit's height into the slot after the hit, this writes it to the hit so the two can be compared
+int get_wall_collisions_walk(const Level& level, Vec3 hits[4], float dists[4], float x, float z, float radius, float min_y, float max_y)
+{
+    int num_hits = 0;
+    float rad_sq = radius * radius;
+    QueryBounds bounds(x, z, radius, min_y, max_y);
+    if (bounds.min_pos_y > bounds.max_pos_y) return 0;
+    int max_pos_y = bounds.max_pos_y + 1;
+
+    bounds.for_each_chunk(level, [&](const LoadedChunk& chunk, int chunk_min_x, int chunk_min_z, int local_min_x, int local_max_x, int local_min_z, int local_max_z)
+    {
+        for (int local_tile_x = local_min_x; local_tile_x < local_max_x; local_tile_x++)
+        {
+            for (int local_tile_z = local_min_z; local_tile_z < local_max_z; local_tile_z++)
+            {
+                const OutputChunkColumn& cur_column = chunk.header.columns[local_tile_x][local_tile_z];
+                const OutputTile* tiles = chunk.tiles(local_tile_x, local_tile_z);
+                int min_tile_index = std::max(0, bounds.min_pos_y - cur_column.base_height);
+                int num_tiles = std::min(cur_column.num_tiles - min_tile_index, max_pos_y + 1 - cur_column.base_height);
+                int tile_x = (local_tile_x + chunk_min_x) * static_cast<int>(tile_size);
+                int tile_z = (local_tile_z + chunk_min_z) * static_cast<int>(tile_size);
+
+                for (int tile_index = min_tile_index + num_tiles - 1; tile_index >= min_tile_index; tile_index--)
+                {
+                    if (tile_collision(tiles[tile_index].id) != TileCollision::wall)
+                    {
+                        continue;
+                    }
+                    float tile_y_world = (tile_index + cur_column.base_height) * static_cast<int>(tile_size);
+                    if (tile_y_world >= min_y && tile_y_world < max_y &&
+                        circle_aabb_intersect(x, z, tile_x, tile_x + static_cast<int>(tile_size), tile_z, tile_z + static_cast<int>(tile_size),
+                            rad_sq, &dists[num_hits], hits[num_hits]))
+                    {
+                        hits[num_hits][1] = tile_y_world;
+                        num_hits++;
+                        if (num_hits >= 4)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    });
+    return num_hits;
+}
+
+// get_wall_collisions as it is now, reading the chunk's baked wall layers
+int get_wall_collisions_baked(const Level& level, Vec3 hits[4], float dists[4], float x, float z, float radius, float min_y, float max_y)
+{
+    int num_hits = 0;
+    float rad_sq = radius * radius;
+    QueryBounds bounds(x, z, radius, min_y, max_y);
+    if (bounds.min_pos_y > bounds.max_pos_y) return 0;
+    int max_pos_y = bounds.max_pos_y + 1;
+
+    bounds.for_each_chunk(level, [&](const LoadedChunk& chunk, int chunk_min_x, int chunk_min_z, int local_min_x, int local_max_x, int local_min_z, int local_max_z)
+    {
+        int min_layer = std::max(0, bounds.min_pos_y - chunk.header.wall_base_height);
+        int max_layer = std::min(static_cast<int>(chunk.header.num_wall_layers), max_pos_y - chunk.header.wall_base_height);
+        if (min_layer >= max_layer)
+        {
+            return false;
+        }
+        const OutputWallLayer* wall_layers = chunk.wall_layers();
+        uint16_t z_mask = ((1u << local_max_z) - 1) & ~((1u << local_min_z) - 1);
+
+        for (int local_tile_x = local_min_x; local_tile_x < local_max_x; local_tile_x++)
+        {
+            uint32_t wall_columns = 0;
+            for (int layer = min_layer; layer < max_layer; layer++)
+            {
+                wall_columns |= wall_layers[layer][local_tile_x];
+            }
+            wall_columns &= z_mask;
+
+            int tile_x = (local_tile_x + chunk_min_x) * static_cast<int>(tile_size);
+
+            while (wall_columns != 0)
+            {
+                int local_tile_z = std::countr_zero(wall_columns);
+                wall_columns &= wall_columns - 1;
+
+                int tile_z = (local_tile_z + chunk_min_z) * static_cast<int>(tile_size);
+
+                for (int layer = max_layer - 1; layer >= min_layer; layer--)
+                {
+                    if (!(wall_layers[layer][local_tile_x] & (1u << local_tile_z)))
+                    {
+                        continue;
+                    }
+                    float tile_y_world = (layer + chunk.header.wall_base_height) * static_cast<int>(tile_size);
+                    if (tile_y_world >= min_y && tile_y_world < max_y &&
+                        circle_aabb_intersect(x, z, tile_x, tile_x + static_cast<int>(tile_size), tile_z, tile_z + static_cast<int>(tile_size),
+                            rad_sq, &dists[num_hits], hits[num_hits]))
+                    {
+                        hits[num_hits][1] = tile_y_world;
+                        num_hits++;
+                        if (num_hits >= 4)
+                        {
+                            return true;
+                        }
+                    }
+                }
+            }
+        }
+        return false;
+    });
+    return num_hits;
+}
+
+struct Query {
+    float x, z, y, radius;
+};
+
+// Generates queries around the level's floors, at heights from a little below a floor to a couple of tiles above it
+std::vector<Query> make_queries(const Level& level, size_t count, float min_radius, float max_radius)
+{
+    struct FloorPos { int x, z, y; };
+    std::vector<FloorPos> floors;
+    for (int chunk_x = 0; chunk_x < level.num_chunks_x; chunk_x++)
+    {
+        for (int chunk_z = 0; chunk_z < level.num_chunks_z; chunk_z++)
+        {
+            const LoadedChunk& chunk = *level.find_chunk(chunk_x, chunk_z);
+            for (size_t x = 0; x < chunk_size; x++)
+            {
+                for (size_t z = 0; z < chunk_size; z++)
+                {
+                    const OutputChunkFloor& floor = chunk.header.floors[x][z];
+                    if (floor.flags & chunk_floor_present)
+                    {
+                        floors.push_back({static_cast<int>(chunk_x * chunk_size + x), static_cast<int>(chunk_z * chunk_size + z), floor.y});
+                    }
+                }
+            }
+        }
+    }
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> in_tile(0.0f, static_cast<float>(tile_size));
+    std::uniform_real_distribution<float> height(-0.5f * tile_size, 2.0f * tile_size);
+    std::uniform_real_distribution<float> radius(min_radius, max_radius);
+    std::vector<Query> queries;
+    queries.reserve(count);
+    for (size_t query_idx = 0; query_idx < count && !floors.empty(); query_idx++)
+    {
+        const FloorPos& floor = floors[rng() % floors.size()];
+        queries.push_back({floor.x * static_cast<float>(tile_size) + in_tile(rng), floor.z * static_cast<float>(tile_size) + in_tile(rng),
+            floor.y * static_cast<float>(tile_size) + height(rng), radius(rng)});
+    }
+    return queries;
+}
+
+// The same ranges as the game's collision code: a step up and down for floors and the collider's height for walls
+constexpr float step_down = 100.0f;
+constexpr float step_up = 100.0f;
+constexpr float collider_height = 200.0f;
+
+template <typename Func>
+double time_queries(const std::vector<Query>& queries, Func&& func)
+{
+    volatile float sink = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (const Query& query : queries)
+    {
+        sink = sink + func(query);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / queries.size();
+}
+
+bool run(const Level& level, size_t count, float min_radius, float max_radius)
+{
+    std::vector<Query> queries = make_queries(level, count, min_radius, max_radius);
+
+    for (const Query& query : queries)
+    {
+        HeightResult walk = get_height_walk(level, query.x, query.z, query.radius, query.y - step_down, query.y + step_up);
+        HeightResult baked = get_height_baked(level, query.x, query.z, query.radius, query.y - step_down, query.y + step_up);
+        if (!(walk == baked))
+        {
+            std::printf("Height mismatch at (%f, %f, %f) radius %f: %f vs %f\n", query.x, query.y, query.z, query.radius, walk.y, baked.y);
+            return false;
+        }
+        Vec3 walk_hits[4], baked_hits[4];
+        float walk_dists[4], baked_dists[4];
+        int num_walk = get_wall_collisions_walk(level, walk_hits, walk_dists, query.x, query.z, query.radius, query.y, query.y + collider_height);
+        int num_baked = get_wall_collisions_baked(level, baked_hits, baked_dists, query.x, query.z, query.radius, query.y, query.y + collider_height);
+        bool hits_match = num_walk == num_baked;
+        for (int hit = 0; hit < num_walk && hits_match; hit++)
+        {
+            hits_match = walk_dists[hit] == baked_dists[hit] && walk_hits[hit][0] == baked_hits[hit][0] &&
+                walk_hits[hit][1] == baked_hits[hit][1] && walk_hits[hit][2] == baked_hits[hit][2];
+        }
+        if (!hits_match)
+        {
+            std::printf("Wall mismatch at (%f, %f, %f) radius %f: %d vs %d hits\n", query.x, query.y, query.z, query.radius, num_walk, num_baked);
+            return false;
+        }
+    }
+
+    auto height_walk = [&](const Query& q) { return get_height_walk(level, q.x, q.z, q.radius, q.y - step_down, q.y + step_up).y; };
+    auto height_baked = [&](const Query& q) { return get_height_baked(level, q.x, q.z, q.radius, q.y - step_down, q.y + step_up).y; };
+    auto walls_walk = [&](const Query& q)
+    {
+        Vec3 hits[4];
+        float dists[4];
+        return static_cast<float>(get_wall_collisions_walk(level, hits, dists, q.x, q.z, q.radius, q.y, q.y + collider_height));
+    };
+    auto walls_baked = [&](const Query& q)
+    {
+        Vec3 hits[4];
+        float dists[4];
+        return static_cast<float>(get_wall_collisions_baked(level, hits, dists, q.x, q.z, q.radius, q.y, q.y + collider_height));
+    };
+    std::printf("  radius %3.0f-%3.0f: height %6.1f -> %6.1f ns, walls %6.1f -> %6.1f ns\n", min_radius, max_radius,
+        time_queries(queries, height_walk), time_queries(queries, height_baked),
+        time_queries(queries, walls_walk), time_queries(queries, walls_baked));
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::printf("Usage: %s [converted level]... \n", argv[0]);
+        return 0;
+    }
+    constexpr size_t num_queries = 200000;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        Level level;
+        if (!load_level(argv[arg], level))
+        {
+            return 1;
+        }
+        std::printf("%s: %d x %d chunks, %zu queries, column walk -> baked\n", argv[arg], level.num_chunks_x, level.num_chunks_z, num_queries);
+        if (!run(level, num_queries, 40.0f, 120.0f) || !run(level, num_queries, 200.0f, 500.0f))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,39 @@
+#!/usr/bin/env python3
+
+# Converts levels with levelconv, then builds and runs the floor and wall query benchmark (collision.cpp) on them
+# Usage: collision.py [levelconv binary] [levels (default assets/levels/1.level, 2.level and 3.level)]
+# Needs a host C++20 compiler, which can be overridden with the CXX environment variable
+
+import os
+import subprocess
+import sys
+import tempfile
+
+tools_dir = os.path.dirname(os.path.abspath(__file__))
+repo_dir = os.path.dirname(os.path.dirname(tools_dir))
+
+def main():
+    if len(sys.argv) < 2:
+        print("Usage: {} [levelconv binary] [levels (default assets/levels/1.level, 2.level and 3.level)]".format(sys.argv[0]))
+        return 0
+    levelconv = os.path.abspath(sys.argv[1])
+    levels = sys.argv[2:] or [os.path.join(repo_dir, "assets", "levels", "{}.level".format(level)) for level in (1, 2, 3)]
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        binary = os.path.join(temp_dir, "collision")
+        compiler = os.environ.get("CXX", "g++")
+        subprocess.run([compiler, "-std=c++20", "-O2", "-I", os.path.join(repo_dir, "include"),
+            os.path.join(tools_dir, "collision.cpp"), os.path.join(repo_dir, "src", "main", "compression.cpp"), "-o", binary], check=True)
+
+        # Make sure the levels actually get converted rather than copied out of the asset cache
+        env = dict(os.environ)
+        env.pop("ASSET_CACHE_DIR", None)
+        converted = []
+        for level in levels:
+            output = os.path.join(temp_dir, os.path.splitext(os.path.basename(level))[0])
+            subprocess.run([levelconv, level, output, temp_dir], env=env, check=True, stdout=subprocess.DEVNULL)
+            converted.append(output)
+        return subprocess.run([binary] + converted).returncode
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,140 @@
+// Host benchmark for skipfield, see skipfield.py
+// Checks a skipfield against a std::multiset under random insertions and erasures, then times the access pattern the
+// game puts skipfields through: a sparse field that's iterated every frame with an element or two coming and going
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <skipfield.h>
+
+// Runs random emplaces and erases (by iterator, by address and while iterating) on a field, comparing its contents
+// against a multiset after every step
+template <size_t Length>
+bool check(std::mt19937& rng)
+{
+    skipfield<int, Length> field;
+    std::multiset<int> expected;
+    for (int step = 0; step < 500; step++)
+    {
+        unsigned int action = rng() % 8;
+        if (action < 5 && !field.full())
+        {
+            int value = static_cast<int>(rng() % 1000);
+            auto it = field.emplace(value);
+            if (*it != value)
+            {
+                std::printf("emplace returned the wrong element\n");
+                return false;
+            }
+            expected.insert(value);
+        }
+        else if (action < 7 && !field.empty())
+        {
+            auto it = field.begin();
+            std::advance(it, rng() % field.size());
+            expected.erase(expected.find(*it));
+            if (action == 5)
+            {
+                field.erase(it);
+            }
+            else
+            {
+                field.erase(&*it);
+            }
+        }
+        else if (!field.empty())
+        {
+            int divisor = 2 + static_cast<int>(rng() % 4);
+            for (auto it = field.begin(); it != field.end();)
+            {
+                if (*it % divisor == 0)
+                {
+                    expected.erase(expected.find(*it));
+                    it = field.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
+            }
+        }
+        if (rng() % 200 == 0)
+        {
+            field.clear();
+            expected.clear();
+        }
+
+        std::multiset<int> contents(field.begin(), field.end());
+        if (field.size() != expected.size() || contents != expected)
+        {
+            std::printf("Mismatch at step %d: %zu elements, expected %zu\n", step, field.size(), expected.size());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Times a field with Length slots and live_count live elements that's iterated once per frame, with one element
+// erased at random and replaced every frame
+template <size_t Length>
+void time_churn(size_t live_count, int frames)
+{
+    skipfield<int, Length> field;
+    std::vector<int*> live;
+    std::mt19937 rng(2);
+    // Start with a fragmented field, like one that's been in use for a while
+    while (!field.full())
+    {
+        live.push_back(&*field.emplace(0));
+    }
+    while (live.size() > live_count)
+    {
+        size_t idx = rng() % live.size();
+        field.erase(live[idx]);
+        live[idx] = live.back();
+        live.pop_back();
+    }
+
+    volatile int64_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        int64_t frame_sum = 0;
+        for (int value : field)
+        {
+            frame_sum += value;
+        }
+        sum = sum + frame_sum;
+        size_t idx = rng() % live.size();
+        field.erase(live[idx]);
+        live[idx] = &*field.emplace(frame);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    std::printf("%3zu slots, %3zu live: %7.1f ns per frame\n", Length, live_count, ns / frames);
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    for (int round = 0; round < 2000; round++)
+    {
+        if (!check<16>(rng) || !check<64>(rng) || !check<254>(rng))
+        {
+            return 1;
+        }
+    }
+    std::printf("Checks passed\n");
+
+    constexpr int frames = 200000;
+    time_churn<128>(4, frames);
+    time_churn<128>(16, frames);
+    time_churn<128>(64, frames);
+    time_churn<128>(120, frames);
+    time_churn<254>(16, frames);
+    return 0;
+}
@@ -0,0 +1,40 @@
+#!/usr/bin/env python3
+
+# Builds and runs the skipfield benchmark (skipfield.cpp) against this tree's include/skipfield.h, and optionally
+# against include/skipfield.h from another git revision for comparison
+# Usage: skipfield.py [git revision to compare against]
+# Needs a host C++20 compiler, which can be overridden with the CXX environment variable
+
+import os
+import subprocess
+import sys
+import tempfile
+
+tools_dir = os.path.dirname(os.path.abspath(__file__))
+repo_dir = os.path.dirname(os.path.dirname(tools_dir))
+
+def build_and_run(name, include_dir, temp_dir):
+    binary = os.path.join(temp_dir, name)
+    compiler = os.environ.get("CXX", "g++")
+    subprocess.run([compiler, "-std=c++20", "-O2", "-I", include_dir, os.path.join(tools_dir, "skipfield.cpp"), "-o", binary], check=True)
+    print("{}:".format(name))
+    sys.stdout.flush()
+    return subprocess.run([binary]).returncode
+
+def main():
+    with tempfile.TemporaryDirectory() as temp_dir:
+        status = build_and_run("current", os.path.join(repo_dir, "include"), temp_dir)
+        if len(sys.argv) > 1:
+            revision = sys.argv[1]
+            # Only the one header is needed, since skipfield.h doesn't include anything else from the repo
+            old_include_dir = os.path.join(temp_dir, "old_include")
+            os.mkdir(old_include_dir)
+            with open(os.path.join(old_include_dir, "skipfield.h"), "wb") as header:
+                header.write(subprocess.run(["git", "-C", repo_dir, "show", revision + ":include/skipfield.h"],
+                    check=True, stdout=subprocess.PIPE).stdout)
+            print()
+            status = build_and_run(revision, old_include_dir, temp_dir) or status
+    return status
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,198 @@
+#ifndef __BUILD_CACHE_H__
+#define __BUILD_CACHE_H__
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <fmt/core.h>
+#include <fmt/os.h>
+
+// Content-addressed cache of asset tool outputs, shared between levelconv, soundconv and assetpack
+// Each entry holds the outputs of one conversion and is named after a hash of everything that went into it (the input
+// files' contents, any options, and the tool binary itself), so a conversion whose inputs haven't changed since any
+// earlier build (including one from before a clean or a branch switch) can copy its outputs out of the cache instead
+// of running again
+// The cache lives in the folder named by the ASSET_CACHE_DIR environment variable, and is disabled if that isn't set
+// Entries are laid out as [cache folder]/[tool]/[key]/, with the outputs numbered in the order they were stored and a
+// manifest.txt listing what they were
+
+namespace build_cache
+{
+
+namespace fs = std::filesystem;
+
+// Size of the pieces that files are read in while hashing or copying them
+constexpr size_t file_block_size = 64 * 1024;
+
+// Hash of a conversion's inputs, built up with 64-bit FNV-1a
+class Key
+{
+public:
+    void add_bytes(const void* data, size_t length)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < length; i++)
+        {
+            hash_ = (hash_ ^ bytes[i]) * 0x100000001B3ull;
+        }
+    }
+    template <typename T>
+    void add_value(const T& value)
+    {
+        add_bytes(&value, sizeof(value));
+    }
+    // Strings are length-prefixed so that consecutive strings can't run into each other
+    void add_string(std::string_view str)
+    {
+        add_value(static_cast<uint64_t>(str.size()));
+        add_bytes(str.data(), str.size());
+    }
+    // Adds a file's size and contents, returns false if it couldn't be read
+    bool add_file(const fs::path& path)
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        std::vector<char> block(file_block_size);
+        uint64_t size = 0;
+        while (file.read(block.data(), block.size()) || file.gcount() > 0)
+        {
+            add_bytes(block.data(), static_cast<size_t>(file.gcount()));
+            size += static_cast<uint64_t>(file.gcount());
+        }
+        add_value(size);
+        return true;
+    }
+    std::string hex() const
+    {
+        return fmt::format("{:016x}", hash_);
+    }
+private:
+    uint64_t hash_ = 0xCBF29CE484222325ull;
+};
+
+class BuildCache
+{
+public:
+    // The contents of the tool's binary are hashed into every key, so rebuilding the tool invalidates all of its entries
+    // argv[0] isn't always a path to the binary (it's just the command's name if the tool was found through PATH), so
+    // the binary is read through /proc/self/exe where that exists, and through tool_path (argv[0]) otherwise
+    BuildCache(std::string_view tool_name, const char* tool_path)
+    {
+        const char* cache_dir = std::getenv("ASSET_CACHE_DIR");
+        if (cache_dir == nullptr || cache_dir[0] == '\0')
+        {
+            return;
+        }
+        if (!tool_key_.add_file("/proc/self/exe") && !tool_key_.add_file(tool_path))
+        {
+            fmt::print(stderr, "Could not read {} to hash it, building without the asset cache\n", tool_path);
+            return;
+        }
+        tool_key_.add_string(tool_name);
+        dir_ = fs::path(cache_dir) / tool_name;
+        std::error_code err;
+        fs::create_directories(dir_, err);
+        if (err)
+        {
+            fmt::print(stderr, "Could not create asset cache folder {}: {}\n", dir_.string(), err.message());
+            dir_.clear();
+        }
+    }
+
+    bool enabled() const
+    {
+        return !dir_.empty();
+    }
+
+    // Returns a key with the tool already hashed in, for the caller to add the conversion's inputs to
+    Key key() const
+    {
+        return tool_key_;
+    }
+
+    // Copies the outputs stored for a key to the given paths, returns false if there's no entry for the key (or it
+    // holds a different number of outputs)
+    bool fetch(const Key& key, std::span<const fs::path> outputs) const
+    {
+        if (!enabled())
+        {
+            return false;
+        }
+        fs::path entry_dir = dir_ / key.hex();
+        std::error_code err;
+        if (!fs::is_directory(entry_dir, err) || count_entry_outputs(entry_dir) != outputs.size())
+        {
+            return false;
+        }
+        for (size_t output_idx = 0; output_idx < outputs.size(); output_idx++)
+        {
+            fs::copy_file(entry_dir / std::to_string(output_idx), outputs[output_idx], fs::copy_options::overwrite_existing, err);
+            if (err)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Stores copies of a conversion's outputs under its key
+    // Entries are written to a temporary folder and then renamed into place, so tools running in parallel never see a
+    // partially written entry
+    void store(const Key& key, std::span<const fs::path> outputs) const
+    {
+        if (!enabled())
+        {
+            return;
+        }
+        fs::path entry_dir = dir_ / key.hex();
+        fs::path temp_dir = dir_ / fmt::format("{}.tmp{:08x}", key.hex(), std::random_device{}());
+        std::error_code err;
+        if (fs::is_directory(entry_dir, err) || !fs::create_directory(temp_dir, err))
+        {
+            return;
+        }
+        auto manifest = fmt::output_file((temp_dir / "manifest.txt").string());
+        manifest.print("{}\n", key.hex());
+        for (size_t output_idx = 0; output_idx < outputs.size() && !err; output_idx++)
+        {
+            fs::copy_file(outputs[output_idx], temp_dir / std::to_string(output_idx), err);
+            manifest.print("{}, {}\n", output_idx, outputs[output_idx].filename().string());
+        }
+        manifest.close();
+        // Renaming fails if another tool stored the same entry in the meantime, which is fine since it's identical
+        if (err || (fs::rename(temp_dir, entry_dir, err), err))
+        {
+            fs::remove_all(temp_dir, err);
+        }
+    }
+
+private:
+    fs::path dir_;
+    Key tool_key_;
+
+    static size_t count_entry_outputs(const fs::path& entry_dir)
+    {
+        size_t count = 0;
+        std::error_code err;
+        while (fs::is_regular_file(entry_dir / std::to_string(count), err))
+        {
+            count++;
+        }
+        return count;
+    }
+};
+
+}
+
+#endif
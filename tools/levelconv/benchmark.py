@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+
+# Benchmarks levelconv on a synthetic level with one thread and with one per core, checks that both runs write the same
+# bytes and reports their wall times and peak memory use
+# Usage: benchmark.py [levelconv binary] [number of cells (default 1000000)] [number of threads (default: one per core)]
+# Linux only, since it relies on os.wait4 for the peak RSS
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+# Tile indices from the collision table in include/tile_collisions.h
+floor_tiles = [0, 1, 2, 3, 4, 5, 6, 25, 26, 28]
+slope_tiles = [8, 10, 11, 12]
+wall_tiles = [13, 16, 18, 19, 20, 21, 22, 23]
+
+def write_level(path, num_cells):
+    # Square map with an average of 2 cells per column: a floor or the odd slope, with walls stacked on some columns
+    size = max(int((num_cells / 2) ** 0.5), 1)
+    rng = random.Random(1234)
+    cells = []
+    layer = 0
+    while len(cells) < num_cells:
+        # Further passes over the map (if the random wall counts came up short) add floating layers above the last one
+        for x in range(size):
+            for z in range(size):
+                y = layer * 16 + rng.randrange(-4, 4)
+                cells.append((x, y, z, rng.choice(slope_tiles if rng.random() < 0.1 else floor_tiles)))
+                for wall_y in range(rng.randrange(1, 6) if rng.random() < 0.25 else 0):
+                    cells.append((x, y + 1 + wall_y, z, rng.choice(wall_tiles)))
+        layer += 1
+    del cells[num_cells:]
+    # Level editors don't write cells in any particular order
+    rng.shuffle(cells)
+
+    with open(path, "w") as level:
+        level.write('{\n  "MinX": 0,\n  "MinY": -8,\n  "MinZ": 0,\n')
+        level.write('  "MaxX": {},\n  "MaxY": {},\n  "MaxZ": {},\n'.format(size, layer * 16 + 8, size))
+        level.write('  "TilePaths": [],\n  "Cells": [\n')
+        level.write(",\n".join('    {{ "X": {}, "Y": {}, "Z": {}, "TileIndex": {}, "Rotation": {} }}'.format(
+            x, y, z, tile, rng.randrange(4)) for x, y, z, tile in cells))
+        level.write('\n  ],\n  "Objects": []\n}\n')
+
+def run_levelconv(levelconv, level_path, output_path, asset_dir, num_threads):
+    # Make sure the level actually gets converted rather than copied out of the asset cache
+    env = dict(os.environ)
+    env.pop("ASSET_CACHE_DIR", None)
+    env["LEVELCONV_THREADS"] = str(num_threads)
+    start = time.perf_counter()
+    process = subprocess.Popen([levelconv, level_path, output_path, asset_dir], env=env)
+    _, status, usage = os.wait4(process.pid, 0)
+    wall_time = time.perf_counter() - start
+    if status != 0:
+        print("levelconv failed with status {} on {} thread(s)".format(status, num_threads))
+        return None
+    # ru_maxrss is in kilobytes on Linux
+    print("{} thread(s): wall time {:.3f} s, peak RSS {:.1f} MiB".format(num_threads, wall_time, usage.ru_maxrss / 1024))
+    return wall_time
+
+def main():
+    if len(sys.argv) == 4 and sys.argv[1] == "--generate":
+        write_level(sys.argv[2], int(sys.argv[3]))
+        return 0
+    if len(sys.argv) < 2:
+        print("Usage: {} [levelconv binary] [number of cells (default 1000000)] [number of threads (default: one per core)]".format(sys.argv[0]))
+        return 0
+    levelconv = os.path.abspath(sys.argv[1])
+    num_cells = int(sys.argv[2]) if len(sys.argv) > 2 else 1000000
+    num_threads = int(sys.argv[3]) if len(sys.argv) > 3 else os.cpu_count()
+
+    with tempfile.TemporaryDirectory() as temp_dir:
+        level_path = os.path.join(temp_dir, "benchmark.level")
+        serial_output_path = os.path.join(temp_dir, "benchmark_serial")
+        parallel_output_path = os.path.join(temp_dir, "benchmark_parallel")
+        # Generate the level in another process so that this one stays small, since levelconv's peak RSS includes
+        # whatever it inherits from this process when it's forked
+        subprocess.run([sys.executable, __file__, "--generate", level_path, str(num_cells)], check=True)
+        print("Level: {} cells, {:.1f} MiB".format(num_cells, os.path.getsize(level_path) / (1024 * 1024)))
+
+        serial_time = run_levelconv(levelconv, level_path, serial_output_path, temp_dir, 1)
+        parallel_time = run_levelconv(levelconv, level_path, parallel_output_path, temp_dir, num_threads)
+        if serial_time is None or parallel_time is None:
+            return 1
+
+        with open(serial_output_path, "rb") as serial_output, open(parallel_output_path, "rb") as parallel_output:
+            if serial_output.read() != parallel_output.read():
+                print("Output differs between 1 and {} thread(s)".format(num_threads))
+                return 1
+        print("Output: {:.1f} KiB, identical on 1 and {} thread(s)".format(os.path.getsize(serial_output_path) / 1024, num_threads))
+        print("Speedup: {:.2f}x".format(serial_time / parallel_time))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,7 +1,15 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
+#include <limits>
+#include <optional>
 #include <vector>
 #include <fstream>
+#include <string>
+#include <thread>
 #include <tuple>
 #include <typeinfo>
 
@@ -9,6 +17,7 @@
 #define JSON_DIAGNOSTICS 1
 #include <nlohmann/json.hpp>
 
+#include "build_cache.h"
 #include "dynamic_array.h"
 #include "levelconv.h"
 
@@ -37,335 +46,893 @@ constexpr std::streampos round_up(std::streampos in)
     return (in + std::streamoff{N - 1}) & -N;
 }
 
+// A cell read from the level file, binned into the chunk it's in
 struct Cell
 {
-    // int x;
-    int y;
-    // int z;
-    int tile_id;
-    int rotation;
-};
-
-template <class T>
-inline void hash_combine(std::size_t& seed, const T& v)
-{
-    std::hash<T> hasher;
-    seed ^= hasher(v) + 0x9e3779b9 + (seed<<6) + (seed>>2);
-}
-
-struct pair_hash
-{
-    template <class T1, class T2>
-    std::size_t operator() (const std::pair<T1, T2> &pair) const {
-        size_t ret = std::hash<T1>()(pair.first);
-        hash_combine(ret, pair.second);
-        return ret;
-    }
+    // Position within the chunk
+    uint8_t x;
+    uint8_t z;
+    int16_t y;
+    uint8_t tile_id;
+    uint8_t rotation;
 };
 
 struct ChunkArrayElement
 {
     uint32_t offset;
     uint32_t size;
+    uint32_t compressed_size;
     void swap_endianness()
     {
         offset = ::swap_endianness(offset);
         size = ::swap_endianness(size);
+        compressed_size = ::swap_endianness(compressed_size);
     }
 };
 
-void write_grid(std::ofstream& output_file, dynamic_array_2d<Chunk>& chunks)
+// Compresses data into the LZ format that the game decompresses chunks from, see include/compression.h in the game
+// Control bytes 0x00-0x7F start a literal run of (control + 1) bytes, 0x80-0xFF start a back-reference of
+// ((control & 0x7F) + 3) bytes followed by a big-endian 16-bit (distance - 1)
+constexpr size_t lz_min_match = 3;
+constexpr size_t lz_max_match = 0x7F + lz_min_match;
+constexpr size_t lz_max_literals = 0x80;
+constexpr size_t lz_max_distance = 0x10000;
+// How many previous positions with the same hash get checked for each match, higher finds better matches but is slower
+constexpr size_t lz_max_chain = 256;
+
+std::vector<uint8_t> lz_compress(const std::vector<uint8_t>& input)
 {
-    size_t num_chunks_x = chunks.size().first;
-    size_t num_chunks_z = chunks.size().second;
-
-    // Create an array to hold the chunk offsets and sizes
-    dynamic_array<ChunkArrayElement> chunk_offset_array(num_chunks_x * num_chunks_z);
-    size_t chunk_offset_array_bytes = chunk_offset_array.size() * sizeof(ChunkArrayElement);
+    std::vector<uint8_t> output{};
+    output.reserve(input.size());
+
+    // Hash chains of previous positions, keyed by the 3 bytes starting at each position
+    constexpr size_t hash_bits = 12;
+    std::vector<int64_t> hash_heads(1 << hash_bits, -1);
+    std::vector<int64_t> hash_prev(input.size(), -1);
+    auto hash_at = [&](size_t pos)
+    {
+        uint32_t val = (input[pos] << 16) | (input[pos + 1] << 8) | input[pos + 2];
+        return (val * 2654435761u) >> (32 - hash_bits);
+    };
+    auto insert_hash = [&](size_t pos)
+    {
+        if (pos + lz_min_match <= input.size())
+        {
+            uint32_t hash = hash_at(pos);
+            hash_prev[pos] = hash_heads[hash];
+            hash_heads[hash] = pos;
+        }
+    };
 
-    uint32_t cur_offset = sizeof(OutputGridDefinition) + chunk_offset_array_bytes;
+    size_t literal_start = 0;
+    auto flush_literals = [&](size_t end)
+    {
+        while (literal_start < end)
+        {
+            size_t count = std::min(end - literal_start, lz_max_literals);
+            output.push_back(static_cast<uint8_t>(count - 1));
+            output.insert(output.end(), input.begin() + literal_start, input.begin() + literal_start + count);
+            literal_start += count;
+        }
+    };
 
-    // Write the grid definition
-    OutputGridDefinition grid_def{(uint16_t)num_chunks_x, (uint16_t)num_chunks_z, sizeof(OutputGridDefinition), 0, 0};
-    grid_def.swap_endianness();
-    output_file.write(reinterpret_cast<char*>(&grid_def), sizeof(OutputGridDefinition));
-
-    output_file.seekp(cur_offset);
-
-    // Create an array to hold the current chunk's tiles
-    std::vector<OutputTile> cur_chunk_tiles{};
-    // Reserve some space, assuming an average of 2 tiles per column
-    // Doesn't affect output, but helps reduce memory allocations during writing the output file
-    cur_chunk_tiles.reserve(2 * chunk_size * chunk_size);
-
-    int chunk_index = 0;
-    for (size_t chunk_x = 0; chunk_x < num_chunks_x; chunk_x++)
-    {
-        for (size_t chunk_z = 0; chunk_z < num_chunks_z; chunk_z++)
-        {
-            // Clear the current chunk tile vector
-            cur_chunk_tiles.clear();
-            // Write the current file offset as the current chunk's offset
-            chunk_offset_array[chunk_index].offset = cur_offset - sizeof(OutputGridDefinition);
-            // Get the input chunk and create the corresponding output chunk
-            Chunk &cur_chunk = chunks[{chunk_x, chunk_z}];
-            OutputChunk cur_output_chunk;
-            // Keep track of the current byte offset in the chunk, skipping the chunk's column offset array
-            uint32_t cur_chunk_offset = sizeof(OutputChunk);
-            
-            for (size_t sub_chunk_x = 0; sub_chunk_x < chunk_size; sub_chunk_x++)
+    size_t pos = 0;
+    while (pos < input.size())
+    {
+        // Find the longest match for the current position
+        size_t best_length = 0;
+        size_t best_distance = 0;
+        if (pos + lz_min_match <= input.size())
+        {
+            size_t max_length = std::min(lz_max_match, input.size() - pos);
+            int64_t candidate = hash_heads[hash_at(pos)];
+            for (size_t chain = 0; candidate != -1 && chain < lz_max_chain; chain++, candidate = hash_prev[candidate])
             {
-                for (size_t sub_chunk_z = 0; sub_chunk_z < chunk_size; sub_chunk_z++)
+                size_t distance = pos - candidate;
+                if (distance > lz_max_distance)
+                {
+                    break;
+                }
+                // Matches can run past the current position, which the decoder handles by copying a byte at a time
+                size_t length = 0;
+                while (length < max_length && input[candidate + length] == input[pos + length])
                 {
-                    auto& cur_column = cur_chunk.columns[sub_chunk_x][sub_chunk_z];
-                    auto& cur_output_column = cur_output_chunk.columns[sub_chunk_x][sub_chunk_z];
+                    length++;
+                }
+                if (length > best_length)
+                {
+                    best_length = length;
+                    best_distance = distance;
+                    if (length == max_length)
+                    {
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (best_length >= lz_min_match)
+        {
+            flush_literals(pos);
+            output.push_back(static_cast<uint8_t>(0x80 | (best_length - lz_min_match)));
+            output.push_back(static_cast<uint8_t>((best_distance - 1) >> 8));
+            output.push_back(static_cast<uint8_t>((best_distance - 1) & 0xFF));
+            for (size_t i = 0; i < best_length; i++)
+            {
+                insert_hash(pos + i);
+            }
+            pos += best_length;
+            literal_start = pos;
+        }
+        else
+        {
+            insert_hash(pos);
+            pos++;
+        }
+    }
+    flush_literals(pos);
+
+    return output;
+}
 
-                    // Copy the relevant data from the input chunk column to the output chunk column
-                    cur_output_column.base_height = cur_column.base_height;
-                    cur_output_column.num_tiles = cur_column.tiles.size();
+TileCollision get_tile_collision(tile_id id)
+{
+    return id < tile_collisions.size() ? tile_collisions[id] : TileCollision::none;
+}
 
-                    // Record the current chunk tile count as the column's offset
-                    cur_output_column.tiles_offset = cur_chunk_offset;
+// Bakes the chunk's collision data: the topmost floor of each column and the wall occupancy bitmap layers
+void bake_chunk_collision(const Chunk& chunk, OutputChunk& output_chunk, std::vector<OutputWallLayer>& wall_layers)
+{
+    int min_wall_y = std::numeric_limits<int>::max();
+    int max_wall_y = std::numeric_limits<int>::min();
 
-                    // Copy the current column into the chunk's tiles
-                    std::copy(cur_column.tiles.begin(), cur_column.tiles.end(), std::back_inserter(cur_chunk_tiles));
+    for (size_t x = 0; x < chunk_size; x++)
+    {
+        for (size_t z = 0; z < chunk_size; z++)
+        {
+            const ChunkColumn& column = chunk.columns[x][z];
+            OutputChunkFloor& floor = output_chunk.floors[x][z];
+            floor = OutputChunkFloor{0, 0, 0};
 
-                    // Move forward in the chunk's data by the column's tile byte count
-                    cur_chunk_offset += cur_column.tiles.size() * sizeof(decltype(cur_column.tiles)::value_type);
+            // Search the column from the top down, the first floor found is the topmost one
+            for (size_t tile_index = column.tiles.size(); tile_index-- > 0;)
+            {
+                const OutputTile& tile = column.tiles[tile_index];
+                int y = column.base_height + static_cast<int>(tile_index);
+                if (tile.id == empty_tile)
+                {
+                    continue;
+                }
+                switch (get_tile_collision(tile.id))
+                {
+                    case TileCollision::floor:
+                    case TileCollision::slope:
+                        if (floor.flags & chunk_floor_present)
+                        {
+                            floor.flags |= chunk_floor_stacked;
+                        }
+                        else
+                        {
+                            floor.y = static_cast<int16_t>(y);
+                            floor.id = tile.id;
+                            floor.flags = chunk_floor_present | (tile.rotation & 0x3);
+                            if (get_tile_collision(tile.id) == TileCollision::slope)
+                            {
+                                floor.flags |= chunk_floor_slope;
+                            }
+                        }
+                        break;
+                    case TileCollision::wall:
+                        min_wall_y = std::min(min_wall_y, y);
+                        max_wall_y = std::max(max_wall_y, y);
+                        break;
+                    case TileCollision::none:
+                        break;
                 }
             }
-            cur_output_chunk.swap_endianness();
-            // Write the chunk tile offset array and the chunk's tiles
-            output_file.write(reinterpret_cast<char*>(&cur_output_chunk), sizeof(cur_output_chunk));
-            output_file.write(reinterpret_cast<char*>(cur_chunk_tiles.data()), cur_chunk_tiles.size() * sizeof(decltype(cur_chunk_tiles)::value_type));
+        }
+    }
+
+    wall_layers.clear();
+    if (min_wall_y > max_wall_y)
+    {
+        output_chunk.wall_base_height = 0;
+        output_chunk.num_wall_layers = 0;
+        return;
+    }
 
-            // Get the new file offset after writing
-            uint32_t new_offset = output_file.tellp();
-            
-            // Calculate the chunk size from the two file offsets and correct the chunk's endianness
-            chunk_offset_array[chunk_index].size = new_offset - cur_offset;
-            chunk_offset_array[chunk_index].swap_endianness();
+    output_chunk.wall_base_height = static_cast<int16_t>(min_wall_y);
+    output_chunk.num_wall_layers = static_cast<uint16_t>(max_wall_y - min_wall_y + 1);
+    wall_layers.resize(output_chunk.num_wall_layers, OutputWallLayer{});
 
-            // Update the file offset and advance to the next chunk
-            cur_offset = new_offset;
-            chunk_index++;
+    for (size_t x = 0; x < chunk_size; x++)
+    {
+        for (size_t z = 0; z < chunk_size; z++)
+        {
+            const ChunkColumn& column = chunk.columns[x][z];
+            for (size_t tile_index = 0; tile_index < column.tiles.size(); tile_index++)
+            {
+                const OutputTile& tile = column.tiles[tile_index];
+                if (tile.id != empty_tile && get_tile_collision(tile.id) == TileCollision::wall)
+                {
+                    int y = column.base_height + static_cast<int>(tile_index);
+                    wall_layers[y - min_wall_y][x] |= 1 << z;
+                }
+            }
         }
     }
+}
 
-    std::streampos end_pos = output_file.tellp();
+// A run of stacked wall tiles in a single column with the same id and rotation
+struct WallRun {
+    uint8_t x;
+    uint8_t z;
+    int16_t y;
+    uint8_t height;
+    tile_id id;
+    uint8_t rotation;
+    bool merged;
+};
 
-    // Seek back to the start of the chunk offset array
-    output_file.seekp(sizeof(OutputGridDefinition));
-    output_file.write(reinterpret_cast<char*>(chunk_offset_array.data()), chunk_offset_array.size() * sizeof(decltype(chunk_offset_array)::value_type));
+// Bakes the chunk's LOD quads, must be called after the chunk's collision data is baked since it uses the columns' top floors
+void bake_chunk_lod(const Chunk& chunk, const OutputChunk& output_chunk, std::vector<OutputLodQuad>& lod_quads)
+{
+    lod_quads.clear();
 
-    output_file.seekp(end_pos);
+    // Merge the flat top floors of the columns into rectangles of the same tile id and height
+    auto is_flat_floor = [&](size_t x, size_t z)
+    {
+        const OutputChunkFloor& floor = output_chunk.floors[x][z];
+        return (floor.flags & chunk_floor_present) && !(floor.flags & chunk_floor_slope);
+    };
+    auto same_floor = [&](const OutputChunkFloor& a, size_t x, size_t z)
+    {
+        const OutputChunkFloor& b = output_chunk.floors[x][z];
+        return is_flat_floor(x, z) && a.id == b.id && a.y == b.y;
+    };
+    std::array<std::array<bool, chunk_size>, chunk_size> floor_merged{};
+    for (size_t x = 0; x < chunk_size; x++)
+    {
+        for (size_t z = 0; z < chunk_size; z++)
+        {
+            const OutputChunkFloor& floor = output_chunk.floors[x][z];
+            if (floor_merged[x][z] || !(floor.flags & chunk_floor_present))
+            {
+                continue;
+            }
+            if (floor.flags & chunk_floor_slope)
+            {
+                lod_quads.push_back(OutputLodQuad{floor.y, static_cast<uint8_t>(x), static_cast<uint8_t>(z), 1, 1, 1,
+                    floor.id, static_cast<uint8_t>(lod_quad_slope | (floor.flags & 0x3)), 0});
+                continue;
+            }
+            // Grow the rectangle along z as far as possible, then along x for as long as every tile in the row matches
+            size_t size_z = 1;
+            while (size_z < lod_max_quad_tiles && z + size_z < chunk_size && !floor_merged[x][z + size_z] && same_floor(floor, x, z + size_z))
+            {
+                size_z++;
+            }
+            size_t size_x = 1;
+            while (size_x < lod_max_quad_tiles && x + size_x < chunk_size)
+            {
+                bool row_matches = true;
+                for (size_t row_z = z; row_z < z + size_z; row_z++)
+                {
+                    if (floor_merged[x + size_x][row_z] || !same_floor(floor, x + size_x, row_z))
+                    {
+                        row_matches = false;
+                        break;
+                    }
+                }
+                if (!row_matches)
+                {
+                    break;
+                }
+                size_x++;
+            }
+            for (size_t merged_x = x; merged_x < x + size_x; merged_x++)
+            {
+                for (size_t merged_z = z; merged_z < z + size_z; merged_z++)
+                {
+                    floor_merged[merged_x][merged_z] = true;
+                }
+            }
+            lod_quads.push_back(OutputLodQuad{floor.y, static_cast<uint8_t>(x), static_cast<uint8_t>(z),
+                static_cast<uint8_t>(size_x), static_cast<uint8_t>(size_z), 1, floor.id, lod_quad_floor, 0});
+        }
+    }
+
+    // Gather the runs of stacked walls in each column
+    std::vector<WallRun> wall_runs{};
+    for (size_t x = 0; x < chunk_size; x++)
+    {
+        for (size_t z = 0; z < chunk_size; z++)
+        {
+            const ChunkColumn& column = chunk.columns[x][z];
+            for (size_t tile_index = 0; tile_index < column.tiles.size(); tile_index++)
+            {
+                const OutputTile& tile = column.tiles[tile_index];
+                if (tile.id == empty_tile || get_tile_collision(tile.id) != TileCollision::wall)
+                {
+                    continue;
+                }
+                int y = column.base_height + static_cast<int>(tile_index);
+                WallRun* prev = wall_runs.empty() ? nullptr : &wall_runs.back();
+                if (prev != nullptr && prev->x == x && prev->z == z && prev->id == tile.id && prev->rotation == (tile.rotation & 0x3) &&
+                    prev->y + prev->height == y && prev->height < lod_max_quad_tiles)
+                {
+                    prev->height++;
+                }
+                else
+                {
+                    wall_runs.push_back(WallRun{static_cast<uint8_t>(x), static_cast<uint8_t>(z), static_cast<int16_t>(y), 1,
+                        tile.id, static_cast<uint8_t>(tile.rotation & 0x3), false});
+                }
+            }
+        }
+    }
+
+    // Merge matching runs sideways along the tile edge that the walls sit on
+    // Walls with rotations 0 and 2 sit on an edge facing z so they run along x, 1 and 3 run along z
+    for (auto& run : wall_runs)
+    {
+        if (run.merged)
+        {
+            continue;
+        }
+        bool along_x = (run.rotation & 1) == 0;
+        size_t length = 1;
+        while (length < lod_max_quad_tiles)
+        {
+            size_t next_x = run.x + (along_x ? length : 0);
+            size_t next_z = run.z + (along_x ? 0 : length);
+            auto next = std::find_if(wall_runs.begin(), wall_runs.end(), [&](const WallRun& other)
+            {
+                return !other.merged && other.x == next_x && other.z == next_z && other.y == run.y &&
+                    other.height == run.height && other.id == run.id && other.rotation == run.rotation;
+            });
+            if (next == wall_runs.end())
+            {
+                break;
+            }
+            next->merged = true;
+            length++;
+        }
+        run.merged = true;
+        lod_quads.push_back(OutputLodQuad{run.y, run.x, run.z,
+            static_cast<uint8_t>(along_x ? length : 1), static_cast<uint8_t>(along_x ? 1 : length), run.height,
+            run.id, static_cast<uint8_t>(lod_quad_wall | run.rotation), 0});
+    }
+
+    // Group the quads by tile id so each tile id is drawn with a single material switch
+    std::stable_sort(lod_quads.begin(), lod_quads.end(), [](const OutputLodQuad& a, const OutputLodQuad& b) { return a.id < b.id; });
 }
 
-int main(int argc, char *argv[])
+// Reads a level file as it's parsed instead of building the whole json document first, binning each cell straight into
+// the list of cells of the chunk it's in, so converting a level only ever needs memory for its cells and not for a
+// json value and map entry per cell
+class LevelReader : public js::json_sax<js::json>
 {
-    if (argc != 4)
+public:
+    // Values of the level's top-level fields
+    std::optional<int> min_x, min_z, max_x, max_z;
+    std::vector<std::string> tile_paths;
+    std::vector<OutputObject> objects;
+
+    // Bins any cells that came before the level's bounds in the file and converts the objects' positions, must be
+    // called once parsing has finished
+    // Returns false if anything was missing from the level, with the reason in error()
+    bool finish()
     {
-        fmt::print("Usage: {} [input level file] [output level binary] [asset folder]\n", argv[0]);
-        return EXIT_SUCCESS;
+        if (!has_bounds())
+        {
+            error_ = "level is missing one of MinX, MinZ, MaxX or MaxZ";
+            return false;
+        }
+        allocate_chunks();
+        for (const InputCell& cell : unbinned_cells_)
+        {
+            bin_cell(cell);
+        }
+        unbinned_cells_ = std::vector<InputCell>{};
+        for (OutputObject& obj : objects)
+        {
+            obj.x = static_cast<uint16_t>(obj.x - *min_x);
+            obj.z = static_cast<uint16_t>(obj.z - *min_z);
+            obj.swap_endianness();
+        }
+        return true;
     }
 
-    fs::path asset_folder(argv[3]);
-    char *input_path = argv[1];
-    char *output_path = argv[2];
+    dynamic_array_2d<std::vector<Cell>>& chunk_cells() { return chunk_cells_; }
+    size_t num_cells() const { return num_cells_; }
+    const std::string& error() const { return error_; }
 
-    if (!fs::is_directory(asset_folder))
+    bool null() override { return true; }
+    bool boolean(bool) override { return true; }
+    bool number_integer(number_integer_t val) override { return number(static_cast<int>(val)); }
+    bool number_unsigned(number_unsigned_t val) override { return number(static_cast<int>(val)); }
+    bool number_float(number_float_t val, const string_t&) override { return number(static_cast<int>(val)); }
+    bool string(string_t& val) override
     {
-        fmt::print(stderr, "Provided asset folder ({}) is not a valid directory\n", asset_folder.c_str());
-        return EXIT_FAILURE;
+        if (keys_.size() == 1 && keys_[0] == "TilePaths")
+        {
+            tile_paths.emplace_back(std::move(val));
+        }
+        return true;
     }
-
-    if (!fs::is_regular_file(input_path))
+    bool binary(binary_t&) override { return true; }
+    bool start_object(std::size_t) override
     {
-        fmt::print(stderr, "Input file {} does not exist or cannot be opened\n", input_path);
-        return EXIT_FAILURE;
+        keys_.emplace_back();
+        fields_seen_ = keys_.size() == 2 ? 0 : fields_seen_;
+        return true;
+    }
+    bool key(string_t& val) override
+    {
+        keys_.back() = std::move(val);
+        return true;
+    }
+    bool end_object() override
+    {
+        if (keys_.size() == 2 && keys_[0] == "Cells")
+        {
+            if (fields_seen_ != all_cell_fields)
+            {
+                error_ = fmt::format("cell {} is missing one of X, Y, Z, TileIndex or Rotation", num_cells_);
+                return false;
+            }
+            num_cells_++;
+            bin_cell(cur_cell_);
+        }
+        else if (keys_.size() == 2 && keys_[0] == "Objects")
+        {
+            if (fields_seen_ != all_object_fields)
+            {
+                error_ = fmt::format("object {} is missing one of X, Y, Z, ObjectParam, ObjectClass, ObjectType or ObjectSubtype", objects.size());
+                return false;
+            }
+            objects.push_back(cur_object_);
+        }
+        keys_.pop_back();
+        return true;
+    }
+    bool start_array(std::size_t) override { return true; }
+    bool end_array() override { return true; }
+    bool parse_error(std::size_t, const std::string&, const js::detail::exception& err) override
+    {
+        error_ = err.what();
+        return false;
     }
 
-    js::json input_json;
-    try
+private:
+    // A cell's position in the level file, kept until the cell can be binned if it comes before the level's bounds
+    struct InputCell
+    {
+        int x;
+        int y;
+        int z;
+        int tile_index;
+        int rotation;
+    };
+
+    static constexpr uint8_t all_cell_fields = 0x1F;
+    static constexpr uint8_t all_object_fields = 0x7F;
+
+    // The key of the current field in each of the objects being read, outermost first
+    std::vector<std::string> keys_;
+    // Bitmask of the fields read so far in the current cell or object
+    uint8_t fields_seen_ = 0;
+    InputCell cur_cell_{};
+    OutputObject cur_object_{};
+    dynamic_array_2d<std::vector<Cell>> chunk_cells_{0, 0};
+    bool chunks_allocated_ = false;
+    std::vector<InputCell> unbinned_cells_;
+    size_t num_chunks_x_ = 0;
+    size_t num_chunks_z_ = 0;
+    size_t num_cells_ = 0;
+    std::string error_;
+
+    bool has_bounds() const
     {
-        std::ifstream input_file(input_path);
-        input_file >> input_json;
+        return min_x && min_z && max_x && max_z;
     }
-    catch (js::json::exception& err)
+
+    void allocate_chunks()
     {
-        fmt::print("Error parsing json: {}\n", err.what());
-        return EXIT_FAILURE;
+        if (!chunks_allocated_)
+        {
+            chunks_allocated_ = true;
+            size_t num_cells_x = *max_x - *min_x;
+            size_t num_cells_z = *max_z - *min_z;
+            num_chunks_x_ = round_away_divide(num_cells_x, chunk_size);
+            num_chunks_z_ = round_away_divide(num_cells_z, chunk_size);
+            chunk_cells_ = dynamic_array_2d<std::vector<Cell>>(num_chunks_x_, num_chunks_z_);
+        }
     }
 
+    void bin_cell(const InputCell& cell)
+    {
+        if (!chunks_allocated_)
+        {
+            unbinned_cells_.push_back(cell);
+            return;
+        }
+        // Cells outside of the level's chunks are dropped
+        size_t x = static_cast<unsigned int>(cell.x - *min_x);
+        size_t z = static_cast<unsigned int>(cell.z - *min_z);
+        if (x >= num_chunks_x_ * chunk_size || z >= num_chunks_z_ * chunk_size)
+        {
+            return;
+        }
+        chunk_cells_[{x / chunk_size, z / chunk_size}].push_back(Cell{static_cast<uint8_t>(x % chunk_size), static_cast<uint8_t>(z % chunk_size),
+            static_cast<int16_t>(cell.y), static_cast<uint8_t>(cell.tile_index), static_cast<uint8_t>(cell.rotation)});
+    }
 
-    try
+    bool number(int val)
     {
-        fs::path assets_absolute = fs::canonical(asset_folder);
-        fs::path input_dir = fs::path(input_path).parent_path() / fs::path{"./"};
-        int min_x = input_json["MinX"];
-        // int min_y = input_json["MinY"];
-        int min_z = input_json["MinZ"];
-        int max_x = input_json["MaxX"];
-        // int max_y = input_json["MaxY"];
-        int max_z = input_json["MaxZ"];
-        std::vector<std::string> tile_paths;
+        if (keys_.size() == 1)
+        {
+            const std::string& key = keys_[0];
+            std::optional<int>* bound = key == "MinX" ? &min_x : key == "MinZ" ? &min_z : key == "MaxX" ? &max_x : key == "MaxZ" ? &max_z : nullptr;
+            if (bound != nullptr)
+            {
+                *bound = val;
+                // Cells can be binned as they're read once all of the bounds are known
+                if (has_bounds())
+                {
+                    allocate_chunks();
+                }
+            }
+        }
+        else if (keys_.size() == 2 && keys_[0] == "Cells")
+        {
+            set_field(keys_[1], "X", 0, cur_cell_.x, val) || set_field(keys_[1], "Y", 1, cur_cell_.y, val) ||
+            set_field(keys_[1], "Z", 2, cur_cell_.z, val) || set_field(keys_[1], "TileIndex", 3, cur_cell_.tile_index, val) ||
+            set_field(keys_[1], "Rotation", 4, cur_cell_.rotation, val);
+        }
+        else if (keys_.size() == 2 && keys_[0] == "Objects")
+        {
+            set_field(keys_[1], "X", 0, cur_object_.x, val) || set_field(keys_[1], "Y", 1, cur_object_.y, val) ||
+            set_field(keys_[1], "Z", 2, cur_object_.z, val) || set_field(keys_[1], "ObjectParam", 3, cur_object_.object_param, val);
+        }
+        else if (keys_.size() == 3 && keys_[0] == "Objects" && keys_[1] == "Definition")
+        {
+            set_field(keys_[2], "ObjectClass", 4, cur_object_.object_class, val) || set_field(keys_[2], "ObjectType", 5, cur_object_.object_type, val) ||
+            set_field(keys_[2], "ObjectSubtype", 6, cur_object_.object_subtype, val);
+        }
+        return true;
+    }
 
-        // Read tile model paths
-        for (auto& entry : input_json["TilePaths"])
+    template <typename T>
+    bool set_field(const std::string& key, const char* name, int field, T& dest, int val)
+    {
+        if (key != name)
         {
-            auto tile_path = entry.get<std::string>();
-            auto real_tile_path = fs::relative(input_dir / tile_path, assets_absolute).replace_extension();
-            tile_paths.emplace_back(real_tile_path.string());
+            return false;
         }
+        dest = static_cast<T>(val);
+        fields_seen_ |= 1 << field;
+        return true;
+    }
+};
 
-        using column_pos = std::pair<unsigned int, unsigned int>;
-        std::unordered_map<column_pos, std::vector<Cell>, pair_hash> columns{};
+// Builds a chunk's columns from the cells binned into it, sorting the cells in place by column and then height
+void build_chunk(std::vector<Cell>& cells, Chunk& chunk)
+{
+    for (auto& z_array : chunk.columns)
+    {
+        for (auto& column : z_array)
+        {
+            column.tiles = dynamic_array<OutputTile>();
+            column.base_height = 0;
+        }
+    }
 
-        // Read the cell data into column vectors
-        for (auto& cell : input_json["Cells"])
+    std::sort(cells.begin(), cells.end(),
+        [](const Cell& a, const Cell& b)
         {
-            int x = cell["X"];
-            x -= min_x;
-            int y = cell["Y"];
-            int z = cell["Z"];
-            z -= min_z;
-            int tile_index = cell["TileIndex"];
-            int rotation = cell["Rotation"];
-            auto column_vec = columns.find({x, z});
-            if (column_vec == columns.end())
+            return std::tie(a.x, a.z, a.y) < std::tie(b.x, b.z, b.y);
+        }
+    );
+
+    // Each column's cells are now a contiguous run from its lowest cell to its highest
+    for (auto column_start = cells.begin(); column_start != cells.end();)
+    {
+        auto column_end = std::find_if(column_start, cells.end(),
+            [&](const Cell& cell)
             {
-                column_vec = columns.emplace(std::make_pair(column_pos{x,z}, std::vector<Cell>{})).first;
+                return cell.x != column_start->x || cell.z != column_start->z;
             }
-            column_vec->second.push_back(Cell{/*x,*/ y, /*z,*/ tile_index, rotation});
+        );
+        int column_min_y = column_start->y;
+        int column_max_y = (column_end - 1)->y;
+        size_t height = 1 + column_max_y - column_min_y;
+        // Any heights between the column's cells are filled with empty tiles
+        dynamic_array<OutputTile> output_column(height, OutputTile{empty_tile, 0});
+        for (auto cell = column_start; cell != column_end; ++cell)
+        {
+            output_column[cell->y - column_min_y] = OutputTile{cell->tile_id, cell->rotation};
         }
-        // int sum = std::accumulate(columns.begin(), columns.end(), 0, 
-        //     [](auto a, decltype(columns)::value_type& b)
-        //     {
-        //         return a + b.second.size();
-        //     }
-        // );
-        size_t num_cells_x = max_x - min_x;
-        size_t num_cells__z = max_z - min_z;
-        size_t num_chunks_x = round_away_divide(num_cells_x, chunk_size);
-        size_t num_chunks_z = round_away_divide(num_cells__z, chunk_size);
+        ChunkColumn& column = chunk.columns[column_start->x][column_start->z];
+        column.tiles = std::move(output_column);
+        column.base_height = column_min_y;
+        column_start = column_end;
+    }
+}
 
-        dynamic_array_2d<Chunk> chunks(num_chunks_x, num_chunks_z);
+// A chunk's compressed data and its size before compression
+struct EncodedChunk
+{
+    std::vector<uint8_t> data;
+    uint32_t size;
+};
 
-        for (size_t chunk_x = 0; chunk_x < num_chunks_x; chunk_x++)
+// Scratch space for building and encoding chunks, each encoding thread has its own so it can reuse the allocations from
+// one chunk to the next
+struct ChunkEncoder
+{
+    Chunk chunk;
+    // The chunk's tiles, wall occupancy layers and LOD quads
+    std::vector<OutputTile> tiles;
+    std::vector<OutputWallLayer> wall_layers;
+    std::vector<OutputLodQuad> lod_quads;
+    // The chunk's uncompressed data
+    std::vector<uint8_t> data;
+
+    ChunkEncoder()
+    {
+        // Reserve some space, assuming an average of 2 tiles per column
+        // Doesn't affect output, but helps reduce memory allocations while encoding chunks
+        tiles.reserve(2 * chunk_size * chunk_size);
+    }
+
+    // Builds a chunk from its cells and compresses the chunk's data, freeing the cells once they're no longer needed
+    EncodedChunk encode(std::vector<Cell>& cells)
+    {
+        build_chunk(cells, chunk);
+        cells = std::vector<Cell>{};
+        tiles.clear();
+        OutputChunk output_chunk;
+        // Keep track of the current byte offset in the chunk, skipping the chunk's column offset array
+        uint32_t cur_chunk_offset = sizeof(OutputChunk);
+
+        for (size_t sub_chunk_x = 0; sub_chunk_x < chunk_size; sub_chunk_x++)
         {
-            for (size_t chunk_z = 0; chunk_z < num_chunks_z; chunk_z++)
+            for (size_t sub_chunk_z = 0; sub_chunk_z < chunk_size; sub_chunk_z++)
             {
-                Chunk& cur_chunk = chunks[{chunk_x,chunk_z}];
+                auto& cur_column = chunk.columns[sub_chunk_x][sub_chunk_z];
+                auto& cur_output_column = output_chunk.columns[sub_chunk_x][sub_chunk_z];
 
-                // fmt::print("chunk: {:<2} {:<2}\n", chunk_x, chunk_z);
-                size_t start_x = chunk_x * chunk_size;
-                size_t start_z = chunk_z * chunk_size;
-                for (size_t subchunk_x = 0; subchunk_x < chunk_size; subchunk_x++)
-                {
-                    size_t cell_x = subchunk_x + start_x;
-                    for (size_t subchunk_z = 0; subchunk_z < chunk_size; subchunk_z++)
-                    {
-                        size_t cell_z = subchunk_z + start_z;
-                        auto column_iter = columns.find({cell_x, cell_z});
-                        if (column_iter != columns.end())
-                        {
-                            std::vector<Cell>& column_vec = column_iter->second;
-                            std::sort(column_vec.begin(), column_vec.end(),
-                                [](const Cell& a, const Cell& b)
-                                {
-                                    return a.y < b.y;
-                                }
-                            );
-                            int column_min_y = column_vec.front().y;
-                            int column_max_y = column_vec.back().y;
-                            size_t height = 1 + column_max_y - column_min_y;
-                            dynamic_array<OutputTile> output_column(height);
-                            size_t input_column_index = 0;
-                            for (size_t output_column_index = 0; output_column_index < height; output_column_index++)
-                            {
-                                int y = output_column_index + column_min_y;
-                                if (column_vec[input_column_index].y > y)
-                                {
-                                    output_column[output_column_index] = OutputTile{0xFF, 0};
-                                }
-                                else
-                                {
-                                    const auto& input_tile = column_vec[input_column_index];
-                                    output_column[output_column_index] = OutputTile{(uint8_t)input_tile.tile_id, (uint8_t)input_tile.rotation};
-                                    input_column_index++;
-                                }
-                            }
-                            cur_chunk.columns[subchunk_x][subchunk_z].tiles = std::move(output_column);
-                            cur_chunk.columns[subchunk_x][subchunk_z].base_height = column_min_y;
-                        }
-                        else
-                        {
-                            cur_chunk.columns[subchunk_x][subchunk_z].tiles = dynamic_array<OutputTile>();
-                            cur_chunk.columns[subchunk_x][subchunk_z].base_height = 0;
-                        }
-                    }
-                }
-            }
-        }
+                // Copy the relevant data from the input chunk column to the output chunk column
+                cur_output_column.base_height = cur_column.base_height;
+                cur_output_column.num_tiles = cur_column.tiles.size();
 
-        std::ofstream output_file(output_path, std::ios_base::binary);
-        write_grid(output_file, chunks);
+                // Record the current chunk tile count as the column's offset
+                cur_output_column.tiles_offset = cur_chunk_offset;
 
-        // fmt::print("Column count: {}\n", columns.size());
-        // fmt::print("Tile count: {}\n", sum);
-        // fmt::print("Min: {} {} {} Max: {} {} {}\n", min_x, min_y, min_z, max_x, max_y, max_z);
-        // fmt::print("Chunks: {} by {}\n", num_chunks_x, num_chunks_z);
+                // Copy the current column into the chunk's tiles
+                std::copy(cur_column.tiles.begin(), cur_column.tiles.end(), std::back_inserter(tiles));
 
-        std::streampos object_array_pos = round_up<alignof(OutputObject)>(output_file.tellp());
-        output_file.seekp(object_array_pos);
-        size_t num_objects = 0;
-        
-        if (input_json.contains("Objects"))
+                // Move forward in the chunk's data by the column's tile byte count
+                cur_chunk_offset += cur_column.tiles.size() * sizeof(decltype(cur_column.tiles)::value_type);
+            }
+        }
+        // Bake the chunk's collision data, the wall layers go after the chunk's tiles
+        bake_chunk_collision(chunk, output_chunk, wall_layers);
+        output_chunk.wall_layers_offset = cur_chunk_offset;
+        cur_chunk_offset += wall_layers.size() * sizeof(OutputWallLayer);
+        for (auto& layer : wall_layers)
         {
-            auto& input_objs = input_json["Objects"];
-            num_objects = input_objs.size();
-            dynamic_array<OutputObject> output_objects(num_objects);
-            size_t obj_index = 0;
-            for (auto& obj : input_json["Objects"])
+            for (auto& row : layer)
             {
-                int x = obj["X"];
-                x -= min_x;
-                int y = obj["Y"];
-                int z = obj["Z"];
-                z -= min_z;
-                auto& def = obj["Definition"];
-                int obj_class = def["ObjectClass"];
-                int obj_type = def["ObjectType"];
-                int obj_subtype = def["ObjectSubtype"];
-                int obj_param = obj["ObjectParam"];
-                output_objects[obj_index] = OutputObject {
-                    static_cast<uint16_t>(x),
-                    static_cast<int16_t>(y),
-                    static_cast<uint16_t>(z),
-                    static_cast<uint16_t>(obj_class),
-                    static_cast<uint16_t>(obj_type),
-                    static_cast<uint16_t>(obj_subtype),
-                    static_cast<uint32_t>(obj_param)
-                };
-                output_objects[obj_index].swap_endianness();
-                obj_index++;
+                row = ::swap_endianness(row);
             }
-            output_file.write(reinterpret_cast<const char*>(output_objects.data()), sizeof(OutputObject) * num_objects);
         }
-        // Write the object array position and number of objects to the file
-        uint32_t object_array_pos_big_endian = ::swap_endianness(static_cast<uint32_t>(object_array_pos));
-        uint32_t num_objects_big_endian = ::swap_endianness(static_cast<uint32_t>(num_objects));
-        output_file.seekp(offsetof(OutputGridDefinition, object_array_rom_offset));
-        output_file.write(reinterpret_cast<const char*>(&object_array_pos_big_endian), sizeof(uint32_t));
-        output_file.seekp(offsetof(OutputGridDefinition, num_objects));
-        output_file.write(reinterpret_cast<const char*>(&num_objects_big_endian), sizeof(uint32_t));
+        // Bake the chunk's LOD quads, which go after the wall layers
+        bake_chunk_lod(chunk, output_chunk, lod_quads);
+        output_chunk.num_lod_quads = static_cast<uint16_t>(lod_quads.size());
+        output_chunk.padding = 0;
+        output_chunk.lod_quads_offset = cur_chunk_offset;
+        for (auto& quad : lod_quads)
+        {
+            quad.swap_endianness();
+        }
+        output_chunk.swap_endianness();
+        // Gather the chunk tile offset array, the chunk's tiles, wall layers and LOD quads into the chunk's data
+        const uint8_t* output_chunk_bytes = reinterpret_cast<const uint8_t*>(&output_chunk);
+        const uint8_t* chunk_tile_bytes = reinterpret_cast<const uint8_t*>(tiles.data());
+        const uint8_t* chunk_wall_bytes = reinterpret_cast<const uint8_t*>(wall_layers.data());
+        const uint8_t* chunk_lod_bytes = reinterpret_cast<const uint8_t*>(lod_quads.data());
+        data.assign(output_chunk_bytes, output_chunk_bytes + sizeof(output_chunk));
+        data.insert(data.end(), chunk_tile_bytes, chunk_tile_bytes + tiles.size() * sizeof(decltype(tiles)::value_type));
+        data.insert(data.end(), chunk_wall_bytes, chunk_wall_bytes + wall_layers.size() * sizeof(OutputWallLayer));
+        data.insert(data.end(), chunk_lod_bytes, chunk_lod_bytes + lod_quads.size() * sizeof(OutputLodQuad));
+
+        return EncodedChunk{lz_compress(data), static_cast<uint32_t>(data.size())};
+    }
+};
+
+// Returns the number of threads to encode chunks on: LEVELCONV_THREADS if it's set, otherwise the number of cores
+// Returns 0 if LEVELCONV_THREADS isn't a positive number
+unsigned int encode_thread_count()
+{
+    const char* threads_env = std::getenv("LEVELCONV_THREADS");
+    if (threads_env == nullptr || threads_env[0] == '\0')
+    {
+        return std::max(std::thread::hardware_concurrency(), 1u);
+    }
+    char* threads_end;
+    unsigned long num_threads = std::strtoul(threads_env, &threads_end, 10);
+    if (*threads_end != '\0' || num_threads > std::numeric_limits<unsigned int>::max())
+    {
+        return 0;
+    }
+    return static_cast<unsigned int>(num_threads);
+}
+
+// Builds and encodes every chunk, spread over the given number of threads since each chunk is independent
+// The chunks are returned in the same order as the chunk array, so the output doesn't depend on the thread count
+dynamic_array<EncodedChunk> encode_chunks(dynamic_array_2d<std::vector<Cell>>& chunk_cells, unsigned int max_threads)
+{
+    size_t num_chunks_x = chunk_cells.size().first;
+    size_t num_chunks_z = chunk_cells.size().second;
+    size_t num_chunks = num_chunks_x * num_chunks_z;
+    dynamic_array<EncodedChunk> encoded_chunks(num_chunks);
+    std::atomic<size_t> next_chunk = 0;
+    auto encode_thread = [&]()
+    {
+        ChunkEncoder encoder;
+        for (size_t chunk_index = next_chunk++; chunk_index < num_chunks; chunk_index = next_chunk++)
+        {
+            // The chunk array is ordered by x and then z
+            size_t chunk_x = chunk_index / num_chunks_z;
+            size_t chunk_z = chunk_index % num_chunks_z;
+            encoded_chunks[chunk_index] = encoder.encode(chunk_cells[{chunk_x, chunk_z}]);
+        }
+    };
+
+    unsigned int num_threads = std::clamp<unsigned int>(max_threads, 1, num_chunks > 0 ? num_chunks : 1);
+    std::vector<std::thread> threads;
+    for (unsigned int thread_idx = 1; thread_idx < num_threads; thread_idx++)
+    {
+        threads.emplace_back(encode_thread);
+    }
+    encode_thread();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return encoded_chunks;
+}
+
+// Lays out the grid definition, the chunk array, the chunks and the objects in memory and writes them with a single write
+void write_grid(std::ofstream& output_file, dynamic_array_2d<std::vector<Cell>>& chunk_cells, const std::vector<OutputObject>& objects, unsigned int num_threads)
+{
+    size_t num_chunks_x = chunk_cells.size().first;
+    size_t num_chunks_z = chunk_cells.size().second;
+    dynamic_array<EncodedChunk> encoded_chunks = encode_chunks(chunk_cells, num_threads);
+
+    // Create an array to hold the chunk offsets and sizes
+    dynamic_array<ChunkArrayElement> chunk_offset_array(num_chunks_x * num_chunks_z);
+    size_t chunk_offset_array_bytes = chunk_offset_array.size() * sizeof(ChunkArrayElement);
+
+    // Assign each chunk its offset, keeping every chunk 2-byte aligned for PI DMA
+    uint32_t cur_offset = sizeof(OutputGridDefinition) + chunk_offset_array_bytes;
+    uint32_t grid_end = cur_offset;
+    for (size_t chunk_index = 0; chunk_index < encoded_chunks.size(); chunk_index++)
+    {
+        cur_offset = round_up<2>(cur_offset);
+        chunk_offset_array[chunk_index].offset = cur_offset - sizeof(OutputGridDefinition);
+        chunk_offset_array[chunk_index].size = encoded_chunks[chunk_index].size;
+        chunk_offset_array[chunk_index].compressed_size = encoded_chunks[chunk_index].data.size();
+        chunk_offset_array[chunk_index].swap_endianness();
+        cur_offset += encoded_chunks[chunk_index].data.size();
+        grid_end = cur_offset;
+    }
+    uint32_t object_array_offset = round_up<alignof(OutputObject)>(round_up<2>(grid_end));
+
+    // The file only extends past the last chunk if there are objects after it
+    size_t file_size = objects.empty() ? grid_end : object_array_offset + objects.size() * sizeof(OutputObject);
+    std::vector<uint8_t> file_data(file_size);
+
+    OutputGridDefinition grid_def{(uint16_t)num_chunks_x, (uint16_t)num_chunks_z, sizeof(OutputGridDefinition),
+        object_array_offset, static_cast<uint32_t>(objects.size())};
+    grid_def.swap_endianness();
+    std::memcpy(file_data.data(), &grid_def, sizeof(OutputGridDefinition));
+    std::memcpy(file_data.data() + sizeof(OutputGridDefinition), chunk_offset_array.data(), chunk_offset_array_bytes);
+    for (size_t chunk_index = 0; chunk_index < encoded_chunks.size(); chunk_index++)
+    {
+        uint32_t chunk_offset = ::swap_endianness(chunk_offset_array[chunk_index].offset) + sizeof(OutputGridDefinition);
+        std::copy(encoded_chunks[chunk_index].data.begin(), encoded_chunks[chunk_index].data.end(), file_data.begin() + chunk_offset);
     }
-    catch (js::json::exception& err)
+    if (!objects.empty())
     {
-        fmt::print("Invalid data in level file: {}\n", err.what());
+        std::memcpy(file_data.data() + object_array_offset, objects.data(), objects.size() * sizeof(OutputObject));
+    }
+
+    output_file.write(reinterpret_cast<const char*>(file_data.data()), file_data.size());
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        fmt::print("Usage: {} [input level file] [output level binary] [asset folder]\n", argv[0]);
+        fmt::print("  Set LEVELCONV_THREADS to the number of threads to encode chunks on (default: one per core)\n");
+        return EXIT_SUCCESS;
+    }
+
+    fs::path asset_folder(argv[3]);
+    char *input_path = argv[1];
+    char *output_path = argv[2];
+
+    if (!fs::is_directory(asset_folder))
+    {
+        fmt::print(stderr, "Provided asset folder ({}) is not a valid directory\n", asset_folder.c_str());
         return EXIT_FAILURE;
     }
 
+    if (!fs::is_regular_file(input_path))
+    {
+        fmt::print(stderr, "Input file {} does not exist or cannot be opened\n", input_path);
+        return EXIT_FAILURE;
+    }
+
+    unsigned int num_threads = encode_thread_count();
+    if (num_threads == 0)
+    {
+        fmt::print(stderr, "LEVELCONV_THREADS ({}) is not a positive number\n", std::getenv("LEVELCONV_THREADS"));
+        return EXIT_FAILURE;
+    }
+
+    // The output only depends on the level file and on where its tile paths point relative to the asset folder
+    build_cache::BuildCache cache("levelconv", argv[0]);
+    build_cache::Key cache_key = cache.key();
+    cache_key.add_file(input_path);
+    cache_key.add_string(fs::relative(fs::path(input_path).parent_path(), asset_folder).generic_string());
+    const fs::path cache_outputs[] = { output_path };
+    if (cache.fetch(cache_key, cache_outputs))
+    {
+        return EXIT_SUCCESS;
+    }
+
+    LevelReader level;
+    {
+        std::ifstream input_file(input_path, std::ios_base::binary);
+        if (!js::json::sax_parse(input_file, &level))
+        {
+            fmt::print("Error parsing json: {}\n", level.error());
+            return EXIT_FAILURE;
+        }
+    }
+    if (!level.finish())
+    {
+        fmt::print("Invalid data in level file: {}\n", level.error());
+        return EXIT_FAILURE;
+    }
+
+    fs::path assets_absolute = fs::canonical(asset_folder);
+    fs::path input_dir = fs::path(input_path).parent_path() / fs::path{"./"};
+    std::vector<std::string> tile_paths;
+
+    // Read tile model paths
+    for (auto& tile_path : level.tile_paths)
+    {
+        auto real_tile_path = fs::relative(input_dir / tile_path, assets_absolute).replace_extension();
+        tile_paths.emplace_back(real_tile_path.string());
+    }
+
+    std::ofstream output_file(output_path, std::ios_base::binary);
+    write_grid(output_file, level.chunk_cells(), level.objects, num_threads);
+
+    // fmt::print("Tile count: {}\n", level.num_cells());
+    // fmt::print("Chunks: {} by {}\n", level.chunk_cells().size().first, level.chunk_cells().size().second);
+
+    output_file.close();
+
+    cache.store(cache_key, cache_outputs);
+
     // std::vector<fs::path> all_files;
     // size_t total_size = gather_files(asset_folder, all_files);
 
@@ -5,10 +5,15 @@
 #include <cstdint>
 #include "dynamic_array.h"
 #include "../gltf64/include/bswap.h"
+// Collision types of the tile ids, shared with the game
+#include "../../include/tile_collisions.h"
 
 constexpr size_t chunk_size = 16;
 using tile_id = uint8_t;
 
+// Tile id of an empty position in a column
+constexpr tile_id empty_tile = 0xFF;
+
 // A tile is a single element in the grid. It has an associated tile id and a rotation.
 struct OutputTile {
     tile_id id;
@@ -38,10 +43,66 @@ struct OutputChunkColumn {
     }
 };
 
+// Flags for a column's topmost floor, the low 2 bits hold the floor tile's rotation
+constexpr uint8_t chunk_floor_present = 0x04;
+constexpr uint8_t chunk_floor_slope   = 0x08;
+// Set if the column has more floors below the topmost one
+constexpr uint8_t chunk_floor_stacked = 0x10;
+
+// The topmost floor or slope tile in a column, so floor queries don't have to search the column's tiles
+struct OutputChunkFloor {
+    int16_t y;
+    tile_id id;
+    uint8_t flags;
+    void swap_endianness()
+    {
+        y = ::swap_endianness(y);
+    }
+};
+
+// Shape of a LOD quad, the low 2 bits hold the rotation of slopes and walls
+constexpr uint8_t lod_quad_floor = 0x00;
+constexpr uint8_t lod_quad_slope = 0x04;
+constexpr uint8_t lod_quad_wall  = 0x08;
+constexpr uint8_t lod_quad_shape_mask = 0x0C;
+
+// Maximum number of tiles a LOD quad can be merged across on each axis, which keeps the quad's texture coordinates in range
+constexpr size_t lod_max_quad_tiles = 8;
+
+// A quad of the simplified mesh that's drawn in place of a chunk's tiles when the chunk is far from the camera
+// Floors are the top surfaces of columns merged across tiles with the same id and height, slopes are a single tile, and
+// walls are merged upwards across stacked wall tiles and then sideways along the edge they sit on
+struct OutputLodQuad {
+    int16_t y; // Tile height of the bottom of the quad
+    uint8_t x; // Tile position of the quad's minimum corner in the chunk
+    uint8_t z;
+    uint8_t size_x; // Number of tiles the quad covers along each axis
+    uint8_t size_z;
+    uint8_t size_y;
+    tile_id id;
+    uint8_t shape;
+    uint8_t padding;
+    void swap_endianness()
+    {
+        y = ::swap_endianness(y);
+    }
+};
+
 // A chunk is a collection of columns that can be loaded or unloaded independently of other chunks
 // Each chunk is assigned to a given chunk position, which is the position of the first column divided by chunk_size
+// After the columns come the baked collision data: the topmost floor of every column, and a wall occupancy bitmap for
+// every tile height from the chunk's lowest wall to its highest. Each bitmap layer is chunk_size 16-bit rows, one per
+// x position with bit z set if there's a wall at that z position. The layers are stored after the chunk's tiles.
+// The chunk's LOD quads are stored after the wall layers, sorted by tile id so each tile id's quads are contiguous.
 struct OutputChunk {
     std::array<std::array<OutputChunkColumn, chunk_size>, chunk_size> columns;
+    std::array<std::array<OutputChunkFloor, chunk_size>, chunk_size> floors;
+    int16_t wall_base_height;
+    uint16_t num_wall_layers;
+    uint32_t wall_layers_offset;
+    uint16_t num_lod_quads;
+    uint16_t padding;
+    uint32_t lod_quads_offset;
     void swap_endianness()
     {
         for (auto& z_array : columns)
@@ -51,12 +112,26 @@ struct OutputChunk {
                 column.swap_endianness();
             }
         }
+        for (auto& z_array : floors)
+        {
+            for (auto& floor : z_array)
+            {
+                floor.swap_endianness();
+            }
+        }
+        wall_base_height = ::swap_endianness(wall_base_height);
+        num_wall_layers = ::swap_endianness(num_wall_layers);
+        wall_layers_offset = ::swap_endianness(wall_layers_offset);
+        num_lod_quads = ::swap_endianness(num_lod_quads);
+        lod_quads_offset = ::swap_endianness(lod_quads_offset);
     }
 };
 
+using OutputWallLayer = std::array<uint16_t, chunk_size>;
+
 // A grid definition contains information about the grid it refers to. This includes the dimensions of the grid in chunks,
-// as well as the rom offset to the array of chunk rom offsets. (TODO PC) The chunk arrays in rom contain 2 32-bit values each, 
-// the chunk's file offset and the chunk's data length
+// as well as the rom offset to the array of chunk rom offsets. (TODO PC) The chunk arrays in rom contain 3 32-bit values each, 
+// the chunk's file offset, the chunk's data length and the length of the chunk's compressed data in the file
 struct OutputGridDefinition {
     uint16_t num_chunks_x;
     uint16_t num_chunks_z;
@@ -1,12 +1,16 @@
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
 #include <cstdlib>
 #include <iostream>
 #include <filesystem>
+#include <thread>
 #include <vector>
 #include <unordered_set>
 
 #include <fmt/core.h>
 
+#include "build_cache.h"
 #include "wave.h"
 #include "fx.h"
 #include "aifc.h"
@@ -65,6 +69,100 @@ std::vector<fs::path> get_sample_files(const fs::path& sample_folder)
     return ret;
 }
 
+// Runs a conversion command, returns false if it failed
+bool run_command(const std::string& command)
+{
+    if (system(command.c_str()) != 0)
+    {
+        fmt::print(stderr, "Command failed: {}\n", command);
+        return false;
+    }
+    return true;
+}
+
+// Encodes a sample into an aifc in the intermediate folder, or copies the aifc from an earlier conversion of the same
+// sample out of the build cache
+// The intermediate files are named after the sample's index as well as its name, since samples in different folders or
+// with different extensions can share a name and are converted at the same time
+// Returns the path of the aifc to read, which is the sample itself if it's already an aifc, or an empty path on failure
+fs::path convert_sample(size_t sample_idx, const fs::path& cur_path, const fs::path& intermediate_dir, const build_cache::BuildCache& cache)
+{
+    if (cur_path.extension() == ".aifc")
+    {
+        return cur_path;
+    }
+    fs::path intermediate_path = intermediate_dir / fmt::format("{}_{}", sample_idx, cur_path.stem().string());
+    fs::path table_path = intermediate_path;
+    table_path += ".table";
+    fs::path aifc_path = intermediate_path;
+    aifc_path += ".aifc";
+
+    // The extension picks how the sample gets converted, so it's part of the key along with the contents
+    build_cache::Key cache_key = cache.key();
+    cache_key.add_string(cur_path.extension().string());
+    cache_key.add_file(cur_path);
+    const fs::path cache_outputs[] = { aifc_path };
+    if (cache.fetch(cache_key, cache_outputs))
+    {
+        return aifc_path;
+    }
+
+    fs::path aiff_path;
+    if (cur_path.extension() == ".aiff")
+    {
+        aiff_path = cur_path;
+    }
+    else
+    {
+        aiff_path = intermediate_path;
+        aiff_path += ".aiff";
+        // fmt::print("sox {} -r 22500 {}", cur_path.string(), aiff_path.string());
+        if (!run_command(fmt::format("sox {} -r 22500 {}", cur_path.string(), aiff_path.string())))
+        {
+            return {};
+        }
+    }
+    // fmt::print("tabledesign {} > {}", aiff_path.string(), table_path.string());
+    if (!run_command(fmt::format("tabledesign {} > {}", aiff_path.string(), table_path.string())))
+    {
+        return {};
+    }
+    // fmt::print("vadpcm_enc -c {} {} {}", table_path.string(), aiff_path.string(), aifc_path.string());
+    if (!run_command(fmt::format("vadpcm_enc -c {} {} {}", table_path.string(), aiff_path.string(), aifc_path.string())))
+    {
+        return {};
+    }
+    cache.store(cache_key, cache_outputs);
+    return aifc_path;
+}
+
+// Converts every sample, spread over as many threads as there are cores since each conversion is independent
+std::vector<fs::path> convert_samples(const std::vector<fs::path>& sample_files, const fs::path& intermediate_dir, const build_cache::BuildCache& cache)
+{
+    std::vector<fs::path> aifc_paths(sample_files.size());
+    std::atomic<size_t> next_sample = 0;
+    auto convert_thread = [&]()
+    {
+        for (size_t sample_idx = next_sample++; sample_idx < sample_files.size(); sample_idx = next_sample++)
+        {
+            aifc_paths[sample_idx] = convert_sample(sample_idx, sample_files[sample_idx], intermediate_dir, cache);
+        }
+    };
+
+    unsigned int num_threads = std::clamp<unsigned int>(std::thread::hardware_concurrency(), 1, sample_files.size() > 0 ? sample_files.size() : 1);
+    std::vector<std::thread> threads;
+    for (unsigned int thread_idx = 1; thread_idx < num_threads; thread_idx++)
+    {
+        threads.emplace_back(convert_thread);
+    }
+    convert_thread();
+    for (std::thread& thread : threads)
+    {
+        thread.join();
+    }
+    return aifc_paths;
+}
+
 int main(int argc, char * argv[])
 {
     if (argc != 4)
@@ -93,38 +191,18 @@ int main(int argc, char * argv[])
     // Allocate and initialize one Wave for each input file
     WaveBank output(num_input_files);
 
+    build_cache::BuildCache cache("soundconv", argv[0]);
+    std::vector<fs::path> aifc_paths = convert_samples(sample_files, intermediate_dir, cache);
+
     for (size_t i = 0; i < num_input_files; i++)
     {
         const fs::path& cur_path = sample_files[i];
-        fs::path aifc_path;
+        const fs::path& aifc_path = aifc_paths[i];
         fs::path relative_path = fs::relative(cur_path, input_dir);
-        if (cur_path.extension() == ".aifc")
-        {
-            aifc_path = cur_path;
-        }
-        else
+        if (aifc_path.empty())
         {
-            fs::path cur_filename = cur_path.filename();
-            fs::path aiff_path;
-            if (cur_path.extension() == ".aiff")
-            {
-                aiff_path = cur_path;
-            }
-            else
-            {
-                aiff_path = intermediate_dir / cur_filename;
-                aiff_path.replace_extension(".aiff");
-                // fmt::print("sox {} -r 22500 {}", cur_path.string(), aiff_path.string());
-                system(fmt::format("sox {} -r 22500 {}", cur_path.string(), aiff_path.string()).c_str());
-            }
-            fs::path table_path = intermediate_dir / cur_filename;
-            table_path.replace_extension(".table");
-            aifc_path = table_path;
-            aifc_path.replace_extension(".aifc");
-            // fmt::print("tabledesign {} > {}", aiff_path.string(), table_path.string());
-            system(fmt::format("tabledesign {} > {}", aiff_path.string(), table_path.string()).c_str());
-            // fmt::print("vadpcm_enc -c {} {} {}", table_path.string(), aiff_path.string(), aifc_path.string());
-            system(fmt::format("vadpcm_enc -c {} {} {}", table_path.string(), aiff_path.string(), aifc_path.string()).c_str());
+            fmt::print(stderr, "Failed to convert {}\n", cur_path.string());
+            return EXIT_FAILURE;
         }
         try
         {